@@ -0,0 +1,151 @@
+#include "sensor-codec.h"
+#include <string.h>
+
+#define KEYFRAME 0x80
+#define SEQ_MASK 0x0F
+/*---------------------------------------------------------------------------*/
+/* Small magnitudes of either sign map to small unsigned values */
+static uint16_t
+zigzag(int16_t v)
+{
+  return ((uint16_t)v << 1) ^ (uint16_t)(v >> 15);
+}
+/*---------------------------------------------------------------------------*/
+static int16_t
+unzigzag(uint16_t v)
+{
+  return (int16_t)((v >> 1) ^ -(v & 1));
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+put_varint(uint8_t *buf, uint16_t v)
+{
+  uint8_t len = 0;
+
+  while(v >= 0x80) {
+    buf[len++] = (uint8_t)v | 0x80;
+    v >>= 7;
+  }
+  buf[len++] = (uint8_t)v;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the bytes taken, 0 if the varint is cut off or too long */
+static uint8_t
+get_varint(const uint8_t *buf, uint8_t len, uint16_t *v)
+{
+  uint8_t i;
+
+  *v = 0;
+  for(i = 0; i < len && i < 3; i++) {
+    *v |= (uint16_t)(buf[i] & 0x7F) << (7 * i);
+    if(!(buf[i] & 0x80)) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+sensor_codec_tx_init(struct sensor_codec_tx *tx, uint8_t key_interval)
+{
+  tx->key_interval = key_interval > 0 ? key_interval : 1;
+  tx->frames = 0;
+  tx->n = 0;
+  tx->pending_n = 0;
+  tx->seq = 0;
+  tx->outstanding = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+sensor_codec_encode(struct sensor_codec_tx *tx, const int16_t *values,
+                    uint8_t n, uint8_t *buf, uint8_t size)
+{
+  uint8_t key;
+  uint8_t len = 1;
+  uint8_t i;
+
+  if(n == 0 || n > SENSOR_CODEC_CHANNELS || size < SENSOR_CODEC_MAX_LEN(n)) {
+    return -1;
+  }
+
+  // With a frame in flight we cannot tell which reading the destination
+  // will hold, so only a keyframe is safe
+  key = tx->n != n || tx->outstanding > 0 || tx->frames >= tx->key_interval;
+
+  for(i = 0; i < n; i++) {
+    len += put_varint(&buf[len],
+                      zigzag(key ? values[i] : (int16_t)(values[i] - tx->acked[i])));
+  }
+  buf[0] = (key ? KEYFRAME : 0) | ((n - 1) << 4) | (tx->seq & SEQ_MASK);
+
+  memcpy(tx->pending, values, n * sizeof(int16_t));
+  tx->pending_n = n | (key ? KEYFRAME : 0);
+  tx->outstanding++;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+void
+sensor_codec_sent(struct sensor_codec_tx *tx, uint8_t acked)
+{
+  if(tx->outstanding == 0 || --tx->outstanding > 0) {
+    // Only the last frame encoded matters, and it is a keyframe
+    return;
+  }
+  if(!acked) {
+    // Lost, or received with the ACK lost: start again from a keyframe
+    tx->n = 0;
+    return;
+  }
+  memcpy(tx->acked, tx->pending, sizeof(tx->acked));
+  tx->n = tx->pending_n & ~KEYFRAME;
+  tx->frames = (tx->pending_n & KEYFRAME) ? 1 : tx->frames + 1;
+  tx->seq = (tx->seq + 1) & SEQ_MASK;
+}
+/*---------------------------------------------------------------------------*/
+void
+sensor_codec_rx_init(struct sensor_codec_rx *rx)
+{
+  rx->n = 0;
+  rx->seq = 0;
+  rx->rejected = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+sensor_codec_decode(struct sensor_codec_rx *rx, const uint8_t *buf,
+                    uint8_t len, int16_t *values)
+{
+  uint8_t key, n, seq;
+  uint8_t pos = 1;
+  uint8_t i, taken;
+  uint16_t v;
+
+  if(len < 2) {
+    return -1;
+  }
+  key = buf[0] & KEYFRAME;
+  n = ((buf[0] >> 4) & 0x07) + 1;
+  seq = buf[0] & SEQ_MASK;
+  if(n > SENSOR_CODEC_CHANNELS) {
+    return -1;
+  }
+  if(!key && (rx->n != n || seq != ((rx->seq + 1) & SEQ_MASK))) {
+    rx->rejected++;
+    return -1;
+  }
+
+  for(i = 0; i < n; i++) {
+    taken = get_varint(&buf[pos], len - pos, &v);
+    if(taken == 0) {
+      return -1;
+    }
+    pos += taken;
+    values[i] = key ? unzigzag(v) : (int16_t)(rx->last[i] + unzigzag(v));
+  }
+
+  memcpy(rx->last, values, n * sizeof(int16_t));
+  rx->n = n;
+  rx->seq = seq;
+  return n;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,128 @@
+/**
+ * \file
+ *         Compact encoding of periodic multi-channel sensor readings
+ *
+ *         A reading is up to 8 channels of int16_t. Each frame carries the
+ *         difference to the last reading the destination acknowledged, as
+ *         zig-zag varints, so slowly changing values take one byte per
+ *         channel. A keyframe with the plain values is sent at least every
+ *         key_interval frames, and whenever the acknowledged reading is
+ *         unknown: at start, after a frame went unacknowledged (MAX_RT in
+ *         nRF24_write()), or while an earlier frame is still in flight.
+ *
+ *         Frame layout:
+ *         - 1 byte: keyframe flag (bit 7), channels - 1 (bits 4-6),
+ *           sequence number (bits 0-3);
+ *         - per channel, 1-3 bytes of zig-zag varint.
+ *
+ *         The sequence number only advances on acknowledged frames, so a
+ *         delta frame with number s is relative to the frame numbered s - 1.
+ *         A receiver that does not hold that frame drops the delta frame
+ *         and waits for the next keyframe.
+ *
+ *         Both state structures belong to the caller, one per destination
+ *         and one per source. The code has no Contiki dependency and builds
+ *         on the host, see tools/sensor-codec-bench.
+ */
+
+#ifndef SENSOR_CODEC_H
+#define SENSOR_CODEC_H
+
+#include <stdint.h>
+
+/**
+ * Largest number of channels in a reading, 1-8. Sizes the state kept per
+ * destination and per source: 4 * SENSOR_CODEC_CHANNELS + 6 bytes for the
+ * sender, 2 * SENSOR_CODEC_CHANNELS + 3 for the receiver.
+ */
+#ifndef SENSOR_CODEC_CHANNELS
+#define SENSOR_CODEC_CHANNELS 4
+#endif
+
+#if SENSOR_CODEC_CHANNELS < 1 || SENSOR_CODEC_CHANNELS > 8
+#error SENSOR_CODEC_CHANNELS must be 1-8
+#endif
+
+/**
+ * Longest frame for n channels
+ */
+#define SENSOR_CODEC_MAX_LEN(n) (1 + 3 * (n))
+
+/**
+ * Sender state for one destination
+ */
+struct sensor_codec_tx {
+  int16_t acked[SENSOR_CODEC_CHANNELS];   /**< Last reading acknowledged */
+  int16_t pending[SENSOR_CODEC_CHANNELS]; /**< Last reading encoded */
+  uint8_t key_interval;  /**< Frames per keyframe, at most */
+  uint8_t frames;        /**< Frames acknowledged since the last keyframe, itself included */
+  uint8_t n;             /**< Channels in acked, 0 if it is not valid */
+  uint8_t pending_n;     /**< Channels in pending, with bit 7 set for a keyframe */
+  uint8_t seq;           /**< Sequence number of the next frame */
+  uint8_t outstanding;   /**< Frames encoded and not reported by sensor_codec_sent() */
+};
+
+/**
+ * Receiver state for one source
+ */
+struct sensor_codec_rx {
+  int16_t last[SENSOR_CODEC_CHANNELS];    /**< Last reading decoded */
+  uint8_t n;             /**< Channels in last, 0 if it is not valid */
+  uint8_t seq;           /**< Sequence number of the last frame decoded */
+  uint8_t rejected;      /**< Delta frames dropped for want of their base */
+};
+
+  /**
+   * Start over with a destination
+   *
+   * @param tx State to set up
+   * @param key_interval A keyframe goes out at least every this many
+   * frames. Use 1 for broadcasts: they are never acknowledged, so deltas
+   * could not be decoded by a node that missed a frame.
+   */
+  void sensor_codec_tx_init(struct sensor_codec_tx *tx, uint8_t key_interval);
+
+  /**
+   * Encode a reading
+   *
+   * @param tx State of the destination
+   * @param values Channel values
+   * @param n Number of channels, 1-SENSOR_CODEC_CHANNELS
+   * @param buf Where to store the frame
+   * @param size Room in @p buf, at least SENSOR_CODEC_MAX_LEN(n)
+   * @return Frame length, or -1 if @p n or @p size do not fit
+   */
+  int sensor_codec_encode(struct sensor_codec_tx *tx, const int16_t *values,
+                          uint8_t n, uint8_t *buf, uint8_t size);
+
+  /**
+   * Report the outcome of a frame, in the order they were encoded
+   *
+   * Call it from the MAC sent callback with status == MAC_TX_OK. Anything
+   * else, MAC_TX_NOACK after MAX_RT in particular, makes the next frame a
+   * keyframe.
+   *
+   * @param tx State of the destination
+   * @param acked True if the destination acknowledged the frame
+   */
+  void sensor_codec_sent(struct sensor_codec_tx *tx, uint8_t acked);
+
+  /**
+   * Start over with a source
+   */
+  void sensor_codec_rx_init(struct sensor_codec_rx *rx);
+
+  /**
+   * Decode a frame
+   *
+   * @param rx State of the source
+   * @param buf Frame
+   * @param len Frame length; trailing bytes are ignored
+   * @param values Where to store the channels, SENSOR_CODEC_CHANNELS values
+   * @return Number of channels, or -1 if the frame is malformed or a delta
+   * against a reading this receiver does not have
+   */
+  int sensor_codec_decode(struct sensor_codec_rx *rx, const uint8_t *buf,
+                          uint8_t len, int16_t *values);
+
+#endif /* SENSOR_CODEC_H */
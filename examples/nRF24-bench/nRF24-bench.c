@@ -0,0 +1,471 @@
+/**
+ * \file
+ *         Throughput and round-trip latency benchmark for the nRF24 driver
+ *
+ *         Flash this on two nodes. Both answer as responders; a line
+ *         "bench ping <node>" or "bench stream <node>" on the serial port of
+ *         one of them starts a sweep against the other and prints one CSV
+ *         line per run. See README.md for the columns.
+ *
+ *         The benchmark takes the radio from the network stack: it stops
+ *         nRF24_process and reads the FIFO itself.
+ */
+
+#include "contiki.h"
+#include "dev/serial-line.h"
+#include "nRF24_driver.h"
+#include "nRF24_arch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The sweep changes the payload size and dynamic payloads per run */
+#if defined (nRF24_FIXED_CONFIG)
+#error nRF24-bench needs a build without nRF24_FIXED_CONFIG
+#endif
+
+/* Length of a run, in milliseconds */
+#ifndef BENCH_WINDOW_MS
+#define BENCH_WINDOW_MS 1000
+#endif
+
+/* Width of an RTT histogram bucket, in microseconds */
+#ifndef BENCH_RTT_BUCKET_US
+#define BENCH_RTT_BUCKET_US 100
+#endif
+#define RTT_BUCKETS 128
+
+#define PONG_TIMEOUT_US 100000UL  /* A ping is lost without a pong by then */
+#define GUARD_US 20000UL          /* Time for the responder to apply a config */
+#define SLACK_US 50000UL          /* Responder stays in the run config after the window */
+#define REPORT_TIMEOUT_US 500000UL
+#define ATTEMPTS 5
+
+#define MODE_PING 0
+#define MODE_STREAM 1
+#define FLAG_ACK 0x01
+#define FLAG_DYNAMIC 0x02
+#define ARD_AUTO 0xff             /* Retry delay from the ESB timing model */
+
+#define FRAME_CONFIG 'C'
+#define FRAME_REPORT 'R'
+
+struct config {
+  uint8_t mode;
+  uint8_t rate;                   /* rf24_datarate_e */
+  uint8_t size;                   /* Payload bytes, 1-32 */
+  uint8_t flags;
+  uint8_t ard;                    /* SETUP_RETR delay, or ARD_AUTO */
+  uint8_t arc;                    /* SETUP_RETR count */
+  uint16_t window_ms;
+};
+
+struct result {
+  uint16_t sent;                  /* Frames written */
+  uint16_t acked;                 /* Written with TX_DS, all of them without ACK */
+  int32_t received;               /* Pongs, or frames counted by the peer; -1 unknown */
+  uint32_t rtt_min, rtt_max;      /* In microseconds */
+  uint32_t rtt_sum;
+  uint16_t rtt[RTT_BUCKETS];
+};
+
+/* The sweep, every combination is one run */
+static const uint8_t rates[] = { RF24_250KBPS, RF24_1MBPS, RF24_2MBPS };
+static const uint16_t rate_kbps[] = { 1000, 2000, 250 }; /* By rf24_datarate_e */
+static const uint8_t sizes[] = { 1, 8, 16, 24, 32 };
+static const uint8_t retries[][2] = { /* ARD, ARC; the first one runs without ACK */
+  { ARD_AUTO, 0 }, { ARD_AUTO, 0 }, { ARD_AUTO, 3 }, { ARD_AUTO, 15 }, { 15, 15 }
+};
+#define RETRIES (sizeof(retries) / sizeof(retries[0]))
+#define RUNS (sizeof(rates) * 2 * RETRIES * sizeof(sizes))
+
+/* Between runs, and for the config and report frames */
+static const struct config base = {
+  MODE_PING, RF24_1MBPS, 32, FLAG_ACK | FLAG_DYNAMIC, ARD_AUTO, 15, 0
+};
+
+static uint8_t tx[32], rx[32];
+static struct result result;
+static rimeaddr_t peer;
+static const struct config *current;
+
+PROCESS(bench_process, "nRF24 bench");
+AUTOSTART_PROCESSES(&bench_process);
+/*---------------------------------------------------------------------------*/
+static void
+sweep_config(uint8_t mode, uint8_t run, struct config *c)
+{
+  uint8_t r;
+
+  c->mode = mode;
+  c->window_ms = BENCH_WINDOW_MS;
+  c->size = sizes[run % sizeof(sizes)];
+  run /= sizeof(sizes);
+  r = run % RETRIES;
+  c->flags = r == 0 ? 0 : FLAG_ACK;
+  c->ard = retries[r][0];
+  c->arc = retries[r][1];
+  run /= RETRIES;
+  c->flags |= run % 2 == 0 ? FLAG_DYNAMIC : 0;
+  c->rate = rates[run / 2];
+}
+/*---------------------------------------------------------------------------*/
+static void
+apply(const struct config *c)
+{
+  nRF24_stopListening();
+  nRF24_setDataRate(c->rate);
+  if(c->flags & FLAG_DYNAMIC) {
+    nRF24_enableDynamicPayloads();
+    nRF24_setPayloadSize(32);
+  } else {
+    nRF24_disableDynamicPayloads();
+    nRF24_setPayloadSize(c->size);
+  }
+  if(c->ard == ARD_AUTO) {
+    nRF24_setRetryCount(c->arc);
+  } else {
+    nRF24_setRetries(c->ard, c->arc);
+  }
+  // Reprograms the RX_PW of the pipes with the payload size
+  nRF24_setRimeAddress(&rimeaddr_node_addr);
+  nRF24_setDestination(&peer);
+  current = c;
+  nRF24_startListening();
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+receive(void)
+{
+  uint8_t len = current->size;
+
+  if(current->flags & FLAG_DYNAMIC) {
+    len = nRF24_getDynamicPayloadSize();
+    if(len == 0) {
+      // Corrupt, already flushed
+      return 0;
+    }
+  }
+  nRF24_read(rx, rf24_min(len, sizeof(rx)));
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static bool
+send(const void *buf, uint8_t len)
+{
+  bool ok;
+
+  nRF24_stopListening();
+  ok = nRF24_write(buf, len, !(current->flags & FLAG_ACK));
+  nRF24_startListening();
+  return ok;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wait_us(uint32_t us)
+{
+  struct nRF24_deadline d;
+
+  nRF24_deadline_set(&d, us);
+  while(!nRF24_deadline_expired(&d));
+}
+/*---------------------------------------------------------------------------*/
+static void
+record_rtt(uint32_t us)
+{
+  uint32_t bucket = us / BENCH_RTT_BUCKET_US;
+
+  result.rtt[bucket < RTT_BUCKETS ? bucket : RTT_BUCKETS - 1]++;
+  result.rtt_sum += us;
+  if(us < result.rtt_min) {
+    result.rtt_min = us;
+  }
+  if(us > result.rtt_max) {
+    result.rtt_max = us;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Upper bound of the bucket holding the given percentile */
+static uint32_t
+rtt_percentile(uint8_t percent)
+{
+  uint32_t rank = ((uint32_t)result.received * percent + 99) / 100;
+  uint32_t seen = 0;
+  uint8_t i;
+
+  for(i = 0; i < RTT_BUCKETS - 1; i++) {
+    seen += result.rtt[i];
+    if(seen >= rank) {
+      return rf24_min((i + 1) * (uint32_t)BENCH_RTT_BUCKET_US, result.rtt_max);
+    }
+  }
+  return result.rtt_max;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_ping(const struct config *c)
+{
+  struct nRF24_deadline window, timeout;
+  rtimer_clock_t start;
+  uint8_t seq = 0;
+
+  memset(tx, 0xa5, sizeof(tx));
+  nRF24_deadline_set(&window, c->window_ms * 1000UL);
+  while(!nRF24_deadline_expired(&window)) {
+    tx[0] = ++seq;
+    start = RTIMER_NOW();
+    result.sent++;
+    if(!send(tx, c->size)) {
+      continue;
+    }
+    result.acked++;
+    nRF24_deadline_set(&timeout, PONG_TIMEOUT_US);
+    while(!nRF24_deadline_expired(&timeout)) {
+      // A late pong of an earlier ping has another number
+      if(nRF24_available(NULL) && receive() > 0 && rx[0] == seq) {
+        record_rtt((rtimer_clock_t)(RTIMER_NOW() - start) * nRF24_TICK_US);
+        result.received++;
+        break;
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_stream(const struct config *c)
+{
+  struct nRF24_deadline window;
+  uint16_t seq = 0;
+
+  memset(tx, 0x5a, sizeof(tx));
+  nRF24_stopListening();
+  nRF24_deadline_set(&window, c->window_ms * 1000UL);
+  while(!nRF24_deadline_expired(&window)) {
+    seq++;
+    tx[0] = seq;
+    tx[1] = seq >> 8;
+    result.sent++;
+    if(nRF24_write(tx, c->size, !(c->flags & FLAG_ACK))) {
+      result.acked++;
+    }
+  }
+  nRF24_startListening();
+}
+/*---------------------------------------------------------------------------*/
+/* Answer pings or count a stream until the run is over */
+static uint16_t
+serve(const struct config *c)
+{
+  struct nRF24_deadline end;
+  uint16_t count = 0;
+  uint16_t last = 0;
+  uint16_t seq;
+  uint8_t len;
+
+  nRF24_deadline_set(&end, GUARD_US + c->window_ms * 1000UL + SLACK_US);
+  while(!nRF24_deadline_expired(&end)) {
+    if(!nRF24_available(NULL) || (len = receive()) == 0) {
+      continue;
+    }
+    if(c->mode == MODE_PING) {
+      send(rx, len);
+      continue;
+    }
+    // A retransmission after a lost ACK carries the same number
+    seq = len >= 2 ? rx[0] | rx[1] << 8 : 0;
+    if(len < 2 || seq != last) {
+      count++;
+      last = seq;
+    }
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static bool
+send_config(const struct config *c, uint8_t run)
+{
+  uint8_t i;
+
+  tx[0] = FRAME_CONFIG;
+  tx[1] = rimeaddr_node_addr.u8[0];
+  tx[2] = run;
+  tx[3] = c->mode;
+  tx[4] = c->rate;
+  tx[5] = c->size;
+  tx[6] = c->flags;
+  tx[7] = c->ard;
+  tx[8] = c->arc;
+  tx[9] = c->window_ms;
+  tx[10] = c->window_ms >> 8;
+  for(i = 0; i < ATTEMPTS; i++) {
+    if(send(tx, 11)) {
+      return true;
+    }
+    wait_us(20000UL);
+  }
+  return false;
+}
+/*---------------------------------------------------------------------------*/
+static void
+receive_report(uint8_t run)
+{
+  struct nRF24_deadline timeout;
+
+  nRF24_deadline_set(&timeout, SLACK_US + REPORT_TIMEOUT_US);
+  while(!nRF24_deadline_expired(&timeout)) {
+    if(nRF24_available(NULL) && receive() >= 4 &&
+       rx[0] == FRAME_REPORT && rx[1] == run) {
+      result.received = rx[2] | rx[3] << 8;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Initiator side of one run, false if the peer does not answer */
+static bool
+run_one(uint8_t mode, uint8_t run)
+{
+  static struct config c;
+
+  sweep_config(mode, run, &c);
+  memset(&result, 0, sizeof(result));
+  result.rtt_min = 0xffffffffUL;
+  if(!send_config(&c, run)) {
+    return false;
+  }
+  apply(&c);
+  wait_us(GUARD_US);
+  if(mode == MODE_PING) {
+    run_ping(&c);
+  } else {
+    result.received = -1;
+    run_stream(&c);
+  }
+  apply(&base);
+  if(mode == MODE_STREAM) {
+    receive_report(run);
+  } else {
+    // Let the responder return to the base config
+    wait_us(SLACK_US);
+  }
+
+  printf_P(PSTR("%s,%u,%u,%u,%u,"), mode == MODE_PING ? "ping" : "stream",
+           rate_kbps[c.rate], c.size, c.flags & FLAG_ACK ? 1 : 0,
+           c.flags & FLAG_DYNAMIC ? 1 : 0);
+  if(!(c.flags & FLAG_ACK)) {
+    printf_P(PSTR(",,"));
+  } else if(c.ard == ARD_AUTO) {
+    printf_P(PSTR("auto,%u,"), c.arc);
+  } else {
+    printf_P(PSTR("%u,%u,"), (c.ard + 1) * 250, c.arc);
+  }
+  printf_P(PSTR("%u,%u,%u,"), c.window_ms, result.sent, result.acked);
+  if(result.received < 0) {
+    printf_P(PSTR(",,"));
+  } else {
+    printf_P(PSTR("%ld,%lu,"), (long)result.received,
+             result.sent ? (unsigned long)(1000UL - 1000UL * result.received / result.sent) : 0UL);
+  }
+  printf_P(PSTR("%lu"), result.received > 0 ?
+           (unsigned long)result.received * c.size * 8000UL / c.window_ms : 0UL);
+  if(mode == MODE_PING && result.received > 0) {
+    printf_P(PSTR(",%lu,%lu,%lu,%lu,%lu,%lu\n"), (unsigned long)result.rtt_min,
+             (unsigned long)rtt_percentile(50), (unsigned long)rtt_percentile(90),
+             (unsigned long)rtt_percentile(99), (unsigned long)result.rtt_max,
+             (unsigned long)(result.rtt_sum / result.received));
+  } else {
+    printf_P(PSTR(",,,,,,\n"));
+  }
+  return true;
+}
+/*---------------------------------------------------------------------------*/
+/* Responder side, for a config frame in rx */
+static void
+respond(void)
+{
+  static struct config c;
+  uint8_t run = rx[2];
+  uint16_t count;
+  uint8_t i;
+
+  peer.u8[0] = rx[1];
+  peer.u8[1] = 0;
+  c.mode = rx[3];
+  c.rate = rx[4];
+  c.size = rx[5] < 1 ? 1 : rx[5] > 32 ? 32 : rx[5];
+  c.flags = rx[6];
+  c.ard = rx[7];
+  c.arc = rx[8];
+  c.window_ms = rx[9] | rx[10] << 8;
+
+  apply(&c);
+  count = serve(&c);
+  apply(&base);
+  if(c.mode != MODE_STREAM) {
+    return;
+  }
+  tx[0] = FRAME_REPORT;
+  tx[1] = run;
+  tx[2] = count;
+  tx[3] = count >> 8;
+  for(i = 0; i < ATTEMPTS && !send(tx, 4); i++) {
+    wait_us(20000UL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(bench_process, ev, data)
+{
+  static uint8_t mode, run;
+  const char *arg;
+
+  PROCESS_BEGIN();
+
+  nRF24_driver.init();
+  // Frames are read here from now on, not handed to the network stack
+  process_exit(&nRF24_process);
+  apply(&base);
+  printf_P(PSTR("# nRF24-bench node %u, built " __DATE__ " " __TIME__ "\n"),
+           rimeaddr_node_addr.u8[0]);
+  printf_P(PSTR("# \"bench ping <node>\" or \"bench stream <node>\" starts a sweep\n"));
+
+  while(1) {
+    // Poll the radio between the other processes
+    process_poll(&bench_process);
+    PROCESS_YIELD();
+
+    if(ev == serial_line_event_message && data != NULL) {
+      arg = (const char *)data;
+      if(strncmp(arg, "bench ping ", 11) == 0) {
+        mode = MODE_PING;
+      } else if(strncmp(arg, "bench stream ", 13) == 0) {
+        mode = MODE_STREAM;
+      } else {
+        continue;
+      }
+      peer.u8[0] = atoi(strchr(arg + 6, ' ') + 1);
+      peer.u8[1] = 0;
+      apply(&base);
+
+      printf_P(PSTR("mode,rate_kbps,size,ack,dynamic,ard_us,arc,window_ms,sent,acked,"
+                    "received,loss_permille,goodput_bps,rtt_min_us,rtt_p50_us,"
+                    "rtt_p90_us,rtt_p99_us,rtt_max_us,rtt_mean_us\n"));
+      for(run = 0; run < RUNS; run++) {
+        if(!run_one(mode, run)) {
+          printf_P(PSTR("# node %u does not answer\n"), peer.u8[0]);
+          break;
+        }
+        // Serial input and the rest of the system get a turn between runs
+        PROCESS_PAUSE();
+      }
+      printf_P(PSTR("# done\n"));
+      continue;
+    }
+
+    if(nRF24_available(NULL) && receive() >= 11 && rx[0] == FRAME_CONFIG) {
+      respond();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
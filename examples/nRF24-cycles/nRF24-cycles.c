@@ -0,0 +1,117 @@
+/**
+ * \file
+ *         Cycle counts of the nRF24 driver's hot paths, run in simavr
+ *
+ *         Not for a board: tools/nrf24-avr-bench loads this image into
+ *         simavr with an emulated nRF24L01+ on the SPI bus and a second
+ *         emulated radio as the peer. Every operation of nRF24-cycles.h
+ *         runs CYCLES_REPEAT times between two writes to GPIOR0, which the
+ *         harness turns into cycle counts.
+ *
+ *         The benchmark takes the radio from the network stack: it stops
+ *         nRF24_process and reads the FIFO itself.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "nRF24_driver.h"
+#include "nRF24_arch.h"
+#include "avr-spi.h"
+#include "nRF24L01.h"
+#include "nRF24-cycles.h"
+
+#include <avr/io.h>
+
+/* Give up waiting for the peer's frame after this long */
+#define PEER_TIMEOUT_US 20000UL
+
+#define MARK(op) do { GPIOR0 = (op); } while(0)
+
+PROCESS(cycles_process, "nRF24 cycles");
+AUTOSTART_PROCESSES(&cycles_process);
+
+static uint8_t payload[32];
+
+/*---------------------------------------------------------------------------*/
+static void
+send(uint8_t node)
+{
+  rimeaddr_t dest;
+
+  packetbuf_clear();
+  rimeaddr_copy(&dest, &rimeaddr_null);
+  dest.u8[0] = node;
+  if(node != 0) {
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
+  }
+  MARK(node != 0 ? CYCLES_SEND_UNICAST : CYCLES_SEND_BROADCAST);
+  NETSTACK_RADIO.send(payload, nRF24_getPayloadSize());
+  MARK(CYCLES_END);
+}
+/*---------------------------------------------------------------------------*/
+static void
+receive(void)
+{
+  static uint8_t buf[32];
+  rtimer_clock_t start = RTIMER_NOW();
+
+  GPIOR1 = CYCLES_PEER_SEND;
+  while(!nRF24_available(NULL)) {
+    if((rtimer_clock_t)(RTIMER_NOW() - start) > PEER_TIMEOUT_US / nRF24_TICK_US) {
+      // Not counted, the harness reports fewer runs
+      return;
+    }
+  }
+  MARK(CYCLES_READ);
+  NETSTACK_RADIO.read(buf, sizeof(buf));
+  MARK(CYCLES_END);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(cycles_process, ev, data)
+{
+  static struct etimer et;
+  static uint8_t i;
+
+  PROCESS_BEGIN();
+
+  nRF24_driver.init();
+  process_exit(&nRF24_process);
+  for(i = 0; i < sizeof(payload); i++) {
+    payload[i] = i;
+  }
+  nRF24_startListening();
+  // Let the peer come up
+  etimer_set(&et, CLOCK_SECOND / 16);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  for(i = 0; i < CYCLES_REPEAT; i++) {
+    MARK(CYCLES_MARKER);
+    MARK(CYCLES_END);
+
+    MARK(CYCLES_DIGITAL_WRITE);
+    digitalWrite(nRF24_CSPIN, HIGH);
+    MARK(CYCLES_END);
+
+    digitalWrite(nRF24_CSPIN, LOW);
+    MARK(CYCLES_SPI_BYTE);
+    spi_write_byte(NOP);
+    MARK(CYCLES_END);
+    digitalWrite(nRF24_CSPIN, HIGH);
+
+    MARK(CYCLES_STOP_LISTENING);
+    nRF24_stopListening();
+    MARK(CYCLES_END);
+
+    MARK(CYCLES_START_LISTENING);
+    nRF24_startListening();
+    MARK(CYCLES_END);
+
+    send(CYCLES_PEER);
+    send(0);
+    receive();
+  }
+  MARK(CYCLES_DONE);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,39 @@
+/**
+ * \file
+ *         Operations timed by nRF24-cycles, shared with the simavr harness
+ *         in tools/nrf24-avr-bench
+ *
+ *         The firmware writes the operation to GPIOR0 before it and
+ *         CYCLES_END after it. The harness takes the cycle counter at both
+ *         writes. A write to GPIOR1 asks the harness's peer radio for
+ *         something.
+ */
+
+#ifndef NRF24_CYCLES_H
+#define NRF24_CYCLES_H
+
+enum cycles_op {
+  CYCLES_END,
+  CYCLES_MARKER,          /**< Nothing, the cost of the marks themselves */
+  CYCLES_DIGITAL_WRITE,   /**< digitalWrite() of CSN */
+  CYCLES_SPI_BYTE,        /**< spi_write_byte() of a NOP */
+  CYCLES_STOP_LISTENING,
+  CYCLES_START_LISTENING,
+  CYCLES_SEND_UNICAST,    /**< nRF24_driver.send(), acknowledged by the peer */
+  CYCLES_SEND_BROADCAST,
+  CYCLES_READ,            /**< nRF24_driver.read() of a frame from the peer */
+  CYCLES_OPS,
+  CYCLES_DONE = 0xff      /**< All operations ran */
+};
+
+/* Requests to the peer */
+#define CYCLES_PEER_SEND 1  /**< Send a payload to the node */
+
+/* Node addresses: the firmware is built with NODEID=CYCLES_NODE */
+#define CYCLES_NODE 1
+#define CYCLES_PEER 2
+
+/* Times each operation runs */
+#define CYCLES_REPEAT 8
+
+#endif /* NRF24_CYCLES_H */
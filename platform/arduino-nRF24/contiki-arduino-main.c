@@ -56,6 +56,7 @@
 //#include "sicslowmac.h"
 
 #include "platform-conf.h"
+#include "nRF24_sleep.h"
 
 #if 0
 FUSES =
@@ -112,12 +113,31 @@ main(void)
   /* Clock */
   clock_init();
 
+  /* Timer1, also used for the nRF24 timestamps */
+  rtimer_init();
+
   /* Process subsystem */
   process_init();
 
   /* Register initial processes */
   procinit_init();
 
+  /* Callback timers, used by Rime and the nRF24 MAC */
+  ctimer_init();
+
+#ifdef NODEID
+  /* Rime address, its first byte also selects the nRF24 pipe address */
+  {
+    rimeaddr_t addr = {{ NODEID & 0xff, NODEID >> 8 }};
+    rimeaddr_set_node_addr(&addr);
+  }
+#endif
+
+#if defined (nRF24_SLEEP)
+  /* Wake up on the nRF24 IRQ line */
+  nRF24_sleep_init();
+#endif
+
 
   //Give ourselves a prefix
   //init_net();
@@ -139,6 +159,11 @@ main(void)
 
     process_run();
 
+#if defined (nRF24_SLEEP)
+    /* Returns at once while events are pending */
+    nRF24_sleep();
+#endif
+
   } while (1);
 
   return 0;
@@ -55,8 +55,16 @@ void clock_delay_msec(uint16_t howlong);
 /* Network setup for non-IPv6 (rime). */
 
 #define NETSTACK_CONF_NETWORK rime_driver
+#if defined (nRF24_AGGREGATION)
+#define NETSTACK_CONF_MAC     nRF24_aggr_driver
+#else
 #define NETSTACK_CONF_MAC     nullmac_driver
+#endif
+#if defined (nRF24_TDMA)
+#define NETSTACK_CONF_RDC     nRF24_tdma_driver
+#else
 #define NETSTACK_CONF_RDC     nullrdc_driver
+#endif
 #define NETSTACK_CONF_FRAMER  framer_nullmac
 #define NETSTACK_CONF_RADIO   nRF24_driver
 
@@ -65,6 +73,14 @@ void clock_delay_msec(uint16_t howlong);
 
 #define PACKETBUF_CONF_ATTRS_INLINE 1
 
+/* Timer1 runs rtimer and the nRF24 timestamps: 4us ticks at 16MHz, with
+ * the 16 bit counter wrapping every 262ms. */
+#if F_CPU >= 8000000UL
+#define RTIMER_ARCH_PRESCALER 64UL
+#else
+#define RTIMER_ARCH_PRESCALER 8UL
+#endif
+
 #ifndef RF_CHANNEL
 #define RF_CHANNEL              26
 #endif /* RF_CHANNEL */
@@ -89,6 +105,9 @@ void clock_delay_msec(uint16_t howlong);
 
 
 typedef unsigned short clock_time_t;
+
+/* Also from cpu/avr/clock.c, advances the clock after a sleep without ticks */
+void clock_adjust_ticks(clock_time_t howmany);
 typedef unsigned short uip_stats_t;
 typedef unsigned long off_t;
 
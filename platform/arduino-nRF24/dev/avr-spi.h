@@ -4,6 +4,7 @@
 #include <Arduino.h>
 #include <dev/spi.h>
 #include "contiki-conf.h"
+#include "nRF24_stats.h"
 
 #ifndef LSBFIRST
 #define LSBFIRST 0
@@ -29,8 +30,17 @@
 #define SPI_CLOCK_MASK 0x03  // SPR1 = bit 1, SPR0 = bit 0 on SPCR
 #define SPI_2XCLOCK_MASK 0x01  // SPI2X = bit 0 on SPSR
 
+#if defined (nRF24_HOST)
+// Host build, the bus is the mock of tools/nrf24-spi-bench
+uint8_t nRF24_host_spi(uint8_t data);
+#endif
+
 // Write to the SPI bus (MOSI pin) and also receive (MISO pin)
 inline static uint8_t spi_write_byte(uint8_t data) {
+#if defined (nRF24_HOST)
+  nRF24_STATS_INC(spi_bytes);
+  return nRF24_host_spi(data);
+#else
   spi_busy = 1;
   
   SPDR = data;
@@ -44,11 +54,14 @@ inline static uint8_t spi_write_byte(uint8_t data) {
   while (!(SPSR & _BV(SPIF))) ; // wait
   
   spi_busy = 0;
+  nRF24_STATS_INC(spi_bytes);
   return SPDR;
+#endif
 }
 
 inline static void spi_write_block(void *buf, size_t count) {
   if (count == 0) return;
+  nRF24_STATS_ADD(spi_bytes, count);
   spi_busy = 1;
   uint8_t *p = (uint8_t *)buf;
   SPDR = *p;
@@ -0,0 +1,145 @@
+#include "nRF24_arch.h"
+#include "nRF24_trace.h"
+
+#define RTIMER_PER_CLOCK (RTIMER_ARCH_SECOND / CLOCK_SECOND)
+
+/****************************************************************************/
+
+void
+nRF24_deadline_set(struct nRF24_deadline *d, uint32_t us)
+{
+  d->last = RTIMER_NOW();
+  d->last_clock = clock_time();
+  d->left = (us + nRF24_TICK_US - 1) / nRF24_TICK_US;
+}
+
+/****************************************************************************/
+
+bool
+nRF24_deadline_expired(struct nRF24_deadline *d)
+{
+  rtimer_clock_t now = RTIMER_NOW();
+  clock_time_t now_clock = clock_time();
+  uint32_t elapsed = (uint32_t)(clock_time_t)(now_clock - d->last_clock) * RTIMER_PER_CLOCK;
+
+  // Within half a wrap the rtimer is exact, beyond it only the clock is right
+  if(elapsed < 0x8000){
+    elapsed = (rtimer_clock_t)(now - d->last);
+  }
+  d->last = now;
+  d->last_clock = now_clock;
+  if(elapsed >= d->left){
+    d->left = 0;
+    return true;
+  }
+  d->left -= elapsed;
+  return false;
+}
+
+/****************************************************************************/
+
+#if defined (nRF24_TIMESTAMP)
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+static volatile uint16_t overflows; /**< Upper half of the 32 bit timebase */
+static volatile uint32_t captured;  /**< Last IRQ edge */
+static volatile bool fresh;         /**< Whether captured was not taken yet */
+
+/****************************************************************************/
+
+/* Extend a Timer1 value read with interrupts off. A pending overflow has
+ * not been counted yet, but only applies if the value was read after it. */
+static uint32_t
+extend(uint16_t low)
+{
+  uint16_t high = overflows;
+
+  if((TIFR1 & _BV(TOV1)) && low < 0x8000){
+    high++;
+  }
+  return ((uint32_t)high << 16) | low;
+}
+
+/****************************************************************************/
+
+static void
+latch(void)
+{
+  captured = extend(ICR1);
+  fresh = true;
+}
+
+/****************************************************************************/
+
+void
+nRF24_arch_init(void)
+{
+  uint8_t sreg = SREG;
+
+  cli();
+  // IRQ pin as input, the radio drives it push-pull
+  DDRB &= ~_BV(DDB0);
+  // Falling edge, with the noise canceler (a constant 4 cycle delay)
+  TCCR1B = (TCCR1B & ~_BV(ICES1)) | _BV(ICNC1);
+  TIFR1 = _BV(ICF1) | _BV(TOV1);
+  TIMSK1 |= _BV(ICIE1) | _BV(TOIE1);
+  overflows = 0;
+  fresh = false;
+  SREG = sreg;
+}
+
+/****************************************************************************/
+
+uint32_t
+nRF24_arch_now(void)
+{
+  uint32_t now;
+  uint8_t sreg = SREG;
+
+  cli();
+  now = extend(TCNT1);
+  SREG = sreg;
+  return now;
+}
+
+/****************************************************************************/
+
+bool
+nRF24_arch_capture(uint32_t *time)
+{
+  bool taken;
+  uint8_t sreg = SREG;
+
+  cli();
+  // The edge may be latched while interrupts were off
+  if(TIFR1 & _BV(ICF1)){
+    latch();
+    TIFR1 = _BV(ICF1);
+  }
+  taken = fresh;
+  *time = captured;
+  fresh = false;
+  SREG = sreg;
+  return taken;
+}
+
+/****************************************************************************/
+
+ISR(TIMER1_OVF_vect)
+{
+  overflows++;
+}
+
+/****************************************************************************/
+
+ISR(TIMER1_CAPT_vect)
+{
+  nRF24_TRACE_BEGIN(RF24_TRACE_CAPTURE_ISR);
+  latch();
+  process_poll(&nRF24_process);
+  nRF24_TRACE_END(RF24_TRACE_CAPTURE_ISR);
+}
+
+#endif /* defined (nRF24_TIMESTAMP) */
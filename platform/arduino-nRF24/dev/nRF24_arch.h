@@ -0,0 +1,95 @@
+/**
+ * \file
+ *         Timer1 timebase and IRQ capture for the nRF24 driver
+ *
+ *         The nRF24 IRQ line (active low) is wired to ICP1 (Arduino pin 8).
+ *         Timer1 is the rtimer, and its input capture unit latches TCNT1 on
+ *         the falling edge in hardware, so RX_DR and TX_DS get a timestamp
+ *         free of interrupt latency. The overflow interrupt extends TCNT1
+ *         to 32 bits so timestamps can be compared over minutes.
+ *
+ *         Timestamps are in rtimer ticks (RTIMER_ARCH_SECOND per second).
+ *
+ *         Enable with nRF24_TIMESTAMP in platform-conf.h. Call rtimer_init()
+ *         before the radio init so Timer1 is running.
+ *
+ *         The deadlines below only read Timer1 and are always available.
+ */
+
+#ifndef nRF24_ARCH_H
+#define nRF24_ARCH_H
+
+#include "contiki.h"
+#include "nRF24_driver.h"
+
+/**
+ * Length of one timestamp tick in microseconds. The rtimer prescalers set
+ * in contiki-conf.h keep this a whole number.
+ */
+#define nRF24_TICK_US (1000000UL / RTIMER_ARCH_SECOND)
+
+/**
+ * Convert microseconds to timestamp ticks, rounding down
+ */
+#define nRF24_US_TO_TICKS(us) ((uint32_t)(us) / nRF24_TICK_US)
+
+/**
+ * Timeout with microsecond resolution on the rtimer timebase
+ *
+ * Each check subtracts the ticks since the previous one, so a deadline
+ * may run past the 16 bit rtimer wrap as long as it is checked at least
+ * once per wrap; checks further apart fall back to the clock. Any number
+ * of deadlines run at once, they are polled and take no rtimer slot.
+ * Resolution is nRF24_TICK_US: 2-8us over the supported F_CPU values.
+ */
+struct nRF24_deadline {
+  rtimer_clock_t last;      /**< rtimer at the last check */
+  clock_time_t last_clock;  /**< clock at the last check */
+  uint32_t left;            /**< Ticks left */
+};
+
+  /**
+   * Start a deadline
+   *
+   * @param d Deadline to set
+   * @param us Microseconds from now, rounded up to whole ticks so it
+   * never expires early
+   */
+  void nRF24_deadline_set(struct nRF24_deadline *d, uint32_t us);
+
+  /**
+   * Whether a deadline has passed
+   *
+   * @param d Deadline to check
+   * @return True once the time given to nRF24_deadline_set() has passed
+   */
+  bool nRF24_deadline_expired(struct nRF24_deadline *d);
+
+#if defined (nRF24_TIMESTAMP)
+
+  /**
+   * Enable the capture and overflow interrupts of Timer1
+   *
+   * Leaves the prescaler and compare unit to rtimer.
+   */
+  void nRF24_arch_init(void);
+
+  /**
+   * Current time on the 32 bit timebase
+   */
+  uint32_t nRF24_arch_now(void);
+
+  /**
+   * Take the last IRQ edge captured, if not taken yet
+   *
+   * The IRQ line stays low until STATUS is cleared, so only the first event
+   * of a burst gets an edge. Each capture is handed out once.
+   *
+   * @param time Where to store the capture
+   * @return True if a new capture was available
+   */
+  bool nRF24_arch_capture(uint32_t *time);
+
+#endif /* defined (nRF24_TIMESTAMP) */
+
+#endif /* nRF24_ARCH_H */
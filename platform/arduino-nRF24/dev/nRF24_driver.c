@@ -1,18 +1,114 @@
 #include "nRF24_driver.h"
 #include "nRF24L01.h"
+#include "nRF24_esb.h"
+#include "nRF24_arch.h"
+#include "nRF24_linkadapt.h"
+#include "nRF24_linkest.h"
+#include "nRF24_power.h"
+#include "nRF24_stats.h"
+#include "nRF24_trace.h"
+#include "nRF24_sniffer.h"
+#include "nRF24_log.h"
+#include "net/packetbuf.h"
+#include "net/netstack.h"
 
 
 /**
- * Private variables
+ * Private variables, per radio. The functions below work on the radio
+ * selected with nRF24_select(), through the radio pointer.
  */
-uint8_t ce_pin; /**< "Chip Enable" pin, activates the RX or TX role */
-uint8_t csn_pin; /**< SPI Chip select */
-bool p_variant; /* False for RF24L01 and true for RF24L01P */
-uint8_t payload_size; /**< Fixed size of payloads */
-bool dynamic_payloads_enabled; /**< Whether dynamic payloads are enabled. */
-uint8_t pipe0_reading_address[5]; /**< Last address set on pipe 0 for reading. */
-uint8_t addr_width; /**< The address width to use - 3,4 or 5 bytes. */
-uint32_t txRxDelay; /**< Var for adjusting delays depending on datarate */
+struct nRF24_radio {
+  uint8_t ce_pin; /**< "Chip Enable" pin, activates the RX or TX role */
+  uint8_t csn_pin; /**< SPI Chip select */
+  bool p_variant; /* False for RF24L01 and true for RF24L01P */
+#if !defined (nRF24_FIXED_CONFIG)
+  uint8_t payload_size; /**< Fixed size of payloads */
+  bool dynamic_payloads_enabled; /**< Whether dynamic payloads are enabled. */
+  uint8_t addr_width; /**< The address width to use - 3,4 or 5 bytes. */
+#endif
+  uint8_t pipe0_reading_address[5]; /**< Last address set on pipe 0 for reading. */
+  uint32_t txRxDelay; /**< Var for adjusting delays depending on datarate */
+  rf24_datarate_e data_rate; /**< Data rate currently programmed */
+  uint8_t crc_length; /**< CRC length in bytes, 0-2 */
+  bool ack_payloads_enabled; /**< Whether ACKs may carry a payload */
+  uint8_t ack_payload_size; /**< Largest ACK payload expected from the receiver */
+  uint8_t retry_count; /**< Retry count used when the retry delay is automatic */
+  bool auto_retry_delay; /**< Whether ARD follows the ESB timing model */
+  bool listening; /**< Whether startListening() was called last */
+  bool listen_pending; /**< Whether beginStartListening() waits for the settling to end */
+  uint8_t tx_node; /**< Node byte TX_ADDR and RX_ADDR_P0 point at */
+  bool tx_node_valid; /**< False once TX_ADDR or RX_ADDR_P0 were written otherwise */
+  uint8_t settling; /**< Transition in progress, one of the SETTLE_ values */
+  struct nRF24_deadline settle; /**< When it is due */
+#if defined (nRF24_STATS)
+  bool rx_full; /**< Whether the RX FIFO was full at the last look */
+#endif
+#if defined (nRF24_ACK_PAYLOAD_TTL)
+  bool ack_pending; /**< Whether ACK payloads were written and may still be queued */
+  struct nRF24_deadline ack_expiry; /**< When they are flushed */
+#endif
+#if defined (nRF24_NBR_TABLE)
+  struct nRF24_nbr *tx_nbr; /**< Destination of the send in progress, NULL if unknown */
+  uint8_t last_plos; /**< PLOS_CNT after the previous acknowledged send */
+#endif
+#if defined (nRF24_DUP_CACHE)
+  uint8_t tx_seq; /**< Link sequence number of the next new frame */
+  bool retry_valid; /**< Whether the last unicast frame went unacknowledged */
+  uint8_t retry_node, retry_len, retry_seq; /**< That frame's node, length and sequence number */
+  uint16_t retry_sum; /**< Checksum of that frame's payload */
+  struct {
+    uint8_t node;
+    uint8_t seq;
+  } dup_cache[nRF24_DUP_CACHE]; /**< Last sequence number per sender, most recent first */
+  uint8_t dup_count; /**< Senders in dup_cache */
+  uint8_t rx_node; /**< Sender's node byte of the last frame read */
+  uint16_t duplicates; /**< Frames dropped as duplicates */
+#endif
+#if defined (nRF24_TIMESTAMP)
+  uint32_t tx_time; /**< End of the last frame sent, in rtimer ticks */
+  uint32_t rx_time; /**< End of the last frame read, in rtimer ticks */
+  bool tx_time_valid; /**< Whether tx_time belongs to the last frame sent */
+  bool rx_time_valid; /**< Whether rx_time belongs to the last frame read */
+#endif
+#if defined (nRF24_TIMESTAMP) || defined (nRF24_SLEEP)
+  struct process *tx_process; /**< Polled on IRQ edges while not listening */
+#endif
+#if nRF24_RADIOS > 1
+  uint8_t irq_pin; /**< IRQ pin, nRF24_NO_PIN if not wired */
+  bool drained; /**< Whether the RX FIFO was emptied since listening started */
+  void (*input)(void); /**< Where received frames go, NULL for the netstack */
+#endif
+};
+
+#if nRF24_RADIOS > 1
+static struct nRF24_radio radios[nRF24_RADIOS];
+static struct nRF24_radio *radio = &radios[0];
+static uint8_t selected; /**< Index of *radio */
+static const uint8_t radio_pins[nRF24_RADIOS][3] PROGMEM = nRF24_RADIO_PINS;
+#else
+static struct nRF24_radio radios[1];
+/* A constant address, the fields compile to plain globals */
+#define radio (&radios[0])
+#endif
+
+/* With nRF24_FIXED_CONFIG these are the constants of platform-conf.h, so
+ * the compiler drops the branches and loops they decide */
+#if defined (nRF24_FIXED_CONFIG)
+#define PAYLOAD_SIZE (nRF24_PAYLOAD)
+#define DYNAMIC_PAYLOADS (nRF24_AUTO_PAYLOAD_SIZE)
+#define ADDR_WIDTH (nRF24_ADRESS_SIZE)
+#else
+#define PAYLOAD_SIZE (radio->payload_size)
+#define DYNAMIC_PAYLOADS (radio->dynamic_payloads_enabled)
+#define ADDR_WIDTH (radio->addr_width)
+#endif
+
+PROCESS(nRF24_process, "nRF24 driver");
+
+/* Mode transitions, see progress() */
+enum { SETTLE_NONE, SETTLE_RESET, SETTLE_WAKING, SETTLE_TURNAROUND, SETTLE_RECOVERY };
+
+static void nRF24_configure(void);
 
 /**
  * Private functions
@@ -74,6 +170,17 @@ uint32_t txRxDelay; /**< Var for adjusting delays depending on datarate */
    */
   uint8_t nRF24_write_register_block(uint8_t reg, const uint8_t* buf, uint8_t len);
 
+  /**
+   * Write an address register, the address width bytes of it
+   *
+   * With nRF24_FIXED_CONFIG the width is known and the bytes are written
+   * one after the other, without a loop.
+   *
+   * @param reg RX_ADDR_P0, RX_ADDR_P1 or TX_ADDR
+   * @param address Where to get the address, LSB first
+   */
+  void nRF24_write_address(uint8_t reg, const uint8_t* address);
+
   /**
    * Write a single byte to a register
    *
@@ -178,6 +285,70 @@ uint32_t txRxDelay; /**< Var for adjusting delays depending on datarate */
    */
 
   uint8_t nRF24_spiTrans(uint8_t cmd);
+
+  /**
+   * Program the shortest safe auto retransmit delay
+   *
+   * Called whenever the data rate, address width, CRC or ACK payload
+   * settings change. Does nothing after setRetries() fixed the delay.
+   *
+   * @see nRF24_esb.h
+   */
+  void nRF24_update_retry_delay(void);
+
+#if defined (nRF24_NBR_TABLE)
+  /**
+   * Read OBSERVE_TX after an acknowledged send and hand the outcome to
+   * link adaptation and link estimation
+   *
+   * PLOS_CNT stops counting at 15, so it is reset by rewriting RF_CH
+   * before it gets there.
+   *
+   * @param delivered False if the send ended with MAX_RT
+   */
+  void nRF24_tx_feedback(bool delivered);
+#endif
+
+  /**
+   * Build the ESB address of a node, the node byte followed by
+   * nRF24_NET_ADDRESS
+   *
+   * @param node Node byte, nRF24_BROADCAST_NODE for broadcast
+   * @param address Where to store the addr_width bytes
+   */
+  void nRF24_node_address(uint8_t node, uint8_t *address);
+
+  /**
+   * Begin a mode transition, completed by progress()
+   *
+   * @param what One of the SETTLE_ values
+   * @param us Settling time in microseconds
+   */
+  void nRF24_settle_start(uint8_t what, uint16_t us);
+
+#if defined (nRF24_DUP_CACHE)
+  /**
+   * Read the receive payload behind the link header
+   *
+   * Like read_payload(), but the header is checked against the duplicate
+   * cache first. The payload of a duplicate is clocked out and not stored.
+   *
+   * @param buf Where to put the data
+   * @param len Payload length, header included
+   * @param dup Set to true if the frame is a duplicate
+   * @return Current value of status register
+   */
+  uint8_t nRF24_read_link_payload(void *buf, uint8_t len, bool *dup);
+
+  /**
+   * Remember the sequence number of a sender
+   *
+   * @param node Node byte of the sender
+   * @param seq Link sequence number of its frame
+   * @return True if the last frame heard from @p node had the same number
+   */
+  bool nRF24_duplicate(uint8_t node, uint8_t seq);
+#endif
   
   #if defined (FAILURE_HANDLING)
 	void nRF24_errNotify(void);
@@ -219,6 +390,37 @@ static const char * const rf24_pa_dbm_e_str_P[] PROGMEM = {
 };
 #endif
 
+#if nRF24_RADIOS > 1
+/****************************************************************************/
+
+uint8_t
+nRF24_select(uint8_t r)
+{
+  uint8_t prev = selected;
+
+  selected = r;
+  radio = &radios[r];
+  nRF24_power_select(r);
+  return prev;
+}
+
+/****************************************************************************/
+
+uint8_t
+nRF24_selected(void)
+{
+  return selected;
+}
+
+/****************************************************************************/
+
+void
+nRF24_setInput(uint8_t r, void (*input)(void))
+{
+  radios[r].input = input;
+}
+#endif /* nRF24_RADIOS > 1 */
+
 /****************************************************************************/
  
 void
@@ -230,7 +432,16 @@ nRF24_csn(bool mode)
   // CLK:BUS 8Mhz:2Mhz, 16Mhz:4Mhz, or 20Mhz:5Mhz
 	spi_init();
 
-	digitalWrite(csn_pin,mode);	
+	if(!mode){
+	  // Registers written before init() has settled may not stick
+	  while(radio->settling == SETTLE_RESET){
+	    nRF24_progress();
+	  }
+	}
+	digitalWrite(radio->csn_pin,mode);	
+	if(!mode){
+	  nRF24_STATS_INC(spi_transactions);
+	}
 
 
 }
@@ -239,7 +450,11 @@ nRF24_csn(bool mode)
 
 void
 nRF24_ce(bool level) {
-  if (ce_pin != csn_pin) digitalWrite(ce_pin,level);
+  if (radio->ce_pin != radio->csn_pin) digitalWrite(radio->ce_pin,level);
+  // While listening CE stays high, RX is reported by start/stopListening
+  if(!radio->listening && nRF24_power_state() != RF24_POWER_DOWN){
+    nRF24_power_enter(level ? RF24_TX : RF24_STANDBY);
+  }
 }
 
 /****************************************************************************/
@@ -300,13 +515,36 @@ nRF24_write_register_block(uint8_t reg, const uint8_t* buf, uint8_t len)
 
 /****************************************************************************/
 
+void
+nRF24_write_address(uint8_t reg, const uint8_t* address)
+{
+#if defined (nRF24_FIXED_CONFIG)
+  nRF24_csn(LOW);
+  spi_write_byte( W_REGISTER | ( REGISTER_MASK & reg ) );
+  spi_write_byte(address[0]);
+  spi_write_byte(address[1]);
+  spi_write_byte(address[2]);
+#if nRF24_ADRESS_SIZE > 3
+  spi_write_byte(address[3]);
+#endif
+#if nRF24_ADRESS_SIZE > 4
+  spi_write_byte(address[4]);
+#endif
+  nRF24_csn(HIGH);
+#else
+  nRF24_write_register_block(reg, address, ADDR_WIDTH);
+#endif
+}
+
+/****************************************************************************/
+
 
 uint8_t
 nRF24_write_register(uint8_t reg, uint8_t value)
 {
   uint8_t status;
 
-  IF_SERIAL_DEBUG(printf_P(PSTR("write_register(%02x,%02x)\r\n"),reg,value));
+  nRF24_LOG2(RF24_LOG_WRITE_REGISTER, reg, value);
 
   nRF24_csn(LOW);
   status = spi_write_byte( W_REGISTER | ( REGISTER_MASK & reg ) );
@@ -326,12 +564,13 @@ nRF24_write_payload(const void* buf, uint8_t data_len, const uint8_t writeType)
   uint8_t status;
   const uint8_t* current = (const uint8_t*)(buf);
 
-   data_len = rf24_min(data_len, payload_size);
-   uint8_t blank_len = dynamic_payloads_enabled ? 0 : payload_size - data_len;
+   data_len = rf24_min(data_len, PAYLOAD_SIZE);
+   uint8_t blank_len = DYNAMIC_PAYLOADS ? 0 : PAYLOAD_SIZE - data_len;
   
   //printf("[Writing %u bytes %u blanks]",data_len,blank_len);
-  IF_SERIAL_DEBUG( printf_P("[Writing %u bytes %u blanks]\n",data_len,blank_len); );
+  nRF24_LOG2(RF24_LOG_WRITE_PAYLOAD, data_len, blank_len);
   
+  nRF24_TRACE_BEGIN(RF24_TRACE_WRITE_PAYLOAD);
   nRF24_csn(LOW);
   
   status = spi_write_byte( writeType );
@@ -342,6 +581,7 @@ nRF24_write_payload(const void* buf, uint8_t data_len, const uint8_t writeType)
     spi_write_byte(0);
   }
   nRF24_csn(HIGH);
+  nRF24_TRACE_END(RF24_TRACE_WRITE_PAYLOAD);
 
   return status;
 }
@@ -354,13 +594,14 @@ nRF24_read_payload(void* buf, uint8_t data_len)
   uint8_t status;
   uint8_t* current = (uint8_t*)(buf);
 
-  if(data_len > payload_size) data_len = payload_size;
-  uint8_t blank_len = dynamic_payloads_enabled ? 0 : payload_size - data_len;
+  if(data_len > PAYLOAD_SIZE) data_len = PAYLOAD_SIZE;
+  uint8_t blank_len = DYNAMIC_PAYLOADS ? 0 : PAYLOAD_SIZE - data_len;
   
   //printf("[Reading %u bytes %u blanks]",data_len,blank_len);
 
-  IF_SERIAL_DEBUG( printf_P("[Reading %u bytes %u blanks]\n",data_len,blank_len); );
+  nRF24_LOG2(RF24_LOG_READ_PAYLOAD, data_len, blank_len);
   
+  nRF24_TRACE_BEGIN(RF24_TRACE_READ_PAYLOAD);
   nRF24_csn(LOW);
   
   status = spi_write_byte( R_RX_PAYLOAD );
@@ -371,9 +612,48 @@ nRF24_read_payload(void* buf, uint8_t data_len)
     spi_write_byte(0xff);
   }
   nRF24_csn(HIGH);
+  nRF24_TRACE_END(RF24_TRACE_READ_PAYLOAD);
+
+  return status;
+}
+
+/****************************************************************************/
+
+#if defined (nRF24_DUP_CACHE)
+uint8_t
+nRF24_read_link_payload(void *buf, uint8_t len, bool *dup)
+{
+  uint8_t status;
+  uint8_t* current = (uint8_t*)(buf);
+  uint8_t node;
+
+  if(len > PAYLOAD_SIZE) len = PAYLOAD_SIZE;
+  uint8_t blank_len = (DYNAMIC_PAYLOADS ? 0 : PAYLOAD_SIZE - len);
+
+  nRF24_TRACE_BEGIN(RF24_TRACE_READ_PAYLOAD);
+  nRF24_csn(LOW);
+
+  status = spi_write_byte( R_RX_PAYLOAD );
+  node = spi_write_byte(0xFF);
+  radio->rx_node = node;
+  *dup = nRF24_duplicate(node, spi_write_byte(0xFF));
+  len -= nRF24_LINK_HEADER_LEN;
+  if(*dup){
+    blank_len += len;
+    len = 0;
+  }
+  while ( len-- ) {
+    *current++ = spi_write_byte(0xFF);
+  }
+  while ( blank_len-- ) {
+    spi_write_byte(0xff);
+  }
+  nRF24_csn(HIGH);
+  nRF24_TRACE_END(RF24_TRACE_READ_PAYLOAD);
 
   return status;
 }
+#endif
 
 /****************************************************************************/
 
@@ -433,10 +713,10 @@ nRF24_printDetails(void)
   nRF24_print_byte_register(PSTR("CONFIG"),CONFIG,1);
   nRF24_print_byte_register(PSTR("DYNPD/FEATURE"),DYNPD,2);
   
-  printf_P(PSTR("Data Rate\t = %s\r\n"), pgm_read_word(&rf24_datarate_e_str_P[nRF24_getDataRate()]));
-  printf_P(PSTR("Model\t\t = %s\r\n"),   pgm_read_word(&rf24_model_e_str_P[nRF24_isPVariant()]));
-  printf_P(PSTR("CRC Length\t = %s\r\n"),pgm_read_word(&rf24_crclength_e_str_P[nRF24_getCRCLength()]));
-  printf_P(PSTR("PA Power\t = %s\r\n"),  pgm_read_word(&rf24_pa_dbm_e_str_P[nRF24_getPALevel()]));
+  printf_P(PSTR("Data Rate\t = " PRIPSTR "\r\n"), pgm_read_word(&rf24_datarate_e_str_P[nRF24_getDataRate()]));
+  printf_P(PSTR("Model\t\t = " PRIPSTR "\r\n"),   pgm_read_word(&rf24_model_e_str_P[nRF24_isPVariant()]));
+  printf_P(PSTR("CRC Length\t = " PRIPSTR "\r\n"),pgm_read_word(&rf24_crclength_e_str_P[nRF24_getCRCLength()]));
+  printf_P(PSTR("PA Power\t = " PRIPSTR "\r\n"),  pgm_read_word(&rf24_pa_dbm_e_str_P[nRF24_getPALevel()]));
 
 }
 
@@ -493,7 +773,7 @@ nRF24_print_address_register(const char* name, uint8_t reg, uint8_t qty)
 
   while (qty--)
   {
-    uint8_t buffer[addr_width];
+    uint8_t buffer[ADDR_WIDTH];
     nRF24_read_register_block(reg++,buffer,sizeof buffer);
 
     printf_P(PSTR(" 0x"));
@@ -517,33 +797,46 @@ nRF24_setChannel(uint8_t channel)
 
 /****************************************************************************/
 
+#if !defined (nRF24_FIXED_CONFIG)
 void
 nRF24_setPayloadSize(uint8_t size)
 {
-  payload_size = rf24_min(size,32);
+  radio->payload_size = rf24_min(size,32);
 }
 
 /****************************************************************************/
+#endif
 
 uint8_t
 nRF24_getPayloadSize(void)
 {
-  return payload_size;
+  return PAYLOAD_SIZE;
 }
 
 /****************************************************************************/
 
 /****************************************************************************/
 
-void
-nRF24_startListening(void)
+/* The part of startListening() that needs a settled radio */
+static void
+nRF24_listen(void)
 {
   nRF24_write_register(CONFIG, nRF24_read_register(CONFIG) | _BV(PRIM_RX));
   nRF24_write_register(STATUS, _BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT) );
+  radio->listening = true;
+#if nRF24_RADIOS > 1
+  // Frames may be waiting with RX_DR cleared, the IRQ pin does not show them
+  radio->drained = false;
+#endif
   nRF24_ce(HIGH);
+  nRF24_power_enter(RF24_RX);
+#if defined (nRF24_TIMESTAMP)
+  // Drop an edge left by a TX event, the next one is RX_DR
+  nRF24_arch_capture(&radio->rx_time);
+#endif
   // Restore the pipe0 adddress, if exists
-  if (pipe0_reading_address[0] > 0){
-    nRF24_write_register_block(RX_ADDR_P0, pipe0_reading_address, addr_width);	
+  if (radio->pipe0_reading_address[0] > 0){
+    nRF24_write_address(RX_ADDR_P0, radio->pipe0_reading_address);	
   }else{
 	nRF24_closeReadingPipe(0);
   }
@@ -556,6 +849,39 @@ nRF24_startListening(void)
 
   // Go!
   //clock_delay_usec(100);
+
+  // Let the driver process pick up what arrives
+  process_poll(&nRF24_process);
+}
+
+/****************************************************************************/
+
+void
+nRF24_startListening(void)
+{
+  nRF24_beginStartListening();
+  // Waits only if a wake up is still settling
+  nRF24_settle();
+}
+
+/****************************************************************************/
+
+void
+nRF24_beginStartListening(void)
+{
+  if(radio->settling == SETTLE_TURNAROUND){
+    // Back to RX before the turnaround ended, PRIM_RX is still set
+    radio->settling = SETTLE_NONE;
+  }
+  if(radio->settling != SETTLE_RESET && nRF24_power_state() == RF24_POWER_DOWN){
+    nRF24_startPowerUp();
+  }
+  if(nRF24_progress() == RF24_BUSY){
+    // progress() listens once the radio has settled
+    radio->listen_pending = true;
+    return;
+  }
+  nRF24_listen();
 }
 
 /****************************************************************************/
@@ -567,21 +893,102 @@ const uint8_t child_pipe_enable[] PROGMEM =
 void
 nRF24_stopListening(void)
 {  
+  nRF24_beginStopListening();
+  nRF24_settle();
+}
+
+/****************************************************************************/
+
+void
+nRF24_beginStopListening(void)
+{
+  if(radio->settling == SETTLE_RESET || (radio->listen_pending && !radio->listening)){
+    // Still settling, PRIM_RX was never set so there is nothing to turn around
+    radio->listen_pending = false;
+    return;
+  }
+  radio->listen_pending = false;
   nRF24_ce(LOW);
+  radio->listening = false;
 
-    clock_delay_usec(txRxDelay);
-  
-  if(nRF24_read_register(FEATURE) & _BV(EN_ACK_PAY)){
-    clock_delay_usec(txRxDelay); //200
-	nRF24_flush_tx();
+  // An ACK payload takes longer to go out
+  nRF24_settle_start(SETTLE_TURNAROUND, radio->ack_payloads_enabled ? 2 * radio->txRxDelay : radio->txRxDelay);
+}
+
+/****************************************************************************/
+
+void
+nRF24_settle_start(uint8_t what, uint16_t us)
+{
+  radio->settling = what;
+  nRF24_deadline_set(&radio->settle, us);
+  nRF24_TRACE_BEGIN(RF24_TRACE_SETTLE);
+  // The driver process completes it if no caller waits for it
+  process_poll(&nRF24_process);
+}
+
+/****************************************************************************/
+
+rf24_progress_e
+nRF24_progress(void)
+{
+  switch(radio->settling){
+  case SETTLE_RESET:
+    if(!nRF24_deadline_expired(&radio->settle)){
+      return RF24_BUSY;
+    }
+    radio->settling = SETTLE_NONE;
+    nRF24_TRACE_END(RF24_TRACE_SETTLE);
+    nRF24_configure();
+    // Which left Power Down, a pending listen waits for that too
+    return nRF24_progress();
+
+  case SETTLE_WAKING:
+    if(!nRF24_power_ready()){
+      return RF24_BUSY;
+    }
+    break;
+
+  case SETTLE_TURNAROUND:
+    if(!nRF24_deadline_expired(&radio->settle)){
+      return RF24_BUSY;
+    }
+    if(radio->ack_payloads_enabled){
+      nRF24_flush_tx();
+    }
+    //nRF24_flush_rx();
+    nRF24_write_register(CONFIG, ( nRF24_read_register(CONFIG) ) & ~_BV(PRIM_RX) );
+    nRF24_write_register(EN_RXADDR,nRF24_read_register(EN_RXADDR) | _BV(pgm_read_byte(&child_pipe_enable[0]))); // Enable RX on pipe0
+    nRF24_power_enter(RF24_STANDBY);
+    break;
+
+  case SETTLE_RECOVERY:
+    if(!nRF24_deadline_expired(&radio->settle)){
+      return RF24_BUSY;
+    }
+    break;
+
+  case SETTLE_NONE:
+    return RF24_DONE;
   }
-  //nRF24_flush_rx();
-  nRF24_write_register(CONFIG, ( nRF24_read_register(CONFIG) ) & ~_BV(PRIM_RX) );
- 
-  nRF24_write_register(EN_RXADDR,nRF24_read_register(EN_RXADDR) | _BV(pgm_read_byte(&child_pipe_enable[0]))); // Enable RX on pipe0
-  
-  //clock_delay_usec(100);
+  radio->settling = SETTLE_NONE;
+  nRF24_TRACE_END(RF24_TRACE_SETTLE);
+  if(radio->listen_pending){
+    radio->listen_pending = false;
+    nRF24_listen();
+  }
+  return RF24_DONE;
+}
+
+/****************************************************************************/
 
+void
+nRF24_settle(void)
+{
+  rtimer_clock_t since = RTIMER_NOW();
+
+  while(nRF24_progress() == RF24_BUSY);
+  nRF24_STATS_WAITED(since);
 }
 
 /****************************************************************************/
@@ -589,29 +996,56 @@ nRF24_stopListening(void)
 int
 nRF24_powerDown(void)
 {
+  radio->listening = false;
+  radio->listen_pending = false;
   nRF24_ce(LOW); // Guarantee CE is low on powerDown
   nRF24_write_register(CONFIG,nRF24_read_register(CONFIG) & ~_BV(PWR_UP));
+  // After the write, which completes the settling of init()
+  radio->settling = SETTLE_NONE;
+  nRF24_power_enter(RF24_POWER_DOWN);
   return 1;
 }
 
 /****************************************************************************/
 
-//Power up now. Radio will not power down unless instructed by MCU for config changes etc.
+void
+nRF24_startPowerUp(void)
+{
+  uint8_t cfg = nRF24_read_register(CONFIG);
+
+  if (!(cfg & _BV(PWR_UP))){
+    nRF24_write_register(CONFIG, cfg | _BV(PWR_UP));
+  }
+  // Reported also if a reset of the MCU alone left the radio powered
+  nRF24_power_enter(RF24_STANDBY);
+  if(!nRF24_power_ready()){
+    radio->settling = SETTLE_WAKING;
+    // The driver process completes it if no caller waits for it
+    process_poll(&nRF24_process);
+  }
+}
+
+/****************************************************************************/
+
 int
-nRF24_powerUp(void)
+nRF24_on(void)
 {
-   uint8_t cfg = nRF24_read_register(CONFIG);
+  nRF24_startPowerUp();
+  return 1;
+}
 
-   // if not powered up then power up and wait for the radio to initialize
-   if (!(cfg & _BV(PWR_UP))){
-      nRF24_write_register(CONFIG,nRF24_read_register(CONFIG) | _BV(PWR_UP));
+/****************************************************************************/
 
-      // For nRF24L01+ to go from power down mode to TX or RX mode it must first pass through stand-by mode.
-	  // There must be a delay of Tpd2stby (see Table 16.) after the nRF24L01+ leaves power down mode before
-	  // the CEis set high. - Tpd2stby can be up to 5ms per the 1.0 datasheet
-      clock_delay_msec(5);
+//Power up now. Radio will not power down unless instructed by MCU for config changes etc.
+int
+nRF24_powerUp(void)
+{
+   nRF24_startPowerUp();
 
-   }
+   // For nRF24L01+ to go from power down mode to TX or RX mode it must first pass through stand-by mode.
+   // There must be a delay of Tpd2stby (see Table 16.) after the nRF24L01+ leaves power down mode before
+   // the CE is set high. Only what is left of it is waited, nothing if the wake up started early enough.
+   nRF24_settle();
    return 1;
 }
 
@@ -619,9 +1053,7 @@ nRF24_powerUp(void)
 #if defined (FAILURE_HANDLING)
 void
 nRF24_errNotify(){
-	#if defined (SERIAL_DEBUG)
-	  printf_P(PSTR("RF24 HARDWARE FAIL: Radio not responding, verify pin connections, wiring, etc.\r\n"));
-	#endif
+	nRF24_LOG0(RF24_LOG_HARDWARE_FAIL);
 	#if defined (FAILURE_HANDLING)
 	failureDetected = 1;
 	#else
@@ -635,18 +1067,26 @@ nRF24_errNotify(){
 bool
 nRF24_write( const void* buf, uint8_t len, const bool multicast )
 {
+#if defined (nRF24_TIMESTAMP)
+  // Drop a stale edge, the next one is this frame's TX_DS or MAX_RT
+  nRF24_arch_capture(&radio->tx_time);
+  radio->tx_time_valid = false;
+#endif
 	//Start Writing
 	nRF24_startFastWrite(buf,len,multicast,1);
+	nRF24_STATS_INC(tx);
 
 	//Wait until complete or failed
 	#if defined (FAILURE_HANDLING)
-		static struct timer t;							  //Get the time that the payload transmission started
-    timer_set(&t, 1+(85)*CLOCK_SECOND/1000); //As we may have problem with this conversion, adding 1 will round it up.
+		struct nRF24_deadline t;					  //Started with the payload transmission
+    nRF24_deadline_set(&t, nRF24_TX_TIMEOUT_US);
 	#endif 
+	rtimer_clock_t since = RTIMER_NOW();
+	nRF24_TRACE_BEGIN(RF24_TRACE_TX_WAIT);
 	
 	while( ! ( nRF24_get_status()  & ( _BV(TX_DS) | _BV(MAX_RT) ))) { 
 		#if defined (FAILURE_HANDLING)
-			if(timer_expired(&t)){			
+			if(nRF24_deadline_expired(&t)){			
 				nRF24_errNotify();
 				#if defined (FAILURE_HANDLING)
 				  return 0;		
@@ -656,11 +1096,42 @@ nRF24_write( const void* buf, uint8_t len, const bool multicast )
 			}
 		#endif
 	}
+	nRF24_TRACE_END(RF24_TRACE_TX_WAIT);
+	nRF24_STATS_WAITED(since);
     
 	nRF24_ce(LOW);
 
 	uint8_t status = nRF24_write_register(STATUS,_BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT) );
 
+#if defined (nRF24_STATS)
+  if(!multicast){
+    if(status & _BV(MAX_RT)){
+      nRF24_STATS_INC(tx_max_rt);
+    }else{
+      nRF24_STATS_INC(tx_acked);
+    }
+    nRF24_STATS_INC(retries[(nRF24_read_register(OBSERVE_TX) >> ARC_CNT) & 0x0f]);
+  }
+#endif
+
+#if defined (nRF24_TIMESTAMP)
+  radio->tx_time_valid = nRF24_arch_capture(&radio->tx_time) && !(status & _BV(MAX_RT));
+  if(radio->tx_time_valid && !multicast){
+    // The edge ends the last retransmission, while the receiver stamped the
+    // first copy it got. Only a frame that went through at once matches.
+    radio->tx_time_valid = !((nRF24_read_register(OBSERVE_TX) >> ARC_CNT) & 0x0f);
+    // TX_DS waits for the ACK, move the stamp back to the end of our frame.
+    // An ACK payload makes the ACK longer than assumed here.
+    radio->tx_time -= nRF24_US_TO_TICKS(nRF24_ESB_ACK_US(radio->data_rate, ADDR_WIDTH,
+                                          rf24_max(radio->crc_length,1), 0));
+  }
+#endif
+#if defined (nRF24_NBR_TABLE)
+  if(!multicast){
+    nRF24_tx_feedback(!(status & _BV(MAX_RT)));
+  }
+#endif
+
   //Max retries exceeded
   if( status & _BV(MAX_RT)){
   	nRF24_flush_tx(); //Only going to be 1 packet int the FIFO at a time using this method, so just flush
@@ -670,6 +1141,36 @@ nRF24_write( const void* buf, uint8_t len, const bool multicast )
   return 1;
 }
 
+/****************************************************************************/
+#if defined (nRF24_NBR_TABLE)
+void
+nRF24_tx_feedback(bool delivered)
+{
+  uint8_t observe_tx = nRF24_read_register(OBSERVE_TX);
+  uint8_t arc = (observe_tx >> ARC_CNT) & 0x0f;
+  uint8_t plos = (observe_tx >> PLOS_CNT) & 0x0f;
+#if defined (nRF24_LINK_ADAPTATION)
+  bool lost = !delivered || plos != radio->last_plos;
+#endif
+
+  if(plos == 0x0f){
+    // Writing RF_CH clears PLOS_CNT
+    nRF24_write_register(RF_CH, nRF24_read_register(RF_CH));
+    plos = 0;
+  }
+  radio->last_plos = plos;
+
+  if(radio->tx_nbr == NULL){
+    return;
+  }
+#if defined (nRF24_LINK_ADAPTATION)
+  nRF24_linkadapt_update(radio->tx_nbr, arc, lost);
+#endif
+#if defined (nRF24_LINK_ESTIMATE)
+  nRF24_linkest_tx(radio->tx_nbr, arc, delivered);
+#endif
+}
+#endif /* defined (nRF24_NBR_TABLE) */
 /****************************************************************************/
 
 //For general use, the interrupt flags are not important to clear
@@ -681,17 +1182,17 @@ nRF24_writeBlocking( const void* buf, uint8_t len, uint32_t timeout )
 	//This way the FIFO will fill up and allow blocking until packets go through
 	//The radio will auto-clear everything in the FIFO as long as CE remains high
 
-	static struct timer t;							  //Get the time that the payload transmission started
-  timer_set(&t, 1+(timeout)*CLOCK_SECOND/1000);
+	struct nRF24_deadline t;						  //Started with the payload transmission
+  nRF24_deadline_set(&t, timeout * 1000UL);
   
 	while( ( nRF24_get_status()  & ( _BV(TX_FULL) ))) {		  //Blocking only if FIFO is full. This will loop and block until TX is successful or timeout
 
 		if( nRF24_get_status() & _BV(MAX_RT)){					  //If MAX Retries have been reached
 			nRF24_reUseTX();										  //Set re-transmit and clear the MAX_RT interrupt flag
-			if(timer_expired(&t)){ return 0; }		  //If this payload has exceeded the user-defined timeout, exit and return 0
+			if(nRF24_deadline_expired(&t)){ return 0; }		  //If this payload has exceeded the user-defined timeout, exit and return 0
 		}
 		#if defined (FAILURE_HANDLING)
-			if(timer_expired(&t)){			
+			if(nRF24_deadline_expired(&t)){			
 				nRF24_errNotify();
 				#if defined (FAILURE_HANDLING)
 				return 0;			
@@ -728,8 +1229,8 @@ nRF24_writeFast( const void* buf, uint8_t len, const bool multicast )
 	//The radio will auto-clear everything in the FIFO as long as CE remains high
 
 	#if defined (FAILURE_HANDLING)
-		static struct timer t;							  //Get the time that the payload transmission started
-    timer_set(&t, 1+(85)*CLOCK_SECOND/1000); //As we may have problem with this conversion, adding 1 will round it up.
+		struct nRF24_deadline t;					  //Started with the payload transmission
+    nRF24_deadline_set(&t, nRF24_TX_TIMEOUT_US);
 	#endif
 	
 	while( ( nRF24_get_status()  & ( _BV(TX_FULL) ))) {			  //Blocking only if FIFO is full. This will loop and block until TX is successful or fail
@@ -741,7 +1242,7 @@ nRF24_writeFast( const void* buf, uint8_t len, const bool multicast )
 															  //From the user perspective, if you get a 0, just keep trying to send the same payload
 		}
 		#if defined (FAILURE_HANDLING)
-			if(timer_expired(&t)){			
+			if(nRF24_deadline_expired(&t)){			
 				nRF24_errNotify();
 				#if defined (FAILURE_HANDLING)
 				return 0;							
@@ -765,6 +1266,11 @@ nRF24_writeFast( const void* buf, uint8_t len, const bool multicast )
 void
 nRF24_startFastWrite( const void* buf, uint8_t len, const bool multicast, bool startTx){ //TMRh20
 
+	if(nRF24_power_state() == RF24_POWER_DOWN){
+		nRF24_startPowerUp();
+	}
+	nRF24_settle();
+
 	//nRF24_write_payload( buf,len);
 	nRF24_write_payload( buf, len,multicast ? W_TX_PAYLOAD_NO_ACK : W_TX_PAYLOAD ) ;
 	if(startTx){
@@ -780,6 +1286,11 @@ nRF24_startFastWrite( const void* buf, uint8_t len, const bool multicast, bool s
 void
 nRF24_startWrite( const void* buf, uint8_t len, const bool multicast ){
 
+  if(nRF24_power_state() == RF24_POWER_DOWN){
+    nRF24_startPowerUp();
+  }
+  nRF24_settle();
+
   // Send the payload
 
   //nRF24_write_payload( buf, len );
@@ -796,15 +1307,23 @@ bool
 nRF24_rxFifoFull(){
 	return nRF24_read_register(FIFO_STATUS) & _BV(RX_FULL);
 }
+
+/****************************************************************************/
+
+bool
+nRF24_txFifoEmpty(){
+	return nRF24_read_register(FIFO_STATUS) & _BV(TX_EMPTY);
+}
 /****************************************************************************/
 
 bool
 nRF24_txStandBy(){
 
   #if defined (FAILURE_HANDLING)
-		static struct timer t;							  //Get the time that the payload transmission started
-    timer_set(&t, 1+(85)*CLOCK_SECOND/1000); //As we may have problem with this conversion, adding 1 will round it up.
+		struct nRF24_deadline t;					  //Started with the payload transmission
+    nRF24_deadline_set(&t, nRF24_TX_TIMEOUT_US);
 	#endif
+	nRF24_TRACE_BEGIN(RF24_TRACE_FIFO_WAIT);
 	while( ! (nRF24_read_register(FIFO_STATUS) & _BV(TX_EMPTY)) ){
 		if( nRF24_get_status() & _BV(MAX_RT)){
 			nRF24_write_register(STATUS,_BV(MAX_RT) );
@@ -813,7 +1332,7 @@ nRF24_txStandBy(){
 			return 0;
 		}
 		#if defined (FAILURE_HANDLING) 
-			if( timer_expired(&t)){
+			if( nRF24_deadline_expired(&t)){
 				nRF24_errNotify();
 				#if defined (FAILURE_HANDLING)
 				return 0;	
@@ -821,6 +1340,7 @@ nRF24_txStandBy(){
 			}
 		#endif
 	}
+	nRF24_TRACE_END(RF24_TRACE_FIFO_WAIT);
 
 	nRF24_ce(LOW);			   //Set STANDBY-I mode
 	return 1;
@@ -835,20 +1355,21 @@ nRF24_txStandBy_def(uint32_t timeout, bool startTx){
 	  nRF24_stopListening();
 	  nRF24_ce(HIGH);
 	}
-	static struct timer t;							  //Get the time that the payload transmission started
-  timer_set(&t, 1+(timeout+85)*CLOCK_SECOND/1000); //As we may have problem with this conversion, adding 1 will round it up.
+	struct nRF24_deadline t;						  //Started with the payload transmission
+  nRF24_deadline_set(&t, timeout * 1000UL + nRF24_TX_TIMEOUT_US);
+	nRF24_TRACE_BEGIN(RF24_TRACE_FIFO_WAIT);
 
 	while( ! (nRF24_read_register(FIFO_STATUS) & _BV(TX_EMPTY)) ){
 		if( nRF24_get_status() & _BV(MAX_RT)){
 			nRF24_write_register(STATUS,_BV(MAX_RT) );
 				nRF24_ce(LOW);										  //Set re-transmit
 				nRF24_ce(HIGH);
-				if(timer_expired(&t)){
+				if(nRF24_deadline_expired(&t)){
 					nRF24_ce(LOW); nRF24_flush_tx(); return 0;
 				}
 		}
 		#if defined (FAILURE_HANDLING)
-			if( timer_expired(&t)){
+			if( nRF24_deadline_expired(&t)){
 				nRF24_errNotify();
 				#if defined (FAILURE_HANDLING)
 				return 0;	
@@ -856,6 +1377,7 @@ nRF24_txStandBy_def(uint32_t timeout, bool startTx){
 			}
 		#endif
 	}
+	nRF24_TRACE_END(RF24_TRACE_FIFO_WAIT);
 
 	
 	nRF24_ce(LOW);				   //Set STANDBY-I mode
@@ -883,7 +1405,13 @@ nRF24_getDynamicPayloadSize(void)
   result = spi_write_byte(0xff);
   nRF24_csn(HIGH);
 
-  if(result > 32) { nRF24_flush_rx(); clock_delay_msec(2); return 0; }
+  if(result > 32) {
+    // Corrupt, and RX_DR would keep coming: pause reading instead of blocking
+    nRF24_STATS_INC(rx_bad_length);
+    nRF24_flush_rx();
+    nRF24_settle_start(SETTLE_RECOVERY, 2000);
+    return 0;
+  }
   return result;
 }
 
@@ -892,7 +1420,20 @@ nRF24_getDynamicPayloadSize(void)
 bool
 nRF24_available(uint8_t* pipe_num)
 {
-  if (!( nRF24_read_register(FIFO_STATUS) & _BV(RX_EMPTY) )){
+  uint8_t fifo;
+
+  if(radio->settling == SETTLE_RECOVERY && nRF24_progress() == RF24_BUSY){
+    return 0;
+  }
+  fifo = nRF24_read_register(FIFO_STATUS);
+#if defined (nRF24_STATS)
+  // Counted once per time it fills up
+  if((fifo & _BV(RX_FULL)) && !radio->rx_full){
+    nRF24_STATS_INC(rx_fifo_full);
+  }
+  radio->rx_full = fifo & _BV(RX_FULL);
+#endif
+  if (!( fifo & _BV(RX_EMPTY) )){
 
     // If the caller wants the pipe number, include that
     if ( pipe_num ){
@@ -943,12 +1484,13 @@ nRF24_openWritingPipe(const uint8_t *address)
   // Note that AVR 8-bit uC's store this LSB first, and the NRF24L01(+)
   // expects it LSB first too, so we're good.
 
-  nRF24_write_register_block(RX_ADDR_P0,address, addr_width);
-  nRF24_write_register_block(TX_ADDR, address, addr_width);
+  nRF24_write_address(RX_ADDR_P0, address);
+  nRF24_write_address(TX_ADDR, address);
+  radio->tx_node_valid = false;
 
   //const uint8_t max_payload_size = 32;
   //nRF24_write_register(RX_PW_P0,rf24_min(payload_size,max_payload_size));
-  nRF24_write_register(RX_PW_P0,payload_size);
+  nRF24_write_register(RX_PW_P0,PAYLOAD_SIZE);
 }
 
 /****************************************************************************/
@@ -963,17 +1505,25 @@ const uint8_t child_payload_size[] PROGMEM =
 
 
 /****************************************************************************/
+#if !defined (nRF24_FIXED_CONFIG)
 void
 nRF24_setAddressWidth(uint8_t a_width){
 
 	if(a_width -= 2){
 		nRF24_write_register(SETUP_AW,a_width%4);
-		addr_width = (a_width%4) + 2;
+		radio->addr_width = (a_width%4) + 2;
+	}else{
+		// SETUP_AW 0 is reserved, the radio then matches 2 bytes
+		nRF24_write_register(SETUP_AW,0);
+		radio->addr_width = 2;
 	}
+	radio->tx_node_valid = false;
+	nRF24_update_retry_delay();
 
 }
 
 /****************************************************************************/
+#endif
 
 void
 nRF24_openReadingPipe(uint8_t child, const uint8_t *address)
@@ -982,17 +1532,18 @@ nRF24_openReadingPipe(uint8_t child, const uint8_t *address)
   // nRF24_openWritingPipe() will overwrite the pipe 0 address, so
   // nRF24_startListening() will have to restore it.
   if (child == 0){
-    memcpy(pipe0_reading_address,address,addr_width);
+    memcpy(radio->pipe0_reading_address,address,ADDR_WIDTH);
+    radio->tx_node_valid = false;
   }
   if (child <= 6)
   {
     // For pipes 2-5, only write the LSB
     if ( child < 2 ){
-      nRF24_write_register_block(pgm_read_byte(&child_pipe[child]), address, addr_width);
+      nRF24_write_address(pgm_read_byte(&child_pipe[child]), address);
     }else{
       nRF24_write_register_block(pgm_read_byte(&child_pipe[child]), address, 1);
 	}
-    nRF24_write_register(pgm_read_byte(&child_payload_size[child]),payload_size);
+    nRF24_write_register(pgm_read_byte(&child_payload_size[child]),PAYLOAD_SIZE);
 
     // Note it would be more efficient to set all of the bits for all open
     // pipes at once.  However, I thought it would make the calling code
@@ -1012,6 +1563,105 @@ nRF24_closeReadingPipe( uint8_t pipe )
 
 /****************************************************************************/
 
+static const uint8_t net_address[] PROGMEM = nRF24_NET_ADDRESS;
+
+void
+nRF24_node_address(uint8_t node, uint8_t *address)
+{
+  uint8_t i;
+
+  // LSB first, so the node byte is the one pipes 2-5 may change
+  address[0] = node;
+  for(i = 1; i < ADDR_WIDTH; i++){
+    address[i] = pgm_read_byte(&net_address[i - 1]);
+  }
+}
+
+/****************************************************************************/
+
+void
+nRF24_setRimeAddress(const rimeaddr_t *addr)
+{
+  uint8_t address[5];
+
+  // Pipe 1 takes broadcasts, pipe 2 frames for this node. Pipe 2 only has
+  // its own LSB, the other bytes are shared with pipe 1.
+  nRF24_node_address(nRF24_BROADCAST_NODE, address);
+  nRF24_openReadingPipe(1, address);
+  nRF24_openReadingPipe(2, &addr->u8[0]);
+}
+
+/****************************************************************************/
+
+void
+nRF24_setDestination(const rimeaddr_t *addr)
+{
+  uint8_t node = rimeaddr_cmp(addr, &rimeaddr_null) ? nRF24_BROADCAST_NODE : addr->u8[0];
+  uint8_t address[5];
+
+  if(radio->tx_node_valid && radio->tx_node == node){
+    return;
+  }
+  nRF24_node_address(node, address);
+
+  // The ACK comes back on pipe 0, from the address we sent to
+  nRF24_write_address(RX_ADDR_P0, address);
+  nRF24_write_address(TX_ADDR, address);
+  radio->tx_node = node;
+  radio->tx_node_valid = true;
+}
+
+/****************************************************************************/
+
+void
+nRF24_linkHeader(uint8_t *header)
+{
+#if defined (nRF24_DUP_CACHE)
+  header[0] = rimeaddr_node_addr.u8[0];
+  header[1] = radio->tx_seq++;
+#endif
+}
+
+/****************************************************************************/
+
+#if defined (nRF24_DUP_CACHE)
+bool
+nRF24_duplicate(uint8_t node, uint8_t seq)
+{
+  bool dup = false;
+  uint8_t i;
+
+  for(i = 0; i < radio->dup_count; i++){
+    if(radio->dup_cache[i].node == node){
+      dup = radio->dup_cache[i].seq == seq;
+      break;
+    }
+  }
+  if(i == radio->dup_count){
+    // A new sender takes the place of the one heard least recently
+    if(radio->dup_count < nRF24_DUP_CACHE){
+      radio->dup_count++;
+    }else{
+      i--;
+    }
+  }
+  memmove(&radio->dup_cache[1], &radio->dup_cache[0], i * sizeof(radio->dup_cache[0]));
+  radio->dup_cache[0].node = node;
+  radio->dup_cache[0].seq = seq;
+  return dup;
+}
+
+/****************************************************************************/
+
+uint16_t
+nRF24_getDuplicates(void)
+{
+  return radio->duplicates;
+}
+
+/****************************************************************************/
+#endif
+
 void
 nRF24_toggle_features(void)
 {
@@ -1023,6 +1673,7 @@ nRF24_toggle_features(void)
 
 /****************************************************************************/
 
+#if !defined (nRF24_FIXED_CONFIG)
 void
 nRF24_enableDynamicPayloads(void)
 {
@@ -1032,7 +1683,7 @@ nRF24_enableDynamicPayloads(void)
     nRF24_write_register(FEATURE,nRF24_read_register(FEATURE) | _BV(EN_DPL) );
 
 
-  IF_SERIAL_DEBUG(printf_P("FEATURE=%i\r\n",nRF24_read_register(FEATURE)));
+  nRF24_LOG1(RF24_LOG_FEATURE, nRF24_read_register(FEATURE));
 
   // Enable dynamic payload on all pipes
   //
@@ -1040,10 +1691,25 @@ nRF24_enableDynamicPayloads(void)
   // pipes, so the library does not support it.
   nRF24_write_register(DYNPD,nRF24_read_register(DYNPD) | _BV(DPL_P5) | _BV(DPL_P4) | _BV(DPL_P3) | _BV(DPL_P2) | _BV(DPL_P1) | _BV(DPL_P0));
 
-  dynamic_payloads_enabled = true;
+  radio->dynamic_payloads_enabled = true;
+}
+
+/****************************************************************************/
+
+void
+nRF24_disableDynamicPayloads(void)
+{
+  // EN_DYN_ACK stays, broadcasts go out with W_TX_PAYLOAD_NO_ACK
+  nRF24_write_register(FEATURE,nRF24_read_register(FEATURE) & ~_BV(EN_DPL) );
+  nRF24_write_register(DYNPD,0);
+
+  radio->dynamic_payloads_enabled = false;
 }
 
 /****************************************************************************/
+#endif
+// ACK payloads need dynamic payloads
+#if !defined (nRF24_FIXED_CONFIG) || nRF24_AUTO_PAYLOAD_SIZE
 
 void
 nRF24_enableAckPayload(void)
@@ -1055,14 +1721,30 @@ nRF24_enableAckPayload(void)
     //nRF24_toggle_features();
     nRF24_write_register(FEATURE,nRF24_read_register(FEATURE) | _BV(EN_ACK_PAY) | _BV(EN_DPL) );
 
-  IF_SERIAL_DEBUG(printf_P("FEATURE=%i\r\n",nRF24_read_register(FEATURE)));
+  nRF24_LOG1(RF24_LOG_FEATURE, nRF24_read_register(FEATURE));
 
   //
   // Enable dynamic payload on pipes 0 & 1
   //
 
   nRF24_write_register(DYNPD,nRF24_read_register(DYNPD) | _BV(DPL_P1) | _BV(DPL_P0));
-  dynamic_payloads_enabled = true;
+#if !defined (nRF24_FIXED_CONFIG)
+  radio->dynamic_payloads_enabled = true;
+#endif
+
+  // Retries must now wait for the ACK payload as well
+  radio->ack_payloads_enabled = true;
+  nRF24_update_retry_delay();
+}
+#endif
+
+/****************************************************************************/
+
+void
+nRF24_setAckPayloadSize(uint8_t size)
+{
+  radio->ack_payload_size = rf24_min(size,32);
+  nRF24_update_retry_delay();
 }
 
 /****************************************************************************/
@@ -1075,7 +1757,7 @@ nRF24_enableDynamicAck(void){
     //nRF24_toggle_features();
     nRF24_write_register(FEATURE,nRF24_read_register(FEATURE) | _BV(EN_DYN_ACK) );
 
-  IF_SERIAL_DEBUG(printf_P("FEATURE=%i\r\n",nRF24_read_register(FEATURE)));
+  nRF24_LOG1(RF24_LOG_FEATURE, nRF24_read_register(FEATURE));
 
 
 }
@@ -1097,6 +1779,12 @@ nRF24_writeAckPayload(uint8_t pipe, const void* buf, uint8_t len)
   }
 
   nRF24_csn(HIGH);
+
+#if defined (nRF24_ACK_PAYLOAD_TTL)
+  radio->ack_pending = true;
+  nRF24_deadline_set(&radio->ack_expiry, nRF24_ACK_PAYLOAD_TTL);
+  process_poll(&nRF24_process);
+#endif
 }
 
 /****************************************************************************/
@@ -1112,7 +1800,7 @@ nRF24_isAckPayloadnRF24_available(void)
 bool
 nRF24_isPVariant(void)
 {
-  return p_variant ;
+  return radio->p_variant ;
 }
 
 /****************************************************************************/
@@ -1163,6 +1851,14 @@ nRF24_testRPD(void)
 
 /****************************************************************************/
 
+uint8_t
+nRF24_getObserveTx(void)
+{
+  return nRF24_read_register(OBSERVE_TX);
+}
+
+/****************************************************************************/
+
 void
 nRF24_setPALevel(uint8_t level)
 {
@@ -1199,7 +1895,7 @@ nRF24_setDataRate(rf24_datarate_e speed)
   // HIGH and LOW '00' is 1Mbs - our default
   setup &= ~(_BV(RF_DR_LOW) | _BV(RF_DR_HIGH)) ;
   
-  txRxDelay=85;
+  radio->txRxDelay=85;
   
   if( speed == RF24_250KBPS )
   {
@@ -1207,7 +1903,7 @@ nRF24_setDataRate(rf24_datarate_e speed)
     // Making it '10'.
     setup |= _BV( RF_DR_LOW ) ;
   
-    txRxDelay=155;
+    radio->txRxDelay=155;
   
   }
   else
@@ -1217,7 +1913,7 @@ nRF24_setDataRate(rf24_datarate_e speed)
     if ( speed == RF24_2MBPS )
     {
       setup |= _BV(RF_DR_HIGH);
-      txRxDelay=65;
+      radio->txRxDelay=65;
     }
   }
   nRF24_write_register(RF_SETUP,setup);
@@ -1226,6 +1922,8 @@ nRF24_setDataRate(rf24_datarate_e speed)
   if ( nRF24_read_register(RF_SETUP) == setup )
   {
     result = true;
+    radio->data_rate = speed;
+    nRF24_update_retry_delay();
   }
 
   return result;
@@ -1236,7 +1934,7 @@ nRF24_setDataRate(rf24_datarate_e speed)
 bool
 nRF24_isValid(void)
 {
-  return ((ce_pin != 0xff) && (csn_pin != 0xff));
+  return ((radio->ce_pin != 0xff) && (radio->csn_pin != 0xff));
 }
 
 /****************************************************************************/
@@ -1289,6 +1987,10 @@ nRF24_setCRCLength(rf24_crclength_e length)
     config |= _BV( CRCO );
   }
   nRF24_write_register( CONFIG, config ) ;
+
+  // The enum values are the CRC length in bytes
+  radio->crc_length = length;
+  nRF24_update_retry_delay();
 }
 
 /****************************************************************************/
@@ -1319,30 +2021,148 @@ nRF24_disableCRC( void )
 {
   uint8_t disable = nRF24_read_register(CONFIG) & ~_BV(EN_CRC) ;
   nRF24_write_register( CONFIG, disable ) ;
+  radio->crc_length = 0;
+  nRF24_update_retry_delay();
 }
 
 /****************************************************************************/
 void
 nRF24_setRetries(uint8_t delay, uint8_t count)
 {
+ radio->auto_retry_delay = false;
  nRF24_write_register(SETUP_RETR,(delay&0xf)<<ARD | (count&0xf)<<ARC);
 }
 
+/****************************************************************************/
+
+void
+nRF24_setRetryCount(uint8_t count)
+{
+  radio->retry_count = count & 0xf;
+  radio->auto_retry_delay = true;
+  nRF24_update_retry_delay();
+}
+
+/****************************************************************************/
+
+void
+nRF24_update_retry_delay(void)
+{
+  uint8_t ack_len = radio->ack_payloads_enabled ? radio->ack_payload_size : 0;
+  uint8_t crc = radio->crc_length;
+  uint8_t delay;
+
+  if(!radio->auto_retry_delay){
+    return;
+  }
+
+  // Auto-ack forces the CRC on even if it was disabled, CRCO still picks
+  // its length
+  if(crc == 0){
+    crc = nRF24_read_register(CONFIG) & _BV(CRCO) ? 2 : 1;
+  }
+  delay = nRF24_ESB_ARD(radio->data_rate, ADDR_WIDTH, crc, ack_len);
+  nRF24_write_register(SETUP_RETR,delay<<ARD | radio->retry_count<<ARC);
+}
+
+/****************************************************************************/
+
+#if defined (nRF24_TIMESTAMP)
+bool
+nRF24_getTxTime(uint32_t *time)
+{
+  *time = radio->tx_time;
+  return radio->tx_time_valid;
+}
+
+/****************************************************************************/
+
+bool
+nRF24_getRxTime(uint32_t *time)
+{
+  *time = radio->rx_time;
+  return radio->rx_time_valid;
+}
+
+/****************************************************************************/
+#endif
+
+uint16_t
+nRF24_getAirtime(uint8_t len)
+{
+  if(!DYNAMIC_PAYLOADS){
+    len = PAYLOAD_SIZE;
+  }
+  return nRF24_ESB_AIRTIME_US(radio->data_rate, ADDR_WIDTH, len, radio->crc_length);
+}
+
+/****************************************************************************/
+
+uint16_t
+nRF24_getAckTime(void)
+{
+  return nRF24_ESB_ACK_US(radio->data_rate, ADDR_WIDTH, rf24_max(radio->crc_length,1),
+                          radio->ack_payloads_enabled ? radio->ack_payload_size : 0);
+}
+
+/****************************************************************************/
+
+void
+nRF24_txStart(void)
+{
+  nRF24_ce(HIGH);
+}
+
+/****************************************************************************/
+
+void
+nRF24_txStop(void)
+{
+  nRF24_ce(LOW);
+}
+
+/****************************************************************************/
+
+#if defined (nRF24_TIMESTAMP) || defined (nRF24_SLEEP)
+void
+nRF24_setTxProcess(struct process *p)
+{
+  radio->tx_process = p;
+}
+#endif
+
 
 /*---------------------------------------------------------------------------*/
 int
 nRF24_init(void)
 {
+#if nRF24_RADIOS > 1
+  uint8_t r;
+
+  radio->ce_pin = pgm_read_byte(&radio_pins[selected][0]);
+  radio->csn_pin = pgm_read_byte(&radio_pins[selected][1]);
+  radio->irq_pin = pgm_read_byte(&radio_pins[selected][2]);
+  if(radio->irq_pin != nRF24_NO_PIN){
+    pinMode(radio->irq_pin, INPUT);
+  }
+  radio->drained = false;
+  // The other radios stay off the bus, initialised or not
+  for(r = 0; r < nRF24_RADIOS; r++){
+    pinMode(pgm_read_byte(&radio_pins[r][1]), OUTPUT);
+    digitalWrite(pgm_read_byte(&radio_pins[r][1]), HIGH);
+  }
+#else
 #ifdef nRF24_CEPIN
-  ce_pin = nRF24_CEPIN;
+  radio->ce_pin = nRF24_CEPIN;
 #else
   #error nRF24_CEPIN not defined. Define this at the 'plataform-conf.h' of your chosen plataform.
 #endif
 #ifdef nRF24_CSPIN
-  csn_pin = nRF24_CSPIN;
+  radio->csn_pin = nRF24_CSPIN;
 #else
   #error nRF24_CSPIN not defined. Define this at the 'plataform-conf.h' of your chosen plataform.
 #endif
+#endif /* nRF24_RADIOS > 1 */
 //#ifdef nRF24_SPI_SPEED
 //  spi_speed(_spi_speed);
 //#else
@@ -1350,56 +2170,124 @@ nRF24_init(void)
 //#endif
 
 #ifdef nRF24_PLUS_MODEL
-  p_variant = nRF24_PLUS_MODEL;
+  radio->p_variant = nRF24_PLUS_MODEL;
 #else
-  p_variant = false;
+  radio->p_variant = false;
   #warning nRF24_PLUS_MODEL not defined. Define this at the 'plataform-conf.h' of your chosen plataform. Using Default = false.
 #endif
   
+#if !defined (nRF24_FIXED_CONFIG)
 #ifdef nRF24_PAYLOAD 
-  payload_size = nRF24_PAYLOAD;
+  radio->payload_size = nRF24_PAYLOAD;
 #else
-  payload_size = 32;
+  radio->payload_size = 32;
   #warning nRF24_PAYLOAD not defined. Define this at the 'plataform-conf.h' of your chosen plataform. Using Default = 32.
 #endif
 #ifdef nRF24_AUTO_PAYLOAD_SIZE
-  dynamic_payloads_enabled = nRF24_AUTO_PAYLOAD_SIZE;
+  radio->dynamic_payloads_enabled = nRF24_AUTO_PAYLOAD_SIZE;
 #else
-  dynamic_payloads_enabled = false;
+  radio->dynamic_payloads_enabled = false;
   #warning nRF24_AUTO_PAYLOAD_SIZE not defined. Define this at the 'plataform-conf.h' of your chosen plataform. Using Default = false.
 #endif
 #ifdef nRF24_ADRESS_SIZE
-  addr_width = nRF24_ADRESS_SIZE;//,pipe0_reading_address(0)
+  radio->addr_width = nRF24_ADRESS_SIZE;//,pipe0_reading_address(0)
 #else
-  addr_width = 5;//,pipe0_reading_address(0)
+  radio->addr_width = 5;//,pipe0_reading_address(0)
   #warning nRF24_ADRESS_SIZE not defined. Define this at the 'plataform-conf.h' of your chosen plataform. Using Default = 5.
 #endif
+#endif /* !defined (nRF24_FIXED_CONFIG) */
 
     // Initialize pins
-  pinMode(ce_pin,OUTPUT);
-  IF_SERIAL_DEBUG(printf_p(SPRS("CE pin: %d CSN pin: %d"),ce_pin,csn_pin));
+  pinMode(radio->ce_pin,OUTPUT);
+  nRF24_LOG2(RF24_LOG_PINS, radio->ce_pin, radio->csn_pin);
   
-  pinMode(csn_pin,OUTPUT);
+  pinMode(radio->csn_pin,OUTPUT);
   
   spi_init();
   
   nRF24_ce(LOW);
 	nRF24_csn(HIGH);
 
+  // 16-bit CRC as configure() writes it, no ACK payloads until enableAckPayload()
+  radio->crc_length = 2;
+  radio->ack_payloads_enabled = false;
+#if defined (nRF24_ACK_PAYLOAD_TTL)
+  radio->ack_pending = false;
+#endif
+#ifdef nRF24_ACK_PAYLOAD_SIZE
+  radio->ack_payload_size = nRF24_ACK_PAYLOAD_SIZE;
+#else
+  radio->ack_payload_size = 32;
+#endif
+
+  nRF24_power_init();
+#if defined (nRF24_STATS)
+  radio->rx_full = false;
+#endif
+  // Counters and rings are shared by all radios, radio 0 starts them
+  if(radio == &radios[0]){
+#if defined (nRF24_STATS)
+    nRF24_stats_init();
+#endif
+#if defined (nRF24_TRACE)
+    nRF24_trace_init();
+#endif
+#if defined (nRF24_SNIFFER)
+    nRF24_sniffer_init();
+#endif
+#if defined (nRF24_LOG)
+    nRF24_log_init();
+#endif
+  }
+  radio->settling = SETTLE_NONE;
+  radio->listening = false;
+  radio->listen_pending = false;
+  radio->tx_node_valid = false;
+#if defined (nRF24_DUP_CACHE)
+  radio->tx_seq = 0;
+  radio->retry_valid = false;
+  radio->dup_count = 0;
+  radio->duplicates = 0;
+#endif
+#if defined (nRF24_TIMESTAMP)
+  nRF24_arch_init();
+  radio->tx_time_valid = false;
+  radio->rx_time_valid = false;
+#endif
+#if defined (nRF24_NBR_TABLE)
+  nRF24_nbr_init();
+  radio->tx_nbr = NULL;
+  radio->last_plos = 0;
+#endif
+#if defined (nRF24_LINK_ADAPTATION)
+  nRF24_linkadapt_init();
+#endif
+
+  process_start(&nRF24_process, NULL);
+
   // Must allow the radio time to settle else configuration bits will not necessarily stick.
   // This is actually only required following power up but some settling time also appears to
   // be required after resets too. For full coverage, we'll always assume the worst.
   // Enabling 16b CRC is by far the most obvious case if the wrong timing is used - or skipped.
   // Technically we require 4.5ms + 14us as a worst case. We'll just call it 5ms for good measure.
   // WARNING: Delay is based on P-variant whereby non-P *may* require different timing.
-  clock_delay_msec( 5 ) ;
+  // Init may run from a protothread, so configure() follows from progress() once the
+  // time has passed. Any SPI transaction before that waits for it, see nRF24_csn().
+  nRF24_settle_start(SETTLE_RESET, 5000);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* The register part of init(), run by progress() once the radio settled */
+static void
+nRF24_configure(void)
+{
   // Reset CONFIG and enable 16-bit CRC.
   nRF24_write_register( CONFIG, 0b00001100 ) ;
 
-  // Set 1500uS (minimum for 32B payload in ESB@250KBPS) timeouts, to make testing a little easier
-  // WARNING: If this is ever lowered, either 250KBS mode with AA is broken or maximum packet
-  // sizes must never be used. See documentation for a more complete explanation.
-  nRF24_setRetries(5,15);
+  // The retry delay follows the ESB timing model from here on, so it is
+  // reprogrammed with the smallest safe value whenever the data rate,
+  // address width, CRC or ACK payload settings change.
+  nRF24_setRetryCount(15);
 
   // Reset value is MAX
   //nRF24_setPALevel( RF24_PA_MAX ) ;
@@ -1410,7 +2298,7 @@ nRF24_init(void)
   // be set to 250Kbps.
   if( nRF24_setDataRate( RF24_250KBPS ) )
   {
-    p_variant = true ;
+    radio->p_variant = true ;
   }
 
   // Then set the data rate to the slowest (and most reliable) speed supported by all
@@ -1420,10 +2308,16 @@ nRF24_init(void)
   // Initialize CRC and request 2-byte (16bit) CRC
   //nRF24_setCRCLength( RF24_CRC_16 ) ;
 
-  // Disable dynamic payloads, to match dynamic_payloads_enabled setting - Reset value is 0
+  // Dynamic payloads on all pipes or none, as configured - Reset value is 0
   nRF24_toggle_features();
-  nRF24_write_register(FEATURE,0 );
-  nRF24_write_register(DYNPD,0);
+  nRF24_write_register(FEATURE, DYNAMIC_PAYLOADS ? _BV(EN_DPL) : 0);
+  nRF24_write_register(DYNPD, DYNAMIC_PAYLOADS ? 0x3f : 0);
+
+  // The configured address width, 3 to 5 bytes - Reset value is 5
+  nRF24_write_register(SETUP_AW, ADDR_WIDTH - 2);
+
+  // Broadcasts go out with W_TX_PAYLOAD_NO_ACK
+  nRF24_enableDynamicAck();
 
   // Reset current status
   // Notice reset and flush is the last thing we do
@@ -1438,12 +2332,13 @@ nRF24_init(void)
   nRF24_flush_rx();
   nRF24_flush_tx();
 
-  nRF24_powerUp(); //Power up by default when begin() is called
+  // Power up by default, the first listen or write waits what is left of Tpd2stby
+  nRF24_startPowerUp();
+  nRF24_setRimeAddress(&rimeaddr_node_addr);
 
   // Enable PTX, do not write CE high so radio will remain in standby I mode ( 130us max to transition to RX or TX instead of 1500us from powerUp )
   // PTX should use only 22uA of power
   nRF24_write_register(CONFIG, ( nRF24_read_register(CONFIG) ) & ~_BV(PRIM_RX) );
-  return 0;
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -1460,16 +2355,19 @@ nRF24_transmit(unsigned short transmit_len)
 {
   transmit_len=transmit_len;
   nRF24_ce(HIGH);
+  nRF24_STATS_INC(tx);
+  rtimer_clock_t since = RTIMER_NOW();
+  nRF24_TRACE_BEGIN(RF24_TRACE_TX_WAIT);
   
   //Wait until complete or failed
 	#if defined (FAILURE_HANDLING)
-		static struct timer t;							  //Get the time that the payload transmission started
-    timer_set(&t, 1+(85)*CLOCK_SECOND/1000); //As we may have problem with this conversion, adding 1 will round it up.
+		struct nRF24_deadline t;					  //Started with the payload transmission
+    nRF24_deadline_set(&t, nRF24_TX_TIMEOUT_US);
 	#endif 
 	
 	while( ! ( nRF24_get_status()  & ( _BV(TX_DS) | _BV(MAX_RT) ))) { 
 		#if defined (FAILURE_HANDLING)
-			if(timer_expired(&t)){			
+			if(nRF24_deadline_expired(&t)){			
 				nRF24_errNotify();
 				#if defined (FAILURE_HANDLING)
 				  return 0;		
@@ -1480,6 +2378,8 @@ nRF24_transmit(unsigned short transmit_len)
 		#endif
 	}
   
+  nRF24_TRACE_END(RF24_TRACE_TX_WAIT);
+  nRF24_STATS_WAITED(since);
   nRF24_ce(LOW);
 
 	uint8_t status = nRF24_write_register(STATUS,_BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT) );
@@ -1496,22 +2396,174 @@ nRF24_transmit(unsigned short transmit_len)
 int
 nRF24_send(const void *payload, unsigned short payload_len)
 {
-  //prepare(payload, payload_len);
-  //transmit(payload_len);
-  return nRF24_write(payload,(uint8_t)payload_len,1);
+  const rimeaddr_t *dest = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+  bool broadcast = rimeaddr_cmp(dest, &rimeaddr_null);
+  bool was_listening = radio->listening || radio->listen_pending;
+  bool ok;
+#if defined (nRF24_DUP_CACHE)
+  uint8_t frame[32];
+  uint8_t node = broadcast ? nRF24_BROADCAST_NODE : dest->u8[0];
+  uint16_t sum = 0;
+  uint8_t i;
+
+  if(payload_len > sizeof(frame) - nRF24_LINK_HEADER_LEN){
+    return RADIO_TX_ERR;
+  }
+#endif
+
+  // A frame came in first, the MAC retries once it has been read
+  if(radio->listening && nRF24_available(NULL)){
+    process_poll(&nRF24_process);
+    return RADIO_TX_COLLISION;
+  }
+  if(was_listening){
+    // The turnaround runs while the frame is prepared
+    nRF24_beginStopListening();
+  }
+
+#if defined (nRF24_NBR_TABLE)
+  radio->tx_nbr = broadcast ? NULL : nRF24_nbr_add(dest);
+#endif
+#if defined (nRF24_LINK_ADAPTATION)
+  nRF24_linkadapt_select(radio->tx_nbr);
+#endif
+
+#if defined (nRF24_DUP_CACHE)
+  for(i = 0; i < payload_len; i++){
+    sum = ((sum << 1) | (sum >> 15)) + ((const uint8_t *)payload)[i];
+  }
+  if(radio->retry_valid && radio->retry_node == node && radio->retry_len == payload_len && radio->retry_sum == sum){
+    // The MAC sends the unacknowledged frame again. It may have arrived
+    // with only the ACK lost, so it keeps its number.
+    frame[0] = rimeaddr_node_addr.u8[0];
+    frame[1] = radio->retry_seq;
+  }else{
+    nRF24_linkHeader(frame);
+  }
+  memcpy(&frame[nRF24_LINK_HEADER_LEN], payload, payload_len);
+  radio->retry_node = node;
+  radio->retry_len = payload_len;
+  radio->retry_sum = sum;
+  radio->retry_seq = frame[1];
+  payload = frame;
+  payload_len += nRF24_LINK_HEADER_LEN;
+#endif
+
+  nRF24_setDestination(dest);
+
+  // Unicast frames are acknowledged and retransmitted by the radio
+  ok = nRF24_write(payload,(uint8_t)payload_len,broadcast);
+#if defined (nRF24_DUP_CACHE)
+  radio->retry_valid = !ok && !broadcast;
+#endif
+
+#if defined (nRF24_TIMESTAMP)
+  if(radio->tx_time_valid){
+    packetbuf_set_attr(PACKETBUF_ATTR_TIMESTAMP, (uint16_t)radio->tx_time);
+  }
+#endif
+#if defined (nRF24_LINK_ESTIMATE)
+  if(radio->tx_nbr != NULL){
+    packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, radio->tx_nbr->etx);
+  }
+#endif
+#if defined (nRF24_NBR_TABLE)
+  radio->tx_nbr = NULL;
+#endif
+
+  if(was_listening){
+    nRF24_beginStartListening();
+  }
+
+  if(ok){
+    nRF24_power_delivered();
+    return RADIO_TX_OK;
+  }
+  // A broadcast can only fail if the radio did not send it at all
+  return broadcast ? RADIO_TX_ERR : RADIO_TX_NOACK;
 }
 /*---------------------------------------------------------------------------*/
 int
 nRF24_read_contiki(void *buf, unsigned short buf_len)
 {
-  nRF24_read(buf,(uint8_t)buf_len);
-  return 1;
+  uint8_t len = PAYLOAD_SIZE;
+#if defined (nRF24_STATS)
+  uint8_t pipe;
+#endif
+#if defined (nRF24_DUP_CACHE)
+  bool dup;
+#endif
+#if defined (nRF24_LINK_ESTIMATE) && defined (nRF24_DUP_CACHE)
+  uint8_t etx;
+#endif
+
+#if defined (nRF24_TIMESTAMP)
+  // RX_DR marks the end of the frame; later frames of a burst get no edge
+  radio->rx_time_valid = nRF24_arch_capture(&radio->rx_time);
+  if(radio->rx_time_valid){
+    packetbuf_set_attr(PACKETBUF_ATTR_TIMESTAMP, (uint16_t)radio->rx_time);
+  }
+#endif
+
+  if(DYNAMIC_PAYLOADS){
+    len = nRF24_getDynamicPayloadSize();
+    if(len == 0){
+      return 0;
+    }
+  }
+#if defined (nRF24_DUP_CACHE)
+  if(len < nRF24_LINK_HEADER_LEN){
+    // Too short to come from this driver
+    nRF24_read_payload(buf, len);
+    nRF24_write_register(STATUS,_BV(RX_DR) | _BV(MAX_RT) | _BV(TX_DS) );
+    return 0;
+  }
+  len = rf24_min(len, buf_len + nRF24_LINK_HEADER_LEN);
+#else
+  len = rf24_min(len, buf_len);
+#endif
+
+  // The status byte clocked out with the payload names its pipe
+#if defined (nRF24_DUP_CACHE) && defined (nRF24_STATS)
+  pipe = (nRF24_read_link_payload(buf, len, &dup) >> RX_P_NO) & 0b111;
+#elif defined (nRF24_DUP_CACHE)
+  nRF24_read_link_payload(buf, len, &dup);
+#elif defined (nRF24_STATS)
+  pipe = (nRF24_read_payload(buf, len) >> RX_P_NO) & 0b111;
+#else
+  nRF24_read_payload(buf, len);
+#endif
+  nRF24_write_register(STATUS,_BV(RX_DR) | _BV(MAX_RT) | _BV(TX_DS) );
+
+#if defined (nRF24_STATS)
+  if(pipe < 6){
+    nRF24_STATS_INC(rx[pipe]);
+  }
+#endif
+
+#if defined (nRF24_DUP_CACHE)
+  if(dup){
+    radio->duplicates++;
+    return 0;
+  }
+  len -= nRF24_LINK_HEADER_LEN;
+#endif
+#if defined (nRF24_LINK_ESTIMATE) && defined (nRF24_DUP_CACHE)
+  // Frames failing their CRC never reach us, so nothing measured here
+  // tells how good the link from the sender is. Our ETX towards it does,
+  // if we have sent to it; otherwise the attribute stays unset.
+  etx = nRF24_linkest_node_etx(radio->rx_node);
+  if(etx != 0){
+    packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, etx);
+  }
+#endif
+  return len;
 }
 /*---------------------------------------------------------------------------*/
 int
 nRF24_receiving_packet(void)
 {
-  nRF24_startListening();
+  nRF24_beginStartListening();
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -1521,6 +2573,47 @@ nRF24_pending_packet(void)
   return nRF24_available(NULL);;
 }
 /*---------------------------------------------------------------------------*/
+#if nRF24_RADIOS > 1
+/* Radio n's radio_driver: each function selects radio n, calls the one
+ * above and restores the selection, so the input of one radio may send on
+ * another. */
+#define ON_RADIO(n, call) \
+  uint8_t prev = nRF24_select(n); \
+  int ret = (call); \
+  nRF24_select(prev); \
+  return ret
+#define RADIO_DRIVER(name, n) \
+  static int init_##n(void) { ON_RADIO(n, nRF24_init()); } \
+  static int prepare_##n(const void *payload, unsigned short len) \
+    { ON_RADIO(n, nRF24_prepare(payload, len)); } \
+  static int transmit_##n(unsigned short len) \
+    { ON_RADIO(n, nRF24_transmit(len)); } \
+  static int send_##n(const void *payload, unsigned short len) \
+    { ON_RADIO(n, nRF24_send(payload, len)); } \
+  static int read_##n(void *buf, unsigned short len) \
+    { ON_RADIO(n, nRF24_read_contiki(buf, len)); } \
+  static int channel_clear_##n(void) { ON_RADIO(n, nRF24_testRPD()); } \
+  static int receiving_packet_##n(void) \
+    { ON_RADIO(n, nRF24_receiving_packet()); } \
+  static int pending_packet_##n(void) { ON_RADIO(n, nRF24_pending_packet()); } \
+  static int on_##n(void) { ON_RADIO(n, nRF24_on()); } \
+  static int off_##n(void) { ON_RADIO(n, nRF24_powerDown()); } \
+  const struct radio_driver name = \
+    { \
+      init_##n, prepare_##n, transmit_##n, send_##n, read_##n, \
+      channel_clear_##n, receiving_packet_##n, pending_packet_##n, \
+      on_##n, off_##n, \
+    }
+
+RADIO_DRIVER(nRF24_driver, 0);
+RADIO_DRIVER(nRF24_driver_1, 1);
+#if nRF24_RADIOS > 2
+RADIO_DRIVER(nRF24_driver_2, 2);
+#endif
+#if nRF24_RADIOS > 3
+RADIO_DRIVER(nRF24_driver_3, 3);
+#endif
+#else
 const struct radio_driver nRF24_driver =
   {
     nRF24_init,
@@ -1531,7 +2624,108 @@ const struct radio_driver nRF24_driver =
     nRF24_testRPD, //channel_clear
     nRF24_receiving_packet,
     nRF24_pending_packet,
-    nRF24_powerUp,
+    nRF24_on,
     nRF24_powerDown,
   };
+#endif /* nRF24_RADIOS > 1 */
+/*---------------------------------------------------------------------------*/
+/* Whether nRF24_process should read the RX FIFO. With the IRQ pin high
+ * RX_DR is clear, so nothing arrived since the FIFO was last emptied and
+ * the SPI transaction is saved. */
+static bool
+nRF24_rx_waiting(void)
+{
+#if nRF24_RADIOS > 1
+  if(radio->drained && radio->irq_pin != nRF24_NO_PIN &&
+     digitalRead(radio->irq_pin) == HIGH) {
+    return false;
+  }
+  // Reading a frame clears RX_DR, the FIFO decides until it is empty
+  radio->drained = !nRF24_available(NULL);
+  return !radio->drained;
+#else
+  return nRF24_available(NULL);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/* One pass of nRF24_process over the selected radio */
+static void
+nRF24_service(void)
+{
+  int len;
+
+  // In TX mode the RX FIFO only holds ACK payloads, leave them to read()
+  while(radio->listening && nRF24_rx_waiting()) {
+    packetbuf_clear();
+    len = nRF24_read_contiki(packetbuf_dataptr(), PACKETBUF_SIZE);
+    if(len > 0) {
+      packetbuf_set_datalen(len);
+#if nRF24_RADIOS > 1
+      if(radio->input != NULL) {
+        radio->input();
+        continue;
+      }
+#endif
+      NETSTACK_RDC.input();
+    }
+  }
+
+#if !defined (nRF24_TIMESTAMP) && !defined (nRF24_SLEEP)
+  // Without an IRQ line the FIFO has to be polled while listening
+  if(radio->listening) {
+    process_poll(&nRF24_process);
+  }
+#else
+  // TX_DS or MAX_RT of frames somebody else is sending
+  if(!radio->listening && radio->tx_process != NULL) {
+    process_poll(radio->tx_process);
+  }
+#endif
+  // Complete a transition nobody waited for, other processes run in
+  // between instead of stalling on it
+  if(nRF24_progress() == RF24_BUSY) {
+    process_poll(&nRF24_process);
+  }
+#if defined (nRF24_ACK_PAYLOAD_TTL)
+  // Leaving RX flushes the FIFO anyway
+  if(radio->ack_pending && radio->listening &&
+     !(nRF24_read_register(FIFO_STATUS) & _BV(TX_EMPTY))) {
+    if(nRF24_deadline_expired(&radio->ack_expiry)) {
+      nRF24_flush_tx();
+      radio->ack_pending = false;
+    } else {
+      process_poll(&nRF24_process);
+    }
+  } else {
+    radio->ack_pending = false;
+  }
+#endif
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(nRF24_process, ev, data)
+{
+#if nRF24_RADIOS > 1
+  static uint8_t r, prev;
+#endif
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+
+#if nRF24_RADIOS > 1
+    // Leave the radio the application had selected as it was
+    prev = nRF24_selected();
+    for(r = 0; r < nRF24_RADIOS; r++) {
+      nRF24_select(r);
+      nRF24_service();
+    }
+    nRF24_select(prev);
+#else
+    nRF24_service();
+#endif
+  }
+
+  PROCESS_END();
+}
 /*---------------------------------------------------------------------------*/
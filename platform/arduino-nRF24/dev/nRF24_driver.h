@@ -8,29 +8,139 @@
 #include "Arduino.h"
 #include "contiki.h"
 #include "contiki-lib.h"
+#include "net/rime/rimeaddr.h"
 #include <string.h>
 
 
-#ifdef SERIAL_DEBUG_NRF24
-	#define IF_SERIAL_DEBUG(x) ({x;})
-#else
-	#define IF_SERIAL_DEBUG(x)
-#endif
+#define rf24_max(a,b) (a>b?a:b)
+#define rf24_min(a,b) (a<b?a:b)
 
+/*
+ * Constant tables and format strings stay in flash on the AVR and are read
+ * with the pgmspace functions. PRIPSTR prints such a string with printf_P.
+ * Host builds have no separate program memory and read them directly.
+ */
+#if defined (nRF24_HOST)
 #define pgm_read_word(p) (*(p))
 #define pgm_read_byte(p) (*(p))
-
-#define rf24_max(a,b) (a>b?a:b)
-#define rf24_min(a,b) (a<b?a:b)
-// GCC a Arduino Missing
 #define printf_P printf
 #define strlen_P strlen
 #define PRIPSTR "%s"
 #define PSTR(x) (x)
 #define PROGMEM
+#else
+#include <avr/pgmspace.h>
+#define PRIPSTR "%S"
+#endif
 
 typedef enum { false, true } bool;
 
+/**
+ * Network part of the ESB addresses, sent after the node byte.
+ *
+ * A node listens on its rime address u8[0] followed by the first
+ * nRF24_ADRESS_SIZE - 1 of these bytes. Nodes of a network must differ in
+ * u8[0].
+ */
+#ifndef nRF24_NET_ADDRESS
+#define nRF24_NET_ADDRESS { 0xC2, 0xC2, 0xC2, 0xC2 }
+#endif
+
+/**
+ * Node byte of the broadcast address, no node may use it
+ */
+#ifndef nRF24_BROADCAST_NODE
+#define nRF24_BROADCAST_NODE 0xFF
+#endif
+
+/**
+ * Bytes the driver puts in front of each frame: the sender's node byte and
+ * a sequence number, see nRF24_DUP_CACHE
+ */
+#if defined (nRF24_DUP_CACHE)
+#define nRF24_LINK_HEADER_LEN 2
+#else
+#define nRF24_LINK_HEADER_LEN 0
+#endif
+
+/**
+ * Longest a write may wait for TX_DS or MAX_RT before FAILURE_HANDLING
+ * reports the radio as not responding, in microseconds
+ */
+#ifndef nRF24_TX_TIMEOUT_US
+#define nRF24_TX_TIMEOUT_US 85000UL
+#endif
+
+/**
+ * Radios on the SPI bus, up to 4. With more than one, nRF24_RADIO_PINS
+ * lists the pins of each, radio 0 first:
+ *
+ *   { { CE, CSN, IRQ }, { CE, CSN, IRQ }, ... }
+ *
+ * The IRQ pin is optional, nRF24_NO_PIN without it. When it is wired,
+ * nRF24_process reads the pin instead of the FIFO status to find radios
+ * with nothing received.
+ *
+ * The nRF24_ functions keep their signatures and work on the radio chosen
+ * with nRF24_select(), rather than taking a radio argument. That keeps the
+ * RF24 style API of the single radio build, in which the selection
+ * compiles away, and each radio_driver binds its radio around the call.
+ * The selection is global state, so:
+ *
+ * - nothing here is re-entrant, and interrupt handlers must not call the
+ *   nRF24_ functions, as they would act on whichever radio the
+ *   interrupted code had selected. The driver's own handlers only latch
+ *   a time and poll a process;
+ * - code calling the nRF24_ functions directly selects its radio first
+ *   and restores the previous one. nRF24_process calls each radio's
+ *   input with that radio selected;
+ * - the IRQ capture timer, the sleep and power-down managers, the
+ *   sniffer, TDMA and the neighbor table exist once, for one radio. With
+ *   more than one radio the build refuses them, see the #error below.
+ */
+#ifndef nRF24_RADIOS
+#define nRF24_RADIOS 1
+#endif
+#define nRF24_NO_PIN 0xff
+
+#if nRF24_RADIOS > 4
+#error nRF24_RADIOS above 4
+#endif
+#if nRF24_RADIOS > 1 && !defined (nRF24_RADIO_PINS)
+#error nRF24_RADIOS needs nRF24_RADIO_PINS
+#endif
+/* These own one timer, pin or neighbor table for the single radio */
+#if nRF24_RADIOS > 1 && (defined (nRF24_TIMESTAMP) || defined (nRF24_SLEEP) || \
+    defined (nRF24_POWER_IDLE) || defined (nRF24_SNIFFER) || \
+    defined (nRF24_LINK_ADAPTATION) || defined (nRF24_LINK_ESTIMATE) || \
+    defined (nRF24_TDMA))
+#error nRF24_RADIOS above 1 does not mix with nRF24_TIMESTAMP, nRF24_SLEEP, nRF24_POWER_IDLE, nRF24_SNIFFER, nRF24_TDMA or the neighbor table
+#endif
+
+/**
+ * With nRF24_FIXED_CONFIG, nRF24_PAYLOAD, nRF24_AUTO_PAYLOAD_SIZE and
+ * nRF24_ADRESS_SIZE hold for good. The driver reads them as constants
+ * instead of per-radio variables: without dynamic payloads the padding
+ * length is known, with them the padding loops go, and addresses are
+ * written in a fixed number of bytes. The setters of the three are not
+ * built.
+ */
+#if defined (nRF24_FIXED_CONFIG)
+#if !defined (nRF24_PAYLOAD) || !defined (nRF24_AUTO_PAYLOAD_SIZE) || !defined (nRF24_ADRESS_SIZE)
+#error nRF24_FIXED_CONFIG needs nRF24_PAYLOAD, nRF24_AUTO_PAYLOAD_SIZE and nRF24_ADRESS_SIZE
+#endif
+#if (nRF24_PAYLOAD) < 1 || (nRF24_PAYLOAD) > 32
+#error nRF24_PAYLOAD must be 1 to 32 bytes
+#endif
+#if (nRF24_ADRESS_SIZE) < 3 || (nRF24_ADRESS_SIZE) > 5
+#error nRF24_ADRESS_SIZE must be 3 to 5 bytes
+#endif
+/* The sniffer reprograms all three */
+#if defined (nRF24_SNIFFER)
+#error nRF24_FIXED_CONFIG does not mix with nRF24_SNIFFER
+#endif
+#endif
+
 /**
  * Power Amplifier level.
  *
@@ -52,6 +162,13 @@ typedef enum { RF24_1MBPS = 0, RF24_2MBPS, RF24_250KBPS } rf24_datarate_e;
  */
 typedef enum { RF24_CRC_DISABLED = 0, RF24_CRC_8, RF24_CRC_16 } rf24_crclength_e;
 
+/**
+ * Whether a mode transition is still settling.
+ *
+ * Returned by progress()
+ */
+typedef enum { RF24_DONE = 0, RF24_BUSY } rf24_progress_e;
+
 /**
  * Driver for nRF24L01(+) 2.4GHz Wireless Transceiver
  */
@@ -94,9 +211,20 @@ typedef enum { RF24_CRC_DISABLED = 0, RF24_CRC_8, RF24_CRC_16 } rf24_crclength_e
    * radio.openReadingPipe(1,address);
    * radio.startListening();
    * @endcode
+   * @note Waits what is left of a wake up, see beginStartListening()
    */
   void nRF24_startListening(void);
 
+  /**
+   * Start listening without waiting
+   *
+   * Listens at once if the radio is settled. While it still leaves Power
+   * Down, CE stays low and progress() starts listening once Tpd2stby has
+   * passed, from the driver process if nobody else asks. stopListening()
+   * or a write in the meantime cancels it.
+   */
+  void nRF24_beginStartListening(void);
+
   /**
    * Stop listening for incoming messages, and switch to transmit mode.
    *
@@ -105,9 +233,43 @@ typedef enum { RF24_CRC_DISABLED = 0, RF24_CRC_8, RF24_CRC_16 } rf24_crclength_e
    * radio.stopListening();
    * radio.write(&data,sizeof(data));
    * @endcode
+   * @note Waits what is left of the turnaround, see beginStopListening()
    */
   void nRF24_stopListening(void);
 
+  /**
+   * Start the switch to transmit mode without waiting
+   *
+   * CE goes low at once. An ACK for the last frame received may still be on
+   * air, so PRIM_RX is only cleared txRxDelay later (twice that with ACK
+   * payloads) by progress(). Registers other than CONFIG may be written in
+   * the meantime, and the driver process completes the switch if nobody
+   * else asks.
+   */
+  void nRF24_beginStopListening(void);
+
+  /**
+   * Advance the mode transition in progress
+   *
+   * Transitions are the settling after init, which then writes the
+   * configuration, leaving Power Down (Tpd2stby), the RX to TX turnaround
+   * and the pause after a corrupt payload was flushed. The part due after
+   * the settling time is done here, from process context only as it uses
+   * SPI, followed by the listen beginStartListening() left pending.
+   *
+   * @return RF24_BUSY while the settling time runs, RF24_DONE once the radio
+   * may be used
+   */
+  rf24_progress_e nRF24_progress(void);
+
+  /**
+   * Wait until progress() returns RF24_DONE
+   *
+   * Used by the calls that need a settled radio, they only wait what is
+   * left of the transition.
+   */
+  void nRF24_settle(void);
+
   /**
    * Read the available payload
    *
@@ -238,6 +400,12 @@ s   *
    */
   bool nRF24_rxFifoFull();
 
+  /**
+   * Check whether every frame loaded for sending has left
+   * @return True if the TX FIFO is empty
+   */
+  bool nRF24_txFifoEmpty();
+
   /**
    * Enter low-power mode
    *
@@ -261,9 +429,24 @@ s   *
    * Leave low-power mode - required for normal radio operation after calling powerDown()
    * 
    * To return to low power mode, call powerDown().
-   * @note This will take up to 5ms for maximum compatibility 
+   * @note Waits what is left of Tpd2stby, see nRF24_power.h
    */
   int nRF24_powerUp(void) ;
+
+  /**
+   * Leave low-power mode without waiting
+   *
+   * CE must stay low until progress() returns RF24_DONE. powerUp() and the
+   * write and listen calls wait for it themselves.
+   */
+  void nRF24_startPowerUp(void);
+
+  /**
+   * The radio_driver's on(), startPowerUp() without waiting
+   *
+   * @return 1
+   */
+  int nRF24_on(void);
   
   /**
    * Be sure to call openWritingPipe() first to set the destination
@@ -353,7 +536,7 @@ s   *
    *
    * @param buf Pointer to the data to be sent
    * @param len Number of bytes to be sent
-   * @param timeout User defined timeout in milliseconds.
+   * @param timeout User defined timeout in milliseconds, below 71 minutes.
    * @return True if the payload was loaded into the buffer successfully false if not
    */
   bool nRF24_writeBlocking( const void* buf, uint8_t len, uint32_t timeout );
@@ -419,6 +602,9 @@ s   *
    * @param buf Pointer to data that is sent
    * @param len Length of the data to send, up to 32 bytes max.  Not affected
    * by the payload set by setPayloadSize().
+   * @note With nRF24_ACK_PAYLOAD_TTL set in platform-conf.h, the TX FIFO is
+   * flushed if that many microseconds pass after the last call without the
+   * payloads going out, so a late frame does not get stale data.
    */
   void nRF24_writeAckPayload(uint8_t pipe, const void* buf, uint8_t len);
 
@@ -560,6 +746,20 @@ s   *
    */
   int nRF24_testRPD(void) ;
 
+  /**
+   * Read the transmit observe register
+   *
+   * ARC_CNT holds the retransmissions used by the last packet and PLOS_CNT
+   * the packets lost since RF_CH was last written.
+   *
+   * @code
+   * uint8_t observe = radio.getObserveTx();
+   * uint8_t retries = (observe >> ARC_CNT) & 0x0f;
+   * @endcode
+   * @return Current value of OBSERVE_TX
+   */
+  uint8_t nRF24_getObserveTx(void);
+
   /**
    * Test whether this is a real radio, or a mock shim for
    * debugging.  Setting either pin to 0xff is the way to
@@ -590,10 +790,16 @@ s   *
   /**
   * Set the address width from 3 to 5 bytes (24, 32 or 40 bit)
   *
-  * @param a_width The address width to use: 3,4 or 5
+  * 2 writes the reserved SETUP_AW value, which the radio takes as a 2 byte
+  * address. Only the sniffer uses it, see nRF24_sniffer.h.
+  *
+  * Not built with nRF24_FIXED_CONFIG.
+  *
+  * @param a_width The address width to use: 3,4 or 5, or 2
   */
-
+#if !defined (nRF24_FIXED_CONFIG)
   void nRF24_setAddressWidth(uint8_t a_width);
+#endif
 
   
    /**
@@ -618,12 +824,154 @@ s   *
   /**
    * Set the number and delay of retries upon failed submit
    *
+   * @note This fixes the delay. Use setRetryCount() to go back to the
+   * delay computed by the driver.
+   *
    * @param delay How long to wait between each retry, in multiples of 250us,
    * max is 15.  0 means 250us, 15 means 4000us.
    * @param count How many retries before giving up, max 15
    */
   void nRF24_setRetries(uint8_t delay, uint8_t count);
 
+  /**
+   * Set the number of retries and let the driver pick the delay
+   *
+   * The delay is the smallest that still waits for the whole ACK at the
+   * current data rate, address width, CRC and ACK payload size. It is kept
+   * up to date when those settings change, until setRetries() is called.
+   * This is the default after init.
+   *
+   * @param count How many retries before giving up, max 15
+   */
+  void nRF24_setRetryCount(uint8_t count);
+
+  /**
+   * Set the largest ACK payload the receiver will send back
+   *
+   * Only used to size the retry delay once ACK payloads are enabled.
+   * Defaults to nRF24_ACK_PAYLOAD_SIZE, or 32 if that is not defined.
+   *
+   * @param size ACK payload size in bytes, 0-32
+   */
+  void nRF24_setAckPayloadSize(uint8_t size);
+
+  /**
+   * On-air time of a frame with the current settings
+   *
+   * Covers preamble, address, packet control field, payload and CRC. With
+   * fixed payloads the fixed payload size is used whatever @p len is.
+   *
+   * @param len Payload length in bytes
+   * @return Frame duration in microseconds
+   */
+  uint16_t nRF24_getAirtime(uint8_t len);
+
+  /**
+   * Time an acknowledged frame keeps the radio busy after it ends
+   *
+   * The receiver turnaround plus the ACK, with the largest ACK payload
+   * expected when ACK payloads are enabled.
+   *
+   * @return Duration in microseconds
+   */
+  uint16_t nRF24_getAckTime(void);
+
+  /**
+   * Start sending what was loaded with startFastWrite(..., startTx = 0)
+   *
+   * Only drives CE, so it is safe from an rtimer callback while the main
+   * loop is using SPI. The radio must already be out of listening mode.
+   */
+  void nRF24_txStart(void);
+
+  /**
+   * Stop sending, the frame on air is still completed
+   *
+   * Only drives CE, see txStart().
+   */
+  void nRF24_txStop(void);
+
+#if defined (nRF24_TIMESTAMP) || defined (nRF24_SLEEP)
+  /**
+   * Have a process polled when the radio raises its IRQ while not listening
+   *
+   * For a MAC that loads the TX FIFO and starts it with txStart(): it reads
+   * STATUS when TX_DS or MAX_RT come instead of waiting for them. Needs the
+   * IRQ line, wired with nRF24_TIMESTAMP or nRF24_SLEEP.
+   *
+   * @param p Process to poll, NULL for none
+   */
+  void nRF24_setTxProcess(struct process *p);
+#endif
+
+  /**
+   * Listen on the addresses of a Rime node
+   *
+   * Pipe 1 takes the broadcast address and pipe 2 the node's own, see
+   * nRF24_NET_ADDRESS. Pipes 0 and 3-5 are left to the application. Init
+   * calls this with rimeaddr_node_addr, call it again if that changes.
+   *
+   * @param addr Address of this node
+   */
+  void nRF24_setRimeAddress(const rimeaddr_t *addr);
+
+  /**
+   * Send to a Rime node from now on
+   *
+   * Writes TX_ADDR and RX_ADDR_P0 only when the node byte differs from
+   * the last one set. openWritingPipe(), openReadingPipe(0, ...) and
+   * setAddressWidth() make the next call write them again.
+   *
+   * @param addr Destination, rimeaddr_null for the broadcast address
+   */
+  void nRF24_setDestination(const rimeaddr_t *addr);
+
+  /**
+   * Write the link header of a new frame
+   *
+   * For frames loaded without send(), e.g. by an RDC driver. Writes
+   * nothing when nRF24_LINK_HEADER_LEN is 0. A frame sent again must keep
+   * its header, so the receiver can drop the copy.
+   *
+   * @param header Where to store the nRF24_LINK_HEADER_LEN bytes
+   */
+  void nRF24_linkHeader(uint8_t *header);
+
+#if defined (nRF24_DUP_CACHE)
+  /**
+   * Frames dropped as duplicates since init
+   */
+  uint16_t nRF24_getDuplicates(void);
+#endif
+
+#if defined (nRF24_TIMESTAMP)
+  /**
+   * Time the last frame sent ended on air
+   *
+   * Taken from the TX_DS edge. For acknowledged frames the ACK turnaround
+   * is taken off, so sender and receiver stamp the same instant. Only
+   * frames acknowledged without a retransmission have a stamp: the edge
+   * ends the last copy, the receiver stamped the first.
+   *
+   * @param time Where to store the time, in rtimer ticks (32 bit)
+   * @return False if the frame failed, was retransmitted or no edge was
+   * captured
+   */
+  bool nRF24_getTxTime(uint32_t *time);
+
+  /**
+   * Time the last frame read ended on air
+   *
+   * Taken from the RX_DR edge. Valid from read() to the next read(), so
+   * also inside NETSTACK_RDC.input(). The low 16 bits are also set as
+   * PACKETBUF_ATTR_TIMESTAMP.
+   *
+   * @param time Where to store the time, in rtimer ticks (32 bit)
+   * @return False if the frame had no edge of its own
+   */
+  bool nRF24_getRxTime(uint32_t *time);
+#endif
+
   /**
    * Set RF communication channel
    *
@@ -641,9 +989,13 @@ s   *
    *
    * @todo Implement variable-sized payloads feature
    *
+   * Not built with nRF24_FIXED_CONFIG.
+   *
    * @param size The number of bytes in the payload
    */
+#if !defined (nRF24_FIXED_CONFIG)
   void nRF24_setPayloadSize(uint8_t size);
+#endif
 
   /**
    * Get Payload Size
@@ -682,8 +1034,13 @@ s   *
    * Ack payloads are a handy way to return data back to senders without
    * manually changing the radio modes on both units.
    *
+   * They need dynamic payloads: with nRF24_FIXED_CONFIG this is only built
+   * when nRF24_AUTO_PAYLOAD_SIZE is 1.
+   *
    */
+#if !defined (nRF24_FIXED_CONFIG) || nRF24_AUTO_PAYLOAD_SIZE
   void nRF24_enableAckPayload(void);
+#endif
 
   /**
    * Enable dynamically-sized payloads
@@ -691,9 +1048,22 @@ s   *
    * This way you don't always have to send large packets just to send them
    * once in a while.  This enables dynamic payloads on ALL pipes.
    *
+   * Not built with nRF24_FIXED_CONFIG, nor is disableDynamicPayloads().
+   *
    */
+#if !defined (nRF24_FIXED_CONFIG)
   void nRF24_enableDynamicPayloads(void);
 
+  /**
+   * Disable dynamically-sized payloads
+   *
+   * Every pipe then takes frames of the size set by nRF24_setPayloadSize(),
+   * reopen the reading pipes after changing it. Dynamic ACKs stay enabled.
+   *
+   */
+  void nRF24_disableDynamicPayloads(void);
+#endif
+
   /**
    * Determine whether the hardware is an nRF24L01+ or not.
    *
@@ -819,7 +1189,65 @@ s   *
    */
   /**@{*/
 
+/**
+ * Contiki radio driver. send() takes the destination from
+ * PACKETBUF_ADDR_RECEIVER: broadcasts go out without ACK, unicast frames
+ * with ESB auto-ack and retransmission. It returns RADIO_TX_OK,
+ * RADIO_TX_NOACK once the retries ran out, or RADIO_TX_COLLISION if a
+ * received frame was still waiting to be read.
+ */
 extern const struct radio_driver nRF24_driver;
 
+#if nRF24_RADIOS > 1
+/**
+ * Contiki radio drivers of radios 1 to 3. nRF24_driver is radio 0. Each
+ * call selects its radio for the time of the call.
+ */
+extern const struct radio_driver nRF24_driver_1;
+#if nRF24_RADIOS > 2
+extern const struct radio_driver nRF24_driver_2;
+#endif
+#if nRF24_RADIOS > 3
+extern const struct radio_driver nRF24_driver_3;
+#endif
+
+  /**
+   * Select the radio the nRF24_ functions work on
+   *
+   * The radio drivers and nRF24_process select their radio and restore
+   * the previous selection, so only code calling the nRF24_ functions
+   * directly selects. Radio 0 is selected at boot. Not for interrupt
+   * handlers, see nRF24_RADIOS.
+   *
+   * @param radio Radio index, below nRF24_RADIOS
+   * @return The radio selected before
+   */
+  uint8_t nRF24_select(uint8_t radio);
+
+  /**
+   * Index of the selected radio
+   */
+  uint8_t nRF24_selected(void);
+
+  /**
+   * Set where nRF24_process hands the frames of a radio
+   *
+   * The frame is in packetbuf and its radio is selected while @p input
+   * runs, so a gateway can forward it with the driver of another radio.
+   * By default every radio delivers to NETSTACK_RDC.input().
+   *
+   * @param radio Radio index, below nRF24_RADIOS
+   * @param input Called per frame received
+   */
+  void nRF24_setInput(uint8_t radio, void (*input)(void));
+#endif /* nRF24_RADIOS > 1 */
+
+/**
+ * Moves received frames into packetbuf and up the Contiki netstack while
+ * the radio is listening, of each radio in turn with nRF24_RADIOS. Started
+ * by init, polled by the IRQ capture when nRF24_TIMESTAMP is set.
+ */
+PROCESS_NAME(nRF24_process);
+
 
 #endif /* nRF24_H */
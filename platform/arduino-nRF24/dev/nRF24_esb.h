@@ -0,0 +1,76 @@
+/**
+ * \file
+ *         Enhanced ShockBurst timing model
+ *
+ *         On-air time of ESB frames and the shortest safe auto retransmit
+ *         delay, per the nRF24L01+ product specification (sections 7.3 and
+ *         7.4). Everything here is a macro so that constant arguments fold
+ *         at compile time; the driver only evaluates them when the radio
+ *         configuration changes.
+ */
+
+#ifndef nRF24_ESB_H
+#define nRF24_ESB_H
+
+/**
+ * Bits of a frame on air: 1 byte preamble, address, 9 bit packet control
+ * field, payload and CRC.
+ *
+ * @param aw Address width in bytes, 3-5
+ * @param len Payload length in bytes, 0-32 (0 for a plain ACK)
+ * @param crc CRC length in bytes, 0-2
+ */
+#define nRF24_ESB_BITS(aw, len, crc) (8 * (1 + (aw) + (len) + (crc)) + 9)
+
+/**
+ * Microseconds needed to send @p bits at a data rate (rf24_datarate_e)
+ */
+#define nRF24_ESB_US(rate, bits) \
+  ((rate) == RF24_2MBPS ? ((bits) + 1) >> 1 : \
+   (rate) == RF24_250KBPS ? (bits) << 2 : (bits))
+
+/**
+ * On-air time of a frame, in microseconds
+ */
+#define nRF24_ESB_AIRTIME_US(rate, aw, len, crc) \
+  nRF24_ESB_US(rate, nRF24_ESB_BITS(aw, len, crc))
+
+/**
+ * TX/RX settling time of the radio (Tstby2a), in microseconds
+ */
+#define nRF24_ESB_SETTLE_US 130
+
+/**
+ * Time from the end of our frame to the end of the ACK, in microseconds:
+ * the receiver turns around and sends an ACK carrying @p ack_len bytes.
+ */
+#define nRF24_ESB_ACK_US(rate, aw, crc, ack_len) \
+  (nRF24_ESB_SETTLE_US + nRF24_ESB_AIRTIME_US(rate, aw, ack_len, crc))
+
+/**
+ * Margin the auto retransmit delay keeps after the modelled end of the
+ * ACK, in microseconds. The datasheet does not say where it goes; without
+ * it the airtime alone lets 20 bytes of ACK payload into 250us at 2Mbps
+ * where the datasheet allows 15, and at 250Kbps 2 bytes more than it
+ * allows into each ARD step. The values sit inside the ranges that
+ * reproduce every ARD figure of the datasheet, see tools/nrf24-esb.
+ */
+#define nRF24_ESB_ARD_GUARD_US(rate) \
+  ((rate) == RF24_2MBPS ? 20 : (rate) == RF24_250KBPS ? 48 : 0)
+
+/**
+ * Smallest ARD field value (250us steps, 0 meaning 250us) that waits for
+ * the whole ACK before retransmitting. ARD counts from the end of our own
+ * frame, so the forward payload length does not enter into it.
+ *
+ * For 5 byte addresses and 16 bit CRC this gives the datasheet figures:
+ * 250us fits up to 15 bytes of ACK payload at 2Mbps and 5 bytes at 1Mbps,
+ * 500us any ACK payload at either rate. 250Kbps needs 500us without ACK
+ * payload, then 750us, 1000us, 1250us and 1500us for up to 8, 16, 24 and
+ * 32 bytes.
+ */
+#define nRF24_ESB_ARD(rate, aw, crc, ack_len) \
+  rf24_min((nRF24_ESB_ACK_US(rate, aw, crc, ack_len) + \
+            nRF24_ESB_ARD_GUARD_US(rate) + 249) / 250 - 1, 15)
+
+#endif /* nRF24_ESB_H */
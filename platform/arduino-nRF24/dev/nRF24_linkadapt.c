@@ -0,0 +1,101 @@
+#include "nRF24_linkadapt.h"
+
+#if defined (nRF24_LINK_ADAPTATION)
+
+struct ladder_step {
+  uint8_t rate;  /**< rf24_datarate_e */
+  uint8_t pa;    /**< rf24_pa_dbm_e */
+  uint8_t arc;   /**< Retry count */
+};
+
+/* Ordered from the cheapest setting to the most robust one */
+static const struct ladder_step ladder[] PROGMEM =
+{
+  { RF24_2MBPS,   RF24_PA_MIN,   3 },
+  { RF24_2MBPS,   RF24_PA_LOW,   5 },
+  { RF24_1MBPS,   RF24_PA_HIGH,  8 },
+  { RF24_1MBPS,   RF24_PA_MAX,  12 },
+  { RF24_250KBPS, RF24_PA_MAX,  15 },
+};
+
+#define LADDER_STEPS (sizeof(ladder) / sizeof(ladder[0]))
+
+static uint8_t applied; /**< Step programmed into the radio */
+
+/****************************************************************************/
+
+static uint8_t
+top_step(void)
+{
+  // Non-P parts can't do 250Kbps, keep them off the last step
+  if(nRF24_LINK_ADAPTATION_RATE && !nRF24_isPVariant()){
+    return LADDER_STEPS - 2;
+  }
+  return LADDER_STEPS - 1;
+}
+
+/****************************************************************************/
+
+static void
+apply(uint8_t step)
+{
+  if(step == applied){
+    return;
+  }
+#if nRF24_LINK_ADAPTATION_RATE
+  nRF24_setDataRate(pgm_read_byte(&ladder[step].rate));
+#endif
+  nRF24_setPALevel(pgm_read_byte(&ladder[step].pa));
+  // The retry delay follows the data rate on its own
+  nRF24_setRetryCount(pgm_read_byte(&ladder[step].arc));
+  applied = step;
+}
+
+/****************************************************************************/
+
+void
+nRF24_linkadapt_init(void)
+{
+  applied = 0xff;
+}
+
+/****************************************************************************/
+
+void
+nRF24_linkadapt_new(struct nRF24_nbr *n)
+{
+  n->step = rf24_min(nRF24_LINK_ADAPTATION_START, top_step());
+}
+
+/****************************************************************************/
+
+void
+nRF24_linkadapt_select(struct nRF24_nbr *n)
+{
+  apply(n == NULL ? top_step() : n->step);
+}
+
+/****************************************************************************/
+
+void
+nRF24_linkadapt_update(struct nRF24_nbr *n, uint8_t arc, bool lost)
+{
+  // retx += (arc * 16 - retx) / 4
+  n->retx = n->retx - (n->retx >> 2) + (arc << 2);
+
+  if(lost || n->retx > nRF24_LINK_ADAPTATION_UP){
+    if(n->step < top_step()){
+      n->step++;
+    }
+    // Give the new step a fair start
+    n->retx = nRF24_LINK_ADAPTATION_UP / 2;
+    n->good = 0;
+  }else if(arc == 0 && ++n->good >= nRF24_LINK_ADAPTATION_DOWN){
+    if(n->step > 0){
+      n->step--;
+    }
+    n->good = 0;
+  }
+}
+
+#endif /* defined (nRF24_LINK_ADAPTATION) */
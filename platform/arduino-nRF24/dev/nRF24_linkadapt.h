@@ -0,0 +1,85 @@
+/**
+ * \file
+ *         Per-neighbor link adaptation for the nRF24 driver
+ *
+ *         Every destination sits on a ladder of radio settings, from fast
+ *         and quiet (2Mbps, low PA, few retries) to slow and loud (250Kbps,
+ *         max PA, 15 retries). Acknowledged sends move the destination up
+ *         the ladder on losses or frequent retransmissions and back down
+ *         after a run of clean deliveries. The driver drives it from
+ *         nRF24_send() and the OBSERVE_TX feedback of nRF24_write().
+ *
+ *         Enable with nRF24_LINK_ADAPTATION in platform-conf.h.
+ */
+
+#ifndef nRF24_LINKADAPT_H
+#define nRF24_LINKADAPT_H
+
+#include "nRF24_nbr.h"
+
+/**
+ * Ladder step given to a destination the first time it is used
+ */
+#ifndef nRF24_LINK_ADAPTATION_START
+#define nRF24_LINK_ADAPTATION_START 2
+#endif
+
+/**
+ * Clean deliveries (no retransmission) needed before stepping down
+ */
+#ifndef nRF24_LINK_ADAPTATION_DOWN
+#define nRF24_LINK_ADAPTATION_DOWN 16
+#endif
+
+/**
+ * Average retransmissions per packet, in 1/16 units, above which the
+ * destination is moved one step up. 32 means two retries on average.
+ */
+#ifndef nRF24_LINK_ADAPTATION_UP
+#define nRF24_LINK_ADAPTATION_UP 32
+#endif
+
+/**
+ * Let the ladder change the data rate as well as PA level and retries.
+ *
+ * @warning A receiver only hears the data rate it is configured for, so
+ * this is off by default. Only enable it when every receiver is set to the
+ * rate the ladder picks for it, e.g. a coordinator that retunes per peer.
+ */
+#ifndef nRF24_LINK_ADAPTATION_RATE
+#define nRF24_LINK_ADAPTATION_RATE 0
+#endif
+
+  /**
+   * Force the next send to reprogram the radio
+   */
+  void nRF24_linkadapt_init(void);
+
+  /**
+   * Give a newly added neighbor its starting step
+   *
+   * @param n The new entry, see nRF24_nbr_add()
+   */
+  void nRF24_linkadapt_new(struct nRF24_nbr *n);
+
+  /**
+   * Apply the settings for a destination before sending to it
+   *
+   * Registers are only written when the step differs from the one already
+   * programmed. Broadcasts always use the most robust step, as no
+   * acknowledgement will tell us how they went.
+   *
+   * @param n The destination, or NULL for a broadcast
+   */
+  void nRF24_linkadapt_select(struct nRF24_nbr *n);
+
+  /**
+   * Feed back the outcome of an acknowledged send
+   *
+   * @param n The destination the packet was sent to
+   * @param arc Retransmissions used, from OBSERVE_TX
+   * @param lost True if the packet ended with MAX_RT
+   */
+  void nRF24_linkadapt_update(struct nRF24_nbr *n, uint8_t arc, bool lost);
+
+#endif /* nRF24_LINKADAPT_H */
@@ -0,0 +1,50 @@
+#include "nRF24_linkest.h"
+
+#if defined (nRF24_LINK_ESTIMATE)
+
+static uint8_t
+ewma(uint8_t average, uint8_t sample)
+{
+  return ((uint16_t)average * ((1 << nRF24_ETX_ALPHA_SHIFT) - 1) + sample)
+    >> nRF24_ETX_ALPHA_SHIFT;
+}
+
+/****************************************************************************/
+
+void
+nRF24_linkest_new(struct nRF24_nbr *n)
+{
+  n->etx = 2 * nRF24_ETX_DIVISOR;
+}
+
+/****************************************************************************/
+
+void
+nRF24_linkest_tx(struct nRF24_nbr *n, uint8_t arc, bool delivered)
+{
+  uint8_t tx = delivered ? arc + 1 : nRF24_ETX_NOACK_PENALTY;
+
+  n->etx = ewma(n->etx, tx * nRF24_ETX_DIVISOR);
+}
+
+/****************************************************************************/
+
+uint8_t
+nRF24_linkest_etx(const rimeaddr_t *addr)
+{
+  struct nRF24_nbr *n = nRF24_nbr_lookup(addr);
+
+  return n == NULL ? 0 : n->etx;
+}
+
+/****************************************************************************/
+
+uint8_t
+nRF24_linkest_node_etx(uint8_t node)
+{
+  struct nRF24_nbr *n = nRF24_nbr_lookup_node(node);
+
+  return n == NULL ? 0 : n->etx;
+}
+
+#endif /* defined (nRF24_LINK_ESTIMATE) */
@@ -0,0 +1,83 @@
+/**
+ * \file
+ *         Link quality estimator for the nRF24 driver
+ *
+ *         The radio has no RSSI and only a 1 bit RPD, so link quality is
+ *         estimated from what ESB tells us instead: the retransmissions of
+ *         every acknowledged send (OBSERVE_TX ARC_CNT) and MAX_RT failures.
+ *         The result is an ETX-style value, the expected number of
+ *         transmissions per delivered packet, kept per neighbor in the
+ *         nRF24_nbr table.
+ *
+ *         Values reach Rime through PACKETBUF_ATTR_LINK_QUALITY, in
+ *         nRF24_ETX_DIVISOR units (lower is better):
+ *         - after nRF24_send(), the ETX towards the destination is set on
+ *           the outgoing packet, where the MAC sent callback and collect
+ *           can see it;
+ *         - on receive, with nRF24_DUP_CACHE, our ETX towards the sender
+ *           named in the link header is set on the incoming packet. It is
+ *           left unset for senders we never sent to, and without the link
+ *           header: frames failing their CRC never leave the radio, and all
+ *           senders share our pipe, so received frames tell nothing about
+ *           the link they came over.
+ *
+ *         Enable with nRF24_LINK_ESTIMATE in platform-conf.h.
+ */
+
+#ifndef nRF24_LINKEST_H
+#define nRF24_LINKEST_H
+
+#include "nRF24_nbr.h"
+
+/**
+ * Fixed point scale of ETX values, 8 means 1/8 of a transmission
+ */
+#define nRF24_ETX_DIVISOR 8
+
+/**
+ * Transmissions charged for a packet that ended with MAX_RT
+ */
+#ifndef nRF24_ETX_NOACK_PENALTY
+#define nRF24_ETX_NOACK_PENALTY 16
+#endif
+
+/**
+ * Weight of a new sample as a power of two: 3 means 1/8
+ */
+#ifndef nRF24_ETX_ALPHA_SHIFT
+#define nRF24_ETX_ALPHA_SHIFT 3
+#endif
+
+  /**
+   * Give a newly added neighbor its starting estimate (ETX 2)
+   *
+   * @param n The new entry, see nRF24_nbr_add()
+   */
+  void nRF24_linkest_new(struct nRF24_nbr *n);
+
+  /**
+   * Account for an acknowledged send
+   *
+   * @param n The destination the packet was sent to
+   * @param arc Retransmissions used, from OBSERVE_TX
+   * @param delivered False if the packet ended with MAX_RT
+   */
+  void nRF24_linkest_tx(struct nRF24_nbr *n, uint8_t arc, bool delivered);
+
+  /**
+   * ETX towards a neighbor
+   *
+   * @param addr Rime address of the neighbor
+   * @return ETX in nRF24_ETX_DIVISOR units, 0 if the neighbor is unknown
+   */
+  uint8_t nRF24_linkest_etx(const rimeaddr_t *addr);
+
+  /**
+   * ETX towards a neighbor, by its node byte
+   *
+   * @param node Node byte of the neighbor, u8[0] of its rime address
+   * @return ETX in nRF24_ETX_DIVISOR units, 0 if the neighbor is unknown
+   */
+  uint8_t nRF24_linkest_node_etx(uint8_t node);
+
+#endif /* nRF24_LINKEST_H */
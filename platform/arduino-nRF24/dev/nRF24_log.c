@@ -0,0 +1,131 @@
+#include "nRF24_log.h"
+
+#if defined (nRF24_LOG)
+
+#include "nRF24_slip.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if (nRF24_LOG) & ((nRF24_LOG) - 1) || (nRF24_LOG) > 128 || (nRF24_LOG) < 8
+#error nRF24_LOG must be a power of two, 8 to 128
+#endif
+
+#define MASK ((nRF24_LOG) - 1)
+#define MAGIC 'L'
+#define BURST 32                    /**< Bytes of records per frame */
+#define PERIOD (CLOCK_SECOND / 4)   /**< Drain check while nothing is logged */
+
+static uint8_t ring[nRF24_LOG];
+static volatile uint8_t head;       /**< Next byte written */
+static volatile uint8_t tail;       /**< Next byte sent */
+static volatile uint8_t dropped;    /**< Records lost since the last frame */
+static uint8_t sequence;
+
+PROCESS(nRF24_log_process, "nRF24 log");
+
+/****************************************************************************/
+
+void
+nRF24_log_init(void)
+{
+  process_start(&nRF24_log_process, NULL);
+}
+
+/****************************************************************************/
+
+void
+nRF24_log_record(uint8_t header, uint16_t a, uint16_t b, uint16_t c)
+{
+  uint8_t sreg = SREG;
+  uint8_t args = header >> 6;
+
+  cli();
+  if((uint8_t)(nRF24_LOG - (uint8_t)(head - tail)) < 1 + 2 * args){
+    if(dropped < 0xff){
+      dropped++;
+    }
+    SREG = sreg;
+    return;
+  }
+  ring[head++ & MASK] = header;
+  if(args > 0){
+    ring[head++ & MASK] = a;
+    ring[head++ & MASK] = a >> 8;
+  }
+  if(args > 1){
+    ring[head++ & MASK] = b;
+    ring[head++ & MASK] = b >> 8;
+  }
+  if(args > 2){
+    ring[head++ & MASK] = c;
+    ring[head++ & MASK] = c >> 8;
+  }
+  SREG = sreg;
+}
+
+/****************************************************************************/
+
+static bool
+pending(void)
+{
+  return head != tail || dropped != 0;
+}
+
+/****************************************************************************/
+
+/* Send whole records, up to BURST bytes. Records are written with
+ * interrupts off, so the bytes between tail and head are always whole
+ * records. */
+static void
+drain(void)
+{
+  uint8_t end = head;
+  uint8_t n = 0, len, lost;
+  uint8_t sreg = SREG;
+
+  while((uint8_t)(end - tail - n) > 0){
+    len = 1 + 2 * (ring[(tail + n) & MASK] >> 6);
+    if(n > 0 && n + len > BURST){
+      break;
+    }
+    n += len;
+  }
+  cli();
+  lost = dropped;
+  dropped = 0;
+  SREG = sreg;
+
+  nRF24_slip_end();
+  nRF24_slip_put(MAGIC);
+  nRF24_slip_put(sequence++);
+  nRF24_slip_put(lost);
+  for(len = 0; len < n; len++){
+    nRF24_slip_put(ring[(tail + len) & MASK]);
+  }
+  nRF24_slip_end();
+  tail += n;
+}
+
+/****************************************************************************/
+
+PROCESS_THREAD(nRF24_log_process, ev, data)
+{
+  static struct etimer period;
+
+  PROCESS_BEGIN();
+
+  etimer_set(&period, PERIOD);
+  while(1) {
+    PROCESS_WAIT_EVENT();
+
+    if(ev == PROCESS_EVENT_TIMER){
+      etimer_reset(&period);
+    }
+    nRF24_slip_drain(&nRF24_log_process, pending, drain);
+  }
+
+  PROCESS_END();
+}
+
+#endif /* defined (nRF24_LOG) */
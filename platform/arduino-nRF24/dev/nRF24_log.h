@@ -0,0 +1,84 @@
+/**
+ * \file
+ *         Deferred debug log of the nRF24 driver
+ *
+ *         A log point stores a message id and up to three 16 bit arguments
+ *         in a RAM ring, with interrupts off for a few cycles; no text is
+ *         formatted on the node. A process drains the ring over USART_PORT
+ *         only when no other event is pending, so a debug build keeps the
+ *         radio timing of a production one. tools/nrf24-log expands the
+ *         messages on the host.
+ *
+ *         Records are packed in SLIP framed frames, next to the text and
+ *         the trace frames printed on the same port:
+ *
+ *           'L', sequence, records dropped, then per record a header byte
+ *           (the message id, the number of arguments in the top two bits)
+ *           and the arguments, little endian
+ *
+ *         When the ring is full new records are dropped and counted.
+ *
+ *         Enable with nRF24_LOG in platform-conf.h, set to the ring size in
+ *         bytes. SERIAL_DEBUG_NRF24 enables it with 64 bytes. With neither
+ *         defined the log points compile to nothing and their arguments are
+ *         not evaluated. Only contiki.h is included.
+ */
+
+#ifndef nRF24_LOG_H
+#define nRF24_LOG_H
+
+#include "contiki.h"
+
+#if defined (SERIAL_DEBUG_NRF24) && !defined (nRF24_LOG)
+#define nRF24_LOG 64
+#endif
+
+/**
+ * Messages, at most 64. Keep the formats in tools/nrf24-log in step.
+ */
+typedef enum {
+  RF24_LOG_WRITE_REGISTER = 0,  /**< Register, value */
+  RF24_LOG_WRITE_PAYLOAD,       /**< Bytes, blanks */
+  RF24_LOG_READ_PAYLOAD,        /**< Bytes, blanks */
+  RF24_LOG_FEATURE,             /**< FEATURE register after a change */
+  RF24_LOG_PINS,                /**< CE pin, CSN pin */
+  RF24_LOG_HARDWARE_FAIL,       /**< The radio does not respond */
+  RF24_LOG_MESSAGES
+} rf24_log_e;
+
+#if defined (nRF24_LOG)
+
+  /**
+   * Start the drain process
+   *
+   * Called by the driver init. Records logged before are kept.
+   */
+  void nRF24_log_init(void);
+
+  /**
+   * Store a record
+   *
+   * Safe in interrupts. Use the macros below.
+   *
+   * @param header Message id, argument count in the top two bits
+   * @param a First argument
+   * @param b Second argument
+   * @param c Third argument
+   */
+  void nRF24_log_record(uint8_t header, uint16_t a, uint16_t b, uint16_t c);
+
+#define nRF24_LOG0(id) nRF24_log_record((id), 0, 0, 0)
+#define nRF24_LOG1(id, a) nRF24_log_record((id) | 1 << 6, (a), 0, 0)
+#define nRF24_LOG2(id, a, b) nRF24_log_record((id) | 2 << 6, (a), (b), 0)
+#define nRF24_LOG3(id, a, b, c) nRF24_log_record((id) | 3 << 6, (a), (b), (c))
+
+#else
+
+#define nRF24_LOG0(id) ((void)0)
+#define nRF24_LOG1(id, a) ((void)0)
+#define nRF24_LOG2(id, a, b) ((void)0)
+#define nRF24_LOG3(id, a, b, c) ((void)0)
+
+#endif /* defined (nRF24_LOG) */
+
+#endif /* nRF24_LOG_H */
@@ -0,0 +1,76 @@
+#include "nRF24_nbr.h"
+#include "nRF24_linkadapt.h"
+#include "nRF24_linkest.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+
+#if defined (nRF24_NBR_TABLE)
+
+MEMB(nbr_mem, struct nRF24_nbr, nRF24_NEIGHBORS);
+LIST(nbr_list);
+
+/*---------------------------------------------------------------------------*/
+void
+nRF24_nbr_init(void)
+{
+  memb_init(&nbr_mem);
+  list_init(nbr_list);
+}
+/*---------------------------------------------------------------------------*/
+struct nRF24_nbr *
+nRF24_nbr_lookup(const rimeaddr_t *addr)
+{
+  struct nRF24_nbr *n;
+
+  for(n = list_head(nbr_list); n != NULL; n = list_item_next(n)) {
+    if(rimeaddr_cmp(&n->addr, addr)) {
+      // Keep the list in LRU order, the tail is the next one to go
+      if(n != list_head(nbr_list)) {
+        list_remove(nbr_list, n);
+        list_push(nbr_list, n);
+      }
+      return n;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+struct nRF24_nbr *
+nRF24_nbr_lookup_node(uint8_t node)
+{
+  struct nRF24_nbr *n;
+
+  for(n = list_head(nbr_list); n != NULL; n = list_item_next(n)) {
+    if(n->addr.u8[0] == node) {
+      return n;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+struct nRF24_nbr *
+nRF24_nbr_add(const rimeaddr_t *addr)
+{
+  struct nRF24_nbr *n = nRF24_nbr_lookup(addr);
+
+  if(n != NULL) {
+    return n;
+  }
+
+  n = memb_alloc(&nbr_mem);
+  if(n == NULL) {
+    n = list_chop(nbr_list);
+  }
+  memset(n, 0, sizeof(struct nRF24_nbr));
+  rimeaddr_copy(&n->addr, addr);
+#if defined (nRF24_LINK_ADAPTATION)
+  nRF24_linkadapt_new(n);
+#endif
+#if defined (nRF24_LINK_ESTIMATE)
+  nRF24_linkest_new(n);
+#endif
+  list_push(nbr_list, n);
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* defined (nRF24_NBR_TABLE) */
@@ -0,0 +1,74 @@
+/**
+ * \file
+ *         Neighbor table for the nRF24 driver
+ *
+ *         A small LRU table of per-neighbor radio state, keyed by Rime
+ *         address. Link adaptation keeps its ladder position here and the
+ *         link estimator its ETX, so both survive between sends.
+ */
+
+#ifndef nRF24_NBR_H
+#define nRF24_NBR_H
+
+#include "net/rime/rimeaddr.h"
+#include "nRF24_driver.h"
+
+/* The table is only built when a feature needs per-neighbor state */
+#if defined (nRF24_LINK_ADAPTATION) || defined (nRF24_LINK_ESTIMATE)
+#define nRF24_NBR_TABLE
+#endif
+
+/**
+ * Number of neighbors tracked. When the table is full the least
+ * recently used entry is recycled.
+ */
+#ifndef nRF24_NEIGHBORS
+#define nRF24_NEIGHBORS 8
+#endif
+
+struct nRF24_nbr {
+  struct nRF24_nbr *next;
+  rimeaddr_t addr;
+#if defined (nRF24_LINK_ADAPTATION)
+  uint8_t step;  /**< Current position on the link adaptation ladder */
+  uint8_t good;  /**< Consecutive deliveries without a retransmission */
+  uint8_t retx;  /**< Moving average of ARC_CNT, in 1/16 retries */
+#endif
+#if defined (nRF24_LINK_ESTIMATE)
+  uint8_t etx;   /**< Expected transmissions, in nRF24_ETX_DIVISOR units */
+#endif
+};
+
+  /**
+   * Empty the neighbor table
+   */
+  void nRF24_nbr_init(void);
+
+  /**
+   * Find a neighbor and mark it as most recently used
+   *
+   * @param addr Rime address of the neighbor
+   * @return The entry, or NULL if the neighbor is not in the table
+   */
+  struct nRF24_nbr *nRF24_nbr_lookup(const rimeaddr_t *addr);
+
+  /**
+   * Find a neighbor by its node byte, as in the link header of a frame
+   *
+   * @param node u8[0] of the neighbor's Rime address
+   * @return The entry, or NULL if no neighbor has this node byte
+   */
+  struct nRF24_nbr *nRF24_nbr_lookup_node(uint8_t node);
+
+  /**
+   * Find a neighbor, adding it if it is not in the table yet
+   *
+   * New entries are set up by the features using the table. If the table
+   * is full the least recently used neighbor is dropped to make room.
+   *
+   * @param addr Rime address of the neighbor
+   * @return The entry for @p addr, never NULL
+   */
+  struct nRF24_nbr *nRF24_nbr_add(const rimeaddr_t *addr);
+
+#endif /* nRF24_NBR_H */
@@ -0,0 +1,267 @@
+#include "nRF24_power.h"
+#include "nRF24_arch.h"
+#include "nRF24_trace.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if defined (nRF24_POWER_IDLE) && defined (nRF24_TDMA)
+#error nRF24_POWER_IDLE and nRF24_TDMA both need the rtimer
+#endif
+
+#define TPD2STBY nRF24_US_TO_TICKS(nRF24_TPD2STBY_US)
+#define RTIMER_PER_CLOCK (RTIMER_ARCH_SECOND / CLOCK_SECOND)
+
+/* Per radio, see nRF24_power_select() */
+struct power {
+  volatile rf24_power_e state;
+  rtimer_clock_t since;             /**< rtimer at the last change */
+  clock_time_t since_clock;         /**< clock at the last change */
+  volatile bool waking;             /**< Tpd2stby may still be running */
+  uint32_t ticks[RF24_POWER_STATES];
+  uint16_t delivered;
+};
+
+#if nRF24_RADIOS > 1
+static struct power powers[nRF24_RADIOS];
+static struct power *power = &powers[0];
+#else
+static struct power powers[1];
+#define power (&powers[0])
+#endif
+
+#if defined (nRF24_POWER_IDLE)
+static struct rtimer rt;
+static volatile bool wake_pending;
+
+PROCESS(nRF24_power_process, "nRF24 power");
+#endif
+
+/****************************************************************************/
+
+/* Ticks since the last change. The rtimer wraps within a second, so
+ * longer stays are taken from the clock. */
+static uint32_t
+elapsed(void)
+{
+  uint32_t coarse = (uint32_t)(clock_time_t)(clock_time() - power->since_clock) * RTIMER_PER_CLOCK;
+
+  if(coarse >= 0x8000){
+    return coarse;
+  }
+  return (rtimer_clock_t)(RTIMER_NOW() - power->since);
+}
+
+/****************************************************************************/
+
+void
+nRF24_power_init(void)
+{
+  uint8_t i;
+
+  power->state = RF24_POWER_DOWN;
+  power->since = RTIMER_NOW();
+  power->since_clock = clock_time();
+  power->waking = false;
+  for(i = 0; i < RF24_POWER_STATES; i++){
+    power->ticks[i] = 0;
+  }
+  power->delivered = 0;
+
+#if defined (nRF24_POWER_IDLE)
+  wake_pending = false;
+  process_start(&nRF24_power_process, NULL);
+#endif
+}
+
+#if nRF24_RADIOS > 1
+/****************************************************************************/
+
+void
+nRF24_power_select(uint8_t radio)
+{
+  power = &powers[radio];
+}
+#endif
+
+/****************************************************************************/
+
+void
+nRF24_power_enter(rf24_power_e next)
+{
+  uint8_t sreg = SREG;
+
+  cli();
+  if(next != power->state){
+    power->ticks[power->state] += elapsed();
+    power->since = RTIMER_NOW();
+    power->since_clock = clock_time();
+
+    // Energest has one radio, it follows radio 0
+    if(power == &powers[0]){
+      if(power->state == RF24_RX){
+        ENERGEST_OFF(ENERGEST_TYPE_LISTEN);
+      }else if(power->state == RF24_TX){
+        ENERGEST_OFF(ENERGEST_TYPE_TRANSMIT);
+      }
+      if(next == RF24_RX){
+        ENERGEST_ON(ENERGEST_TYPE_LISTEN);
+      }else if(next == RF24_TX){
+        ENERGEST_ON(ENERGEST_TYPE_TRANSMIT);
+      }
+    }
+
+    power->waking = power->state == RF24_POWER_DOWN;
+    power->state = next;
+    nRF24_TRACE_MODE(next);
+#if defined (nRF24_POWER_IDLE)
+    if(next == RF24_STANDBY){
+      process_poll(&nRF24_power_process);
+    }
+#endif
+  }
+  SREG = sreg;
+}
+
+/****************************************************************************/
+
+rf24_power_e
+nRF24_power_state(void)
+{
+  return power->state;
+}
+
+/****************************************************************************/
+
+bool
+nRF24_power_ready(void)
+{
+  uint8_t sreg;
+
+  if(!power->waking){
+    return true;
+  }
+  sreg = SREG;
+  cli();
+  // Still counted from leaving Power Down, CE has not gone high since
+  if(power->state == RF24_STANDBY && elapsed() < TPD2STBY){
+    SREG = sreg;
+    return false;
+  }
+  power->waking = false;
+  SREG = sreg;
+  return true;
+}
+
+/****************************************************************************/
+
+void
+nRF24_power_wait(void)
+{
+  while(!nRF24_power_ready());
+}
+
+/****************************************************************************/
+
+void
+nRF24_power_delivered(void)
+{
+  power->delivered++;
+}
+
+/****************************************************************************/
+
+uint32_t
+nRF24_power_time(rf24_power_e which)
+{
+  uint32_t t;
+  uint8_t sreg = SREG;
+
+  cli();
+  t = power->ticks[which];
+  if(which == power->state){
+    t += elapsed();
+  }
+  SREG = sreg;
+  return t;
+}
+
+/****************************************************************************/
+
+void
+nRF24_power_print_stats(void)
+{
+  static const uint16_t current_ua[RF24_POWER_STATES] = {
+    nRF24_CURRENT_DOWN_UA, nRF24_CURRENT_STANDBY_UA,
+    nRF24_CURRENT_RX_UA, nRF24_CURRENT_TX_UA
+  };
+  uint32_t ms[RF24_POWER_STATES];
+  uint32_t charge = 0;
+  uint8_t i;
+
+  for(i = 0; i < RF24_POWER_STATES; i++){
+    ms[i] = nRF24_power_time(i) / (RTIMER_ARCH_SECOND / 1000);
+    // In microcoulombs, split so it does not overflow after hours in RX
+    charge += current_ua[i] * (ms[i] / 1000) + current_ua[i] * (ms[i] % 1000) / 1000;
+  }
+  printf_P(PSTR("radio ms down %lu standby %lu rx %lu tx %lu\n"),
+           (unsigned long)ms[RF24_POWER_DOWN], (unsigned long)ms[RF24_STANDBY],
+           (unsigned long)ms[RF24_RX], (unsigned long)ms[RF24_TX]);
+  printf_P(PSTR("radio charge %lu uC delivered %u, %lu uC/packet\n"),
+           (unsigned long)charge, power->delivered,
+           power->delivered ? (unsigned long)(charge / power->delivered) : 0UL);
+}
+
+/****************************************************************************/
+
+#if defined (nRF24_POWER_IDLE)
+static void
+wake_timer(struct rtimer *t, void *ptr)
+{
+  // No SPI here, the main loop may be using it
+  wake_pending = true;
+  process_poll(&nRF24_power_process);
+}
+
+/****************************************************************************/
+
+void
+nRF24_power_wake_at(rtimer_clock_t time)
+{
+  rtimer_clock_t start = time - TPD2STBY - nRF24_US_TO_TICKS(nRF24_POWER_WAKE_MARGIN_US);
+
+  if(RTIMER_CLOCK_LT(start, RTIMER_NOW() + 2)){
+    // Too late to schedule, rtimer would wait for the counter to wrap
+    nRF24_startPowerUp();
+    return;
+  }
+  rtimer_set(&rt, start, 1, wake_timer, NULL);
+}
+
+/****************************************************************************/
+
+PROCESS_THREAD(nRF24_power_process, ev, data)
+{
+  static struct etimer idle;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+
+    if(wake_pending){
+      wake_pending = false;
+      nRF24_startPowerUp();
+    }
+    if(ev == PROCESS_EVENT_POLL && power->state == RF24_STANDBY){
+      // Each return to Standby-I starts the idle period again
+      etimer_set(&idle, nRF24_POWER_IDLE);
+    }else if(ev == PROCESS_EVENT_TIMER && power->state == RF24_STANDBY &&
+             (clock_time_t)(clock_time() - power->since_clock) >= nRF24_POWER_IDLE){
+      nRF24_powerDown();
+    }
+  }
+
+  PROCESS_END();
+}
+#endif /* defined (nRF24_POWER_IDLE) */
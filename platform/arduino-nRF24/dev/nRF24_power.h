@@ -0,0 +1,141 @@
+/**
+ * \file
+ *         Power states of the nRF24
+ *
+ *         The driver reports each change between Power Down, Standby-I, RX
+ *         and TX here. Time in each state is summed in rtimer ticks, and RX
+ *         and TX also go to Energest as ENERGEST_TYPE_LISTEN and
+ *         ENERGEST_TYPE_TRANSMIT. With the datasheet currents this gives the
+ *         radio charge per delivered packet.
+ *
+ *         Leaving Power Down takes Tpd2stby before CE may go high. powerUp()
+ *         only waits what is left of it, and nothing when the wake up was
+ *         started early enough.
+ *
+ *         With nRF24_POWER_IDLE set in platform-conf.h the radio powers
+ *         down after that long in Standby-I, i.e. neither listening nor
+ *         sending. nRF24_power_wake_at() brings it back ahead of known
+ *         traffic without blocking.
+ */
+
+#ifndef nRF24_POWER_H
+#define nRF24_POWER_H
+
+#include "contiki.h"
+#include "nRF24_driver.h"
+
+/**
+ * Power Down to Standby-I time, in microseconds. 1.5ms holds for crystals
+ * with Ls below 30mH as on common modules, 3ms for 60mH, 4.5ms for 90mH.
+ */
+#ifndef nRF24_TPD2STBY_US
+#define nRF24_TPD2STBY_US 1500
+#endif
+
+/**
+ * Supply current per state, in microamps, from the nRF24L01+ datasheet.
+ * RX is given at 1Mbps and TX at 0dBm.
+ */
+#ifndef nRF24_CURRENT_DOWN_UA
+#define nRF24_CURRENT_DOWN_UA 1
+#endif
+#ifndef nRF24_CURRENT_STANDBY_UA
+#define nRF24_CURRENT_STANDBY_UA 26
+#endif
+#ifndef nRF24_CURRENT_RX_UA
+#define nRF24_CURRENT_RX_UA 13100
+#endif
+#ifndef nRF24_CURRENT_TX_UA
+#define nRF24_CURRENT_TX_UA 11300
+#endif
+
+/**
+ * How early nRF24_power_wake_at() starts, on top of Tpd2stby, to cover
+ * the process switch in between. In microseconds.
+ */
+#ifndef nRF24_POWER_WAKE_MARGIN_US
+#define nRF24_POWER_WAKE_MARGIN_US 1000
+#endif
+
+/**
+ * Radio power state.
+ */
+typedef enum { RF24_POWER_DOWN = 0, RF24_STANDBY, RF24_RX, RF24_TX, RF24_POWER_STATES } rf24_power_e;
+
+  /**
+   * Start accounting, with the radio in Power Down
+   *
+   * Called by the driver init.
+   */
+  void nRF24_power_init(void);
+
+#if nRF24_RADIOS > 1
+  /**
+   * Account the radio selected in the driver from here on
+   *
+   * Called by nRF24_select(). Each radio has its own state and times;
+   * Energest follows radio 0.
+   *
+   * @param radio Radio index
+   */
+  void nRF24_power_select(uint8_t radio);
+#endif
+
+  /**
+   * Report a change of state
+   *
+   * Called by the driver, also from rtimer callbacks. Entering Standby-I
+   * from Power Down starts the Tpd2stby wait.
+   *
+   * @param state New state
+   */
+  void nRF24_power_enter(rf24_power_e state);
+
+  /**
+   * Current state
+   */
+  rf24_power_e nRF24_power_state(void);
+
+  /**
+   * Whether Tpd2stby has passed since the radio left Power Down
+   */
+  bool nRF24_power_ready(void);
+
+  /**
+   * Wait until nRF24_power_ready()
+   */
+  void nRF24_power_wait(void);
+
+  /**
+   * Count a frame the radio delivered, for the charge per packet
+   */
+  void nRF24_power_delivered(void);
+
+  /**
+   * Time spent in a state since init, the current stay included
+   *
+   * @param state State to ask for
+   * @return Time in rtimer ticks
+   */
+  uint32_t nRF24_power_time(rf24_power_e state);
+
+  /**
+   * Print the time per state, the charge drawn and the charge per
+   * delivered packet on the serial port
+   */
+  void nRF24_power_print_stats(void);
+
+#if defined (nRF24_POWER_IDLE)
+  /**
+   * Be in Standby-I by a given time
+   *
+   * An rtimer fires Tpd2stby plus nRF24_POWER_WAKE_MARGIN_US ahead, and
+   * the power process then leaves Power Down without waiting. Takes the
+   * rtimer, so it does not mix with nRF24_TDMA.
+   *
+   * @param time When the radio is needed, in rtimer ticks
+   */
+  void nRF24_power_wake_at(rtimer_clock_t time);
+#endif
+
+#endif /* nRF24_POWER_H */
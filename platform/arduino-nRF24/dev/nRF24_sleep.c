@@ -0,0 +1,252 @@
+#include "nRF24_sleep.h"
+#include "nRF24_driver.h"
+#include "nRF24_trace.h"
+
+#if defined (nRF24_SLEEP)
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+static uint32_t idle_ticks;         /**< rtimer ticks in IDLE */
+static uint16_t idle_count;
+static unsigned long start_seconds;
+
+#if defined (nRF24_SLEEP_32K)
+#define DEEP_MIN 2                  /**< Timer2 ticks, shorter waits use IDLE */
+#define DEEP_MAX 250                /**< Timer2 ticks, below the 8 bit wrap */
+
+/* Wait for writes to the asynchronous Timer2 registers to take effect */
+#define TIMER2_SYNC() while(ASSR & (_BV(TCN2UB) | _BV(OCR2AUB) | _BV(TCR2AUB) | _BV(TCR2BUB)))
+
+static uint32_t save_ticks;         /**< Timer2 ticks in power-save */
+static uint16_t save_count;
+static uint8_t frac;                /**< Part of a clock tick slept, in CLOCK_SECOND / 32 */
+#endif
+
+/****************************************************************************/
+
+void
+nRF24_sleep_init(void)
+{
+  uint8_t sreg = SREG;
+
+  cli();
+  // IRQ pin as input, a change on it wakes the MCU from any sleep mode
+  DDRB &= ~_BV(DDB0);
+  PCMSK0 |= _BV(PCINT0);
+  PCIFR = _BV(PCIF0);
+  PCICR |= _BV(PCIE0);
+
+#if defined (nRF24_SLEEP_32K)
+  // Free running from the crystal, 1024 prescaler
+  TIMSK2 = 0;
+  ASSR = _BV(AS2);
+  TCNT2 = 0;
+  TCCR2A = 0;
+  TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);
+  TIMER2_SYNC();
+  TIFR2 = _BV(OCF2A);
+  save_ticks = 0;
+  save_count = 0;
+  frac = 0;
+#endif
+
+  idle_ticks = 0;
+  idle_count = 0;
+  start_seconds = clock_seconds();
+  SREG = sreg;
+}
+
+/****************************************************************************/
+
+#if defined (nRF24_SLEEP_32K)
+/* Timer2 ticks power-save may last, 0 if only IDLE is safe. Interrupts
+ * are off. */
+static uint8_t
+deep_ticks(void)
+{
+#if defined (nRF24_TIMESTAMP)
+  // Timer1 stops in power-save, and with it the 32 bit timebase
+  return 0;
+#else
+  clock_time_t now = clock_time();
+  clock_time_t next;
+  uint32_t ticks;
+
+  // rtimer_arch_schedule() enables the compare interrupt, its ISR clears it
+  if(TIMSK1 & _BV(OCIE1A)){
+    return 0;
+  }
+  if(!etimer_pending()){
+    return DEEP_MAX;
+  }
+  next = etimer_next_expiration_time();
+  if(!CLOCK_LT(now, next)){
+    return 0;
+  }
+  // Rounded down, IDLE covers the rest
+  ticks = (uint32_t)(clock_time_t)(next - now) * nRF24_SLEEP_TIMER2_SECOND / CLOCK_SECOND;
+  if(ticks < DEEP_MIN){
+    return 0;
+  }
+  return ticks > DEEP_MAX ? DEEP_MAX : ticks;
+#endif
+}
+
+/****************************************************************************/
+
+/* The USART stops in power-save, so let the last character out. TXC0 is
+ * cleared here, and set again once a character has left the shift
+ * register. If nothing was sent since, it stays clear and the wait ends
+ * after one character time. */
+static void
+serial_flush(void)
+{
+  uint16_t us = (uint16_t)(160UL * (UBRR0 + 1) / (F_CPU / 1000000UL));
+
+  if(UCSR0A & _BV(U2X0)){
+    us /= 2;
+  }
+  while(!(UCSR0A & _BV(UDRE0)));
+  while(!(UCSR0A & _BV(TXC0)) && us > 0){
+    clock_delay_usec(10);
+    us = us > 10 ? us - 10 : 0;
+  }
+  // FE0, DOR0 and UPE0 must be written as zero
+  UCSR0A = (UCSR0A & (_BV(U2X0) | _BV(MPCM0))) | _BV(TXC0);
+}
+
+/****************************************************************************/
+
+/* Interrupts are off, and on again when it returns */
+static void
+power_save(uint8_t ticks)
+{
+  uint8_t from, slept;
+  uint16_t elapsed;
+
+  serial_flush();
+
+  from = TCNT2;
+  OCR2A = from + ticks;
+  TIMER2_SYNC();
+  TIFR2 = _BV(OCF2A);
+  TIMSK2 = _BV(OCIE2A);
+
+  set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+  ENERGEST_OFF(ENERGEST_TYPE_CPU);
+  ENERGEST_ON(ENERGEST_TYPE_LPM);
+  sleep_enable();
+  sei();
+  sleep_cpu();
+  sleep_disable();
+  cli();
+  ENERGEST_OFF(ENERGEST_TYPE_LPM);
+  ENERGEST_ON(ENERGEST_TYPE_CPU);
+
+  TIMSK2 = 0;
+  // TCNT2 reads stale until a TOSC1 cycle after waking up, a synchronised
+  // register write takes longer than that
+  OCR2A = from;
+  TIMER2_SYNC();
+  slept = TCNT2 - from;
+
+  // Timer0 was stopped, give the clock the time slept
+  elapsed = frac + (uint16_t)slept * CLOCK_SECOND;
+  frac = elapsed % nRF24_SLEEP_TIMER2_SECOND;
+  clock_adjust_ticks(elapsed / nRF24_SLEEP_TIMER2_SECOND);
+  etimer_request_poll();
+
+  save_ticks += slept;
+  save_count++;
+  sei();
+}
+#endif /* defined (nRF24_SLEEP_32K) */
+
+/****************************************************************************/
+
+void
+nRF24_sleep(void)
+{
+  rtimer_clock_t before;
+#if defined (nRF24_SLEEP_32K)
+  uint8_t ticks;
+#endif
+
+  // An interrupt between the check and sleep_cpu() would be missed until
+  // the next one, so both happen with interrupts off. sei() takes effect
+  // after the following instruction.
+  cli();
+  if(process_nevents() > 0){
+    sei();
+    return;
+  }
+
+#if defined (nRF24_SLEEP_32K)
+  ticks = deep_ticks();
+  if(ticks > 0){
+    power_save(ticks);
+    return;
+  }
+#endif
+
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  before = RTIMER_NOW();
+  ENERGEST_OFF(ENERGEST_TYPE_CPU);
+  ENERGEST_ON(ENERGEST_TYPE_LPM);
+  sleep_enable();
+  sei();
+  sleep_cpu();
+  sleep_disable();
+  ENERGEST_OFF(ENERGEST_TYPE_LPM);
+  ENERGEST_ON(ENERGEST_TYPE_CPU);
+
+  // The clock tick ends IDLE well before Timer1 wraps
+  idle_ticks += (rtimer_clock_t)(RTIMER_NOW() - before);
+  idle_count++;
+}
+
+/****************************************************************************/
+
+void
+nRF24_sleep_print_stats(void)
+{
+  unsigned long total = (clock_seconds() - start_seconds) * 1000UL;
+  unsigned long idle = idle_ticks / (RTIMER_ARCH_SECOND / 1000);
+  unsigned long save = 0;
+  uint16_t saves = 0;
+
+#if defined (nRF24_SLEEP_32K)
+  save = save_ticks / nRF24_SLEEP_TIMER2_SECOND * 1000UL +
+         save_ticks % nRF24_SLEEP_TIMER2_SECOND * 1000UL / nRF24_SLEEP_TIMER2_SECOND;
+  saves = save_count;
+#endif
+
+  printf_P(PSTR("mcu ms awake %lu idle %lu (%u) save %lu (%u)\n"),
+           total > idle + save ? total - idle - save : 0UL,
+           idle, idle_count, save, saves);
+}
+
+/****************************************************************************/
+
+ISR(PCINT0_vect)
+{
+  nRF24_TRACE_BEGIN(RF24_TRACE_IRQ_ISR);
+  // Active low, the rising edge is only STATUS being cleared
+  if(!(PINB & _BV(PINB0))){
+    process_poll(&nRF24_process);
+  }
+  nRF24_TRACE_END(RF24_TRACE_IRQ_ISR);
+}
+
+#if defined (nRF24_SLEEP_32K)
+/****************************************************************************/
+
+ISR(TIMER2_COMPA_vect)
+{
+  // Only here to end power-save
+}
+#endif
+
+#endif /* defined (nRF24_SLEEP) */
@@ -0,0 +1,62 @@
+/**
+ * \file
+ *         MCU sleep between events, woken by the nRF24 IRQ line
+ *
+ *         main() calls nRF24_sleep() whenever process_run() finds nothing
+ *         to do. The MCU then sleeps until an interrupt: the clock tick, the
+ *         rtimer, the USART or the nRF24 IRQ line on pin 8 (PB0), which gets
+ *         a pin change interrupt polling the driver process. The driver no
+ *         longer polls the RX FIFO in a loop while listening.
+ *
+ *         IDLE is used by default. It keeps every timer running, the clock
+ *         tick wakes the MCU CLOCK_SECOND times per second.
+ *
+ *         With nRF24_SLEEP_32K, Timer2 runs from a 32.768kHz crystal on
+ *         TOSC1/TOSC2, which share the pins of the main crystal, so the MCU
+ *         must run from its internal oscillator. Power-save is then used
+ *         when no rtimer is pending, nRF24_TIMESTAMP is off (the Timer1
+ *         timebase would stop) and the next etimer is at least two Timer2
+ *         ticks away. Timer2 wakes the MCU for that etimer, and the clock is
+ *         advanced by the time slept. The USART stops in power-save, so
+ *         serial input is lost while the node sleeps deeply.
+ *
+ *         Enable with nRF24_SLEEP in platform-conf.h.
+ */
+
+#ifndef nRF24_SLEEP_H
+#define nRF24_SLEEP_H
+
+/* Only contiki.h: main() has its own bool, nRF24_driver.h would clash
+ * with it */
+#include "contiki.h"
+
+#if defined (nRF24_SLEEP)
+
+/**
+ * Timer2 ticks per second in power-save, 32768Hz divided by 1024
+ */
+#define nRF24_SLEEP_TIMER2_SECOND 32
+
+  /**
+   * Set up the IRQ pin change interrupt, and Timer2 with nRF24_SLEEP_32K
+   *
+   * Called from main().
+   */
+  void nRF24_sleep_init(void);
+
+  /**
+   * Sleep until the next interrupt
+   *
+   * Returns at once if an event or poll is pending.
+   */
+  void nRF24_sleep(void);
+
+  /**
+   * Print the time spent awake, in IDLE and in power-save on the serial
+   * port, with the number of sleeps
+   */
+  void nRF24_sleep_print_stats(void);
+
+#endif /* defined (nRF24_SLEEP) */
+
+#endif /* nRF24_SLEEP_H */
@@ -0,0 +1,44 @@
+#include "nRF24_slip.h"
+
+#if defined (nRF24_TRACE) || defined (nRF24_LOG)
+
+#include "dev/rs232.h"
+
+/****************************************************************************/
+
+void
+nRF24_slip_end(void)
+{
+  rs232_send(USART_PORT, nRF24_SLIP_END);
+}
+
+/****************************************************************************/
+
+void
+nRF24_slip_put(uint8_t c)
+{
+  uint8_t next;
+
+  rs232_send(USART_PORT, nRF24_slip_escape(c, &next));
+  if(next){
+    rs232_send(USART_PORT, next);
+  }
+}
+
+/****************************************************************************/
+
+void
+nRF24_slip_drain(struct process *p, bool (*pending)(void), void (*drain)(void))
+{
+  if(!pending()){
+    return;
+  }
+  if(process_nevents() == 0){
+    drain();
+  }
+  if(pending()){
+    process_poll(p);
+  }
+}
+
+#endif /* defined (nRF24_TRACE) || defined (nRF24_LOG) */
@@ -0,0 +1,77 @@
+/**
+ * \file
+ *         SLIP framing of the binary streams the driver sends over USART_PORT
+ *
+ *         The trace, the log and the sniffer send their records as SLIP
+ *         framed frames (RFC 1055), each opened and closed by SLIP_END, so
+ *         the host tools find them among the text printed on the same port.
+ *         The first byte of a frame tells which stream it belongs to.
+ *
+ *         The trace and the log fill a RAM ring and drain it from a process
+ *         with nRF24_slip_drain(). The sniffer sends from the USART data
+ *         register empty interrupt, one byte at a time with
+ *         nRF24_slip_escape().
+ */
+
+#ifndef nRF24_SLIP_H
+#define nRF24_SLIP_H
+
+#include "contiki.h"
+#include "nRF24_driver.h"
+
+#define nRF24_SLIP_END 0300
+#define nRF24_SLIP_ESC 0333
+#define nRF24_SLIP_ESC_END 0334
+#define nRF24_SLIP_ESC_ESC 0335
+
+  /**
+   * The first byte to send for a data byte
+   *
+   * Inline, the sniffer calls it from its interrupt.
+   *
+   * @param c Data byte
+   * @param[out] next The byte to send after it, 0 if @p c needs no escape
+   * @return The byte to send now
+   */
+  static inline uint8_t
+  nRF24_slip_escape(uint8_t c, uint8_t *next)
+  {
+    if(c == nRF24_SLIP_END){
+      *next = nRF24_SLIP_ESC_END;
+      return nRF24_SLIP_ESC;
+    }
+    if(c == nRF24_SLIP_ESC){
+      *next = nRF24_SLIP_ESC_ESC;
+      return nRF24_SLIP_ESC;
+    }
+    *next = 0;
+    return c;
+  }
+
+  /**
+   * Open or close a frame on USART_PORT
+   */
+  void nRF24_slip_end(void);
+
+  /**
+   * Send a data byte on USART_PORT, escaped
+   *
+   * @param c Data byte
+   */
+  void nRF24_slip_put(uint8_t c);
+
+  /**
+   * Drain a ring from its process, when nothing else is due
+   *
+   * The UART is slow, a frame takes milliseconds: @p drain only runs when
+   * no other event is pending, and @p p is polled again for what is left.
+   * Call it on every event of the process.
+   *
+   * @param p The draining process
+   * @param pending Whether records or a drop count wait to be sent
+   * @param drain Sends one frame
+   */
+  void nRF24_slip_drain(struct process *p, bool (*pending)(void),
+                        void (*drain)(void));
+
+#endif /* nRF24_SLIP_H */
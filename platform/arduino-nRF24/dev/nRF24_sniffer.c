@@ -0,0 +1,308 @@
+#include "nRF24_sniffer.h"
+
+#if defined (nRF24_SNIFFER)
+
+#include "nRF24_arch.h"
+#include "nRF24_power.h"
+#include "nRF24_slip.h"
+#include "dev/serial-line.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (nRF24_SNIFFER) < 1 || (nRF24_SNIFFER) > 16
+#error nRF24_SNIFFER must be 1 to 16 frames
+#endif
+#if (nRF24_SNIFFER_BAUD) > F_CPU / 8
+#error nRF24_SNIFFER_BAUD above F_CPU / 8
+#endif
+
+#define COMMAND "nrf24 sniff"
+#define MAGIC 'S'
+#define FRAME_LEN 32
+#define HEADER_LEN 6
+#define RECORD_LEN (4 + 1 + FRAME_LEN)   /**< Timestamp, pipe, frame */
+#define UBRR_VALUE ((F_CPU / 4 / (nRF24_SNIFFER_BAUD) + 1) / 2 - 1)
+
+struct bank {
+  uint8_t count;
+  uint8_t data[HEADER_LEN + (nRF24_SNIFFER) * RECORD_LEN];
+};
+
+static struct bank banks[2];
+static struct bank *fill;             /**< Frames are read into this one */
+static struct bank * volatile out;    /**< Sent by the ISR, NULL when idle */
+static uint16_t out_len;
+static uint16_t out_pos;              /**< 0 and out_len + 1 are nRF24_SLIP_END */
+static uint8_t escaped;               /**< Byte due after nRF24_SLIP_ESC, or 0 */
+
+static bool running;
+static bool was_listening;
+static uint8_t channel;
+static uint8_t rate;
+static uint8_t sequence;
+static uint8_t dropped;
+static uint16_t saved_ubrr;
+static uint8_t saved_u2x;
+#if !defined (nRF24_TIMESTAMP)
+static rtimer_clock_t last_now;
+static uint16_t wraps;
+#endif
+
+PROCESS(nRF24_sniffer_process, "nRF24 sniffer");
+
+/****************************************************************************/
+
+void
+nRF24_sniffer_init(void)
+{
+  process_start(&nRF24_sniffer_process, NULL);
+}
+
+/****************************************************************************/
+
+bool
+nRF24_sniffer_running(void)
+{
+  return running;
+}
+
+/****************************************************************************/
+
+/* 32 bit tick count. Without the Timer1 overflow interrupt of
+ * nRF24_TIMESTAMP, wraps are counted here: the process polls the FIFO far
+ * more often than Timer1 wraps. */
+static uint32_t
+now(void)
+{
+#if defined (nRF24_TIMESTAMP)
+  return nRF24_arch_now();
+#else
+  rtimer_clock_t t = RTIMER_NOW();
+
+  if(t < last_now){
+    wraps++;
+  }
+  last_now = t;
+  return (uint32_t)wraps << 16 | t;
+#endif
+}
+
+/****************************************************************************/
+
+void
+nRF24_sniffer_start(uint8_t ch, rf24_datarate_e speed)
+{
+  // Wire order is MSB first: 0x00 on air, then the preamble
+  static const uint8_t preamble_aa[] = { 0xAA, 0x00 };
+  static const uint8_t preamble_55[] = { 0x55, 0x00 };
+  uint8_t scratch[FRAME_LEN];
+  uint8_t pipe;
+
+  if(!running){
+    was_listening = nRF24_power_state() == RF24_RX;
+  }
+  process_exit(&nRF24_process);
+  nRF24_stopListening();
+
+  // CRC stays on while any pipe has auto-ack
+  nRF24_setAutoAck_AllPipes(false);
+  nRF24_disableCRC();
+  nRF24_disableDynamicPayloads();
+  nRF24_setPayloadSize(FRAME_LEN);
+  nRF24_setAddressWidth(2);
+  nRF24_setDataRate(speed);
+  nRF24_setChannel(ch);
+  for(pipe = 0; pipe < 6; pipe++){
+    nRF24_closeReadingPipe(pipe);
+  }
+  nRF24_openReadingPipe(0, preamble_aa);
+  nRF24_openReadingPipe(1, preamble_55);
+  while(nRF24_available(NULL)){
+    nRF24_read(scratch, FRAME_LEN);
+  }
+
+  if(!running){
+    // Let the last character out at the old rate, 9600 baud or faster
+    while(!(UCSR0A & _BV(UDRE0)));
+    clock_delay_usec(2000);
+    saved_ubrr = UBRR0;
+    saved_u2x = UCSR0A & _BV(U2X0);
+    // FE0, DOR0 and UPE0 must be written as zero
+    UCSR0A = (UCSR0A & _BV(MPCM0)) | _BV(U2X0);
+    UBRR0 = UBRR_VALUE;
+  }
+
+  channel = ch;
+  rate = speed;
+  fill = &banks[0];
+  fill->count = 0;
+  dropped = 0;
+  running = true;
+  nRF24_startListening();
+  process_poll(&nRF24_sniffer_process);
+}
+
+/****************************************************************************/
+
+void
+nRF24_sniffer_stop(void)
+{
+  if(!running){
+    return;
+  }
+  running = false;
+  // At most one bank, a few ms
+  while(out != NULL);
+  while(!(UCSR0A & _BV(UDRE0)));
+  clock_delay_usec(100);
+  UCSR0A = (UCSR0A & _BV(MPCM0)) | saved_u2x;
+  UBRR0 = saved_ubrr;
+
+  // Both return before the radio has settled, progress() completes them
+  nRF24_driver.init();
+  if(was_listening){
+    nRF24_beginStartListening();
+  }
+}
+
+/****************************************************************************/
+
+/* Empty the RX FIFO into the bank being filled */
+static void
+capture(void)
+{
+  uint8_t scratch[FRAME_LEN];
+  uint8_t *r;
+  uint32_t t;
+  uint8_t pipe;
+
+  while(nRF24_available(&pipe)){
+    if(fill->count == nRF24_SNIFFER){
+      nRF24_read(scratch, FRAME_LEN);
+      if(dropped < 0xff){
+        dropped++;
+      }
+      continue;
+    }
+    t = now();
+    r = &fill->data[HEADER_LEN + fill->count * RECORD_LEN];
+    r[0] = t;
+    r[1] = t >> 8;
+    r[2] = t >> 16;
+    r[3] = t >> 24;
+    r[4] = pipe;
+    nRF24_read(&r[5], FRAME_LEN);
+    fill->count++;
+  }
+}
+
+/****************************************************************************/
+
+/* Hand the bank filled so far to the USART, if it is idle */
+static void
+flush(void)
+{
+  if(out != NULL || fill->count == 0){
+    return;
+  }
+  fill->data[0] = MAGIC;
+  fill->data[1] = sequence++;
+  fill->data[2] = dropped;
+  fill->data[3] = nRF24_TICK_US;
+  fill->data[4] = channel;
+  fill->data[5] = rate;
+  dropped = 0;
+
+  out_len = HEADER_LEN + fill->count * RECORD_LEN;
+  out_pos = 0;
+  escaped = 0;
+  out = fill;
+  fill = fill == &banks[0] ? &banks[1] : &banks[0];
+  fill->count = 0;
+  UCSR0B |= _BV(UDRIE0);
+}
+
+/****************************************************************************/
+
+/* One byte of the bank being sent per interrupt, SLIP encoded on the way */
+ISR(USART_UDRE_vect)
+{
+  uint8_t c;
+
+  if(escaped){
+    UDR0 = escaped;
+    escaped = 0;
+    return;
+  }
+  if(out_pos > out_len + 1){
+    // The process polls itself while capturing, it sees out cleared
+    UCSR0B &= ~_BV(UDRIE0);
+    out = NULL;
+    return;
+  }
+  if(out_pos == 0 || out_pos == out_len + 1){
+    UDR0 = nRF24_SLIP_END;
+    out_pos++;
+    return;
+  }
+  c = out->data[out_pos - 1];
+  out_pos++;
+  UDR0 = nRF24_slip_escape(c, &escaped);
+}
+
+/****************************************************************************/
+
+static void
+command(const char *arg)
+{
+  rf24_datarate_e speed = RF24_1MBPS;
+  char *end;
+  unsigned long ch;
+
+  if(strcmp(arg, " stop") == 0){
+    nRF24_sniffer_stop();
+    return;
+  }
+  ch = strtoul(arg, &end, 10);
+  if(end == arg || ch > 125){
+    return;
+  }
+  if(strcmp(end, " 250k") == 0){
+    speed = RF24_250KBPS;
+  }else if(strcmp(end, " 2m") == 0){
+    speed = RF24_2MBPS;
+  }else if(*end != '\0' && strcmp(end, " 1m") != 0){
+    return;
+  }
+  nRF24_sniffer_start(ch, speed);
+}
+
+/****************************************************************************/
+
+PROCESS_THREAD(nRF24_sniffer_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+
+    if(ev == serial_line_event_message && data != NULL &&
+       strncmp(data, COMMAND, sizeof(COMMAND) - 1) == 0){
+      command((const char *)data + sizeof(COMMAND) - 1);
+    }
+    if(!running){
+      continue;
+    }
+    capture();
+    flush();
+    // No IRQ line needed: the FIFO is polled while capturing
+    process_poll(&nRF24_sniffer_process);
+  }
+
+  PROCESS_END();
+}
+
+#endif /* defined (nRF24_SNIFFER) */
@@ -0,0 +1,79 @@
+/**
+ * \file
+ *         Promiscuous capture of nRF24 traffic to the serial port
+ *
+ *         The radio cannot turn its address match off, so the sniffer uses
+ *         the 2 byte address trick: with SETUP_AW at its reserved value the
+ *         address is 2 bytes, and pipes 0 and 1 listen for 0x00AA and
+ *         0x0055. Noise before a frame often demodulates as a 0x00 byte,
+ *         followed by the preamble (0xAA or 0x55, the complement of the
+ *         first address bit), so the radio takes the preamble as the
+ *         address. With CRC and auto-ack off and 32 byte fixed payloads,
+ *         the payload is then the raw frame: its address, the packet
+ *         control field, payload and CRC, as far as 32 bytes go. Most of
+ *         what is captured is noise; tools/nrf24-sniff checks the CRCs.
+ *
+ *         Frames are read into one of two banks while the USART sends the
+ *         other one from its data register empty interrupt, so the RX FIFO
+ *         is emptied while the port drains. When the UART falls behind
+ *         and the bank filling up is full, frames are dropped and counted.
+ *         The port runs at nRF24_SNIFFER_BAUD while capturing, by default
+ *         F_CPU / 8, the highest rate of the USART (2Mbaud at 16MHz).
+ *
+ *         Each bank goes out as one SLIP frame:
+ *
+ *           'S', sequence, frames dropped, tick in us, channel, data rate,
+ *           then per frame the timestamp (32 bit ticks, little endian),
+ *           the pipe (0: preamble 0xAA, 1: 0x55) and the 32 bytes read
+ *
+ *         "nrf24 sniff <channel> [250k|1m|2m]" on the serial line starts a
+ *         capture, "nrf24 sniff stop" ends it. The sniffer owns the radio
+ *         and the USART output while it runs: nRF24_process is stopped,
+ *         nothing should send, and text printed meanwhile is lost between
+ *         frames or damages one. Stopping initialises the driver again.
+ *
+ *         Enable with nRF24_SNIFFER in platform-conf.h, set to the frames
+ *         per bank.
+ */
+
+#ifndef nRF24_SNIFFER_H
+#define nRF24_SNIFFER_H
+
+#include "contiki.h"
+#include "nRF24_driver.h"
+
+#if defined (nRF24_SNIFFER)
+
+#ifndef nRF24_SNIFFER_BAUD
+#define nRF24_SNIFFER_BAUD (F_CPU / 8)
+#endif
+
+  /**
+   * Start the serial line command
+   *
+   * Called by the driver init.
+   */
+  void nRF24_sniffer_init(void);
+
+  /**
+   * Take the radio and start capturing
+   *
+   * @param channel RF channel, 0-125
+   * @param speed Data rate of the traffic to capture
+   */
+  void nRF24_sniffer_start(uint8_t channel, rf24_datarate_e speed);
+
+  /**
+   * Stop capturing and give the radio back to the driver, initialised as
+   * at boot and listening again if it was
+   */
+  void nRF24_sniffer_stop(void);
+
+  /**
+   * Whether a capture is running
+   */
+  bool nRF24_sniffer_running(void);
+
+#endif /* defined (nRF24_SNIFFER) */
+
+#endif /* nRF24_SNIFFER_H */
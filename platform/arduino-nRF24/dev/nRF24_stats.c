@@ -0,0 +1,137 @@
+#include "nRF24_stats.h"
+
+#if defined (nRF24_STATS)
+
+#include "nRF24_driver.h"
+#include "nRF24_power.h"
+#include "dev/serial-line.h"
+#include <string.h>
+
+#define COMMAND "nrf24 stats"
+
+struct nRF24_stats nRF24_stats_data;
+
+PROCESS(nRF24_stats_process, "nRF24 stats");
+
+/****************************************************************************/
+
+void
+nRF24_stats_init(void)
+{
+  memset(&nRF24_stats_data, 0, sizeof(nRF24_stats_data));
+  process_start(&nRF24_stats_process, NULL);
+}
+
+/****************************************************************************/
+
+const struct nRF24_stats *
+nRF24_stats(void)
+{
+  return &nRF24_stats_data;
+}
+
+/****************************************************************************/
+
+static uint8_t *
+put16(uint8_t *p, uint16_t v)
+{
+  *p++ = v;
+  *p++ = v >> 8;
+  return p;
+}
+
+/****************************************************************************/
+
+static uint8_t *
+put32(uint8_t *p, uint32_t v)
+{
+  return put16(put16(p, v), v >> 16);
+}
+
+/****************************************************************************/
+
+uint8_t
+nRF24_stats_snapshot(uint8_t *buf, uint8_t size)
+{
+  const struct nRF24_stats *s = &nRF24_stats_data;
+  uint8_t *p = buf;
+  uint8_t i;
+
+  if(size < nRF24_STATS_SNAPSHOT_LEN){
+    return 0;
+  }
+  *p++ = nRF24_STATS_VERSION;
+  p = put16(p, s->tx);
+  p = put16(p, s->tx_acked);
+  p = put16(p, s->tx_max_rt);
+  for(i = 0; i < 16; i++){
+    p = put16(p, s->retries[i]);
+  }
+  for(i = 0; i < 6; i++){
+    p = put16(p, s->rx[i]);
+  }
+  p = put16(p, s->rx_fifo_full);
+  p = put16(p, s->rx_bad_length);
+  p = put32(p, s->spi_transactions);
+  p = put32(p, s->spi_bytes);
+  p = put32(p, s->wait_ticks);
+  return p - buf;
+}
+
+/****************************************************************************/
+
+void
+nRF24_stats_print(void)
+{
+  const struct nRF24_stats *s = &nRF24_stats_data;
+  uint8_t i;
+
+  printf_P(PSTR("nrf24 tx %u acked %u max_rt %u\nnrf24 retries"),
+           s->tx, s->tx_acked, s->tx_max_rt);
+  for(i = 0; i < 16; i++){
+    printf_P(PSTR(" %u"), s->retries[i]);
+  }
+  printf_P(PSTR("\nnrf24 rx %u %u %u %u %u %u fifo_full %u bad_length %u\n"),
+           s->rx[0], s->rx[1], s->rx[2], s->rx[3], s->rx[4], s->rx[5],
+           s->rx_fifo_full, s->rx_bad_length);
+  printf_P(PSTR("nrf24 spi %lu transactions %lu bytes, waited %lu ms\n"),
+           (unsigned long)s->spi_transactions, (unsigned long)s->spi_bytes,
+           (unsigned long)(s->wait_ticks / (RTIMER_ARCH_SECOND / 1000)));
+}
+
+/****************************************************************************/
+
+PROCESS_THREAD(nRF24_stats_process, ev, data)
+{
+  const char *arg;
+  uint8_t snapshot[nRF24_STATS_SNAPSHOT_LEN];
+  uint8_t i, len;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == serial_line_event_message && data != NULL);
+
+    arg = (const char *)data;
+    if(strncmp(arg, COMMAND, sizeof(COMMAND) - 1) == 0){
+      arg += sizeof(COMMAND) - 1;
+      if(*arg == '\0'){
+        nRF24_stats_print();
+        nRF24_power_print_stats();
+      }else if(strcmp(arg, " bin") == 0){
+        len = nRF24_stats_snapshot(snapshot, sizeof(snapshot));
+        printf_P(PSTR("nrf24 bin "));
+        for(i = 0; i < len; i++){
+          printf_P(PSTR("%02x"), snapshot[i]);
+        }
+        printf_P(PSTR("\n"));
+      }else if(strcmp(arg, " reset") == 0){
+        memset(&nRF24_stats_data, 0, sizeof(nRF24_stats_data));
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+
+#endif /* defined (nRF24_STATS) */
@@ -0,0 +1,96 @@
+/**
+ * \file
+ *         Statistics counters of the nRF24 driver
+ *
+ *         Enable with nRF24_STATS in platform-conf.h. The driver then counts
+ *         frames sent and their outcome, the retries each unicast frame
+ *         took (ARC_CNT of OBSERVE_TX), frames read per pipe, RX FIFO full
+ *         events, corrupt dynamic payload lengths, SPI traffic and the time
+ *         spent in blocking waits.
+ *
+ *         Every counter is written from process context only, never from
+ *         an interrupt, so they are updated and read without locking.
+ *         Counters wrap around; compare the difference of two snapshots.
+ *
+ *         A line "nrf24 stats" on the serial line prints them, with the
+ *         radio power statistics. "nrf24 stats bin" prints the binary
+ *         snapshot in hex, "nrf24 stats reset" clears the counters.
+ *
+ *         Only contiki.h is included, so avr-spi.h can count SPI bytes.
+ */
+
+#ifndef nRF24_STATS_H
+#define nRF24_STATS_H
+
+#include "contiki.h"
+
+/**
+ * Version of the snapshot layout, its first byte
+ */
+#define nRF24_STATS_VERSION 1
+
+/**
+ * Snapshot length: the version, 27 16 bit and 3 32 bit counters
+ */
+#define nRF24_STATS_SNAPSHOT_LEN (1 + 27 * 2 + 3 * 4)
+
+/**
+ * Driver counters, in the order of the snapshot
+ */
+struct nRF24_stats {
+  uint16_t tx;               /**< Frames written */
+  uint16_t tx_acked;         /**< Unicast frames acknowledged */
+  uint16_t tx_max_rt;        /**< Unicast frames that ended with MAX_RT */
+  uint16_t retries[16];      /**< Unicast frames by the retries they took */
+  uint16_t rx[6];            /**< Frames read per pipe, duplicates included */
+  uint16_t rx_fifo_full;     /**< Times the RX FIFO was found full */
+  uint16_t rx_bad_length;    /**< Dynamic payload lengths above 32 */
+  uint32_t spi_transactions; /**< Chip selects */
+  uint32_t spi_bytes;        /**< Bytes clocked over SPI */
+  uint32_t wait_ticks;       /**< rtimer ticks blocked on TX_DS/MAX_RT and settling */
+};
+
+#if defined (nRF24_STATS)
+
+extern struct nRF24_stats nRF24_stats_data;
+
+#define nRF24_STATS_INC(field) (nRF24_stats_data.field++)
+#define nRF24_STATS_ADD(field, n) (nRF24_stats_data.field += (n))
+#define nRF24_STATS_WAITED(since) \
+  (nRF24_stats_data.wait_ticks += (rtimer_clock_t)(RTIMER_NOW() - (since)))
+
+  /**
+   * Clear the counters and start the serial line command
+   *
+   * Called by the driver init.
+   */
+  void nRF24_stats_init(void);
+
+  /**
+   * Current counters
+   */
+  const struct nRF24_stats *nRF24_stats(void);
+
+  /**
+   * Pack the counters, little endian, behind nRF24_STATS_VERSION
+   *
+   * @param buf Where to store the snapshot
+   * @param size Room in @p buf
+   * @return nRF24_STATS_SNAPSHOT_LEN, or 0 if @p size is too small
+   */
+  uint8_t nRF24_stats_snapshot(uint8_t *buf, uint8_t size);
+
+  /**
+   * Print the counters on the serial port
+   */
+  void nRF24_stats_print(void);
+
+#else
+
+#define nRF24_STATS_INC(field) ((void)0)
+#define nRF24_STATS_ADD(field, n) ((void)0)
+#define nRF24_STATS_WAITED(since) ((void)(since))
+
+#endif /* defined (nRF24_STATS) */
+
+#endif /* nRF24_STATS_H */
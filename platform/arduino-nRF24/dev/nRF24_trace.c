@@ -0,0 +1,124 @@
+#include "nRF24_trace.h"
+
+#if defined (nRF24_TRACE)
+
+#include "nRF24_arch.h"
+#include "nRF24_slip.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if (nRF24_TRACE) & ((nRF24_TRACE) - 1) || (nRF24_TRACE) > 128
+#error nRF24_TRACE must be a power of two, at most 128
+#endif
+
+#define MASK ((nRF24_TRACE) - 1)
+#define MAGIC 'T'
+#define BURST 8                     /**< Records per frame */
+#define PERIOD (CLOCK_SECOND / 4)   /**< Drain check while nothing is traced */
+
+static uint8_t events[nRF24_TRACE];
+static uint16_t times[nRF24_TRACE];
+static volatile uint8_t head;       /**< Next record written */
+static volatile uint8_t tail;       /**< Next record sent */
+static volatile uint8_t dropped;    /**< Records lost since the last frame */
+static uint8_t sequence;
+
+PROCESS(nRF24_trace_process, "nRF24 trace");
+
+/****************************************************************************/
+
+void
+nRF24_trace_init(void)
+{
+  head = 0;
+  tail = 0;
+  dropped = 0;
+  sequence = 0;
+  process_start(&nRF24_trace_process, NULL);
+}
+
+/****************************************************************************/
+
+void
+nRF24_trace_record(uint8_t event)
+{
+  uint8_t sreg = SREG;
+  uint16_t now;
+
+  cli();
+  // Read first, the rest of the call is not part of the operation
+  now = TCNT1;
+  if((uint8_t)(head - tail) < nRF24_TRACE){
+    events[head & MASK] = event;
+    times[head & MASK] = now;
+    head++;
+  }else if(dropped < 0xff){
+    dropped++;
+  }
+  SREG = sreg;
+}
+
+/****************************************************************************/
+
+static bool
+pending(void)
+{
+  return head != tail || dropped != 0;
+}
+
+/****************************************************************************/
+
+/* Send up to BURST records. The ring is only read here, records written
+ * meanwhile wait for the next frame. */
+static void
+drain(void)
+{
+  uint8_t n = head - tail;
+  uint8_t lost, i;
+  uint8_t sreg = SREG;
+
+  if(n > BURST){
+    n = BURST;
+  }
+  cli();
+  lost = dropped;
+  dropped = 0;
+  SREG = sreg;
+
+  nRF24_slip_end();
+  nRF24_slip_put(MAGIC);
+  nRF24_slip_put(sequence++);
+  nRF24_slip_put(lost);
+  nRF24_slip_put(nRF24_TICK_US);
+  for(i = 0; i < n; i++){
+    nRF24_slip_put(events[(tail + i) & MASK]);
+    nRF24_slip_put(times[(tail + i) & MASK]);
+    nRF24_slip_put(times[(tail + i) & MASK] >> 8);
+  }
+  nRF24_slip_end();
+  tail += n;
+}
+
+/****************************************************************************/
+
+PROCESS_THREAD(nRF24_trace_process, ev, data)
+{
+  static struct etimer period;
+
+  PROCESS_BEGIN();
+
+  etimer_set(&period, PERIOD);
+  while(1) {
+    PROCESS_WAIT_EVENT();
+
+    if(ev == PROCESS_EVENT_TIMER){
+      etimer_reset(&period);
+    }
+    nRF24_slip_drain(&nRF24_trace_process, pending, drain);
+  }
+
+  PROCESS_END();
+}
+
+#endif /* defined (nRF24_TRACE) */
@@ -0,0 +1,78 @@
+/**
+ * \file
+ *         Trace points on the hot paths of the nRF24 driver
+ *
+ *         Enable with nRF24_TRACE in platform-conf.h. Each trace point stores
+ *         an event byte and the 16 bit Timer1 count (the rtimer, one tick is
+ *         nRF24_TICK_US) in a RAM ring. Most operations have a begin and an
+ *         end event, so the host can measure each one; the decoder in
+ *         tools/nrf24-trace turns the stream into latency histograms.
+ *
+ *         The ring is drained over USART_PORT by a process that only sends
+ *         when no other event is pending. Records are packed in SLIP framed
+ *         frames, so the decoder skips the text printed on the same port:
+ *
+ *           'T', sequence, records dropped, tick in us, then per record
+ *           the event byte and the Timer1 count, little endian
+ *
+ *         When the ring is full new records are dropped and counted, the
+ *         decoder then forgets the operations in flight. Operations longer
+ *         than a Timer1 wrap (2^16 ticks) are measured modulo the wrap.
+ *
+ *         With nRF24_TRACE undefined the trace points compile to nothing.
+ *         Only contiki.h is included, main() and avr-spi.h may include this.
+ */
+
+#ifndef nRF24_TRACE_H
+#define nRF24_TRACE_H
+
+#include "contiki.h"
+
+/**
+ * Traced operations. The event byte is the operation shifted left once,
+ * the low bit set on the end event. Mode events have no end, they mark the
+ * radio entering a rf24_power_e state. Keep tools/nrf24-trace in step.
+ */
+typedef enum {
+  RF24_TRACE_WRITE_PAYLOAD = 0, /**< W_TX_PAYLOAD and the data over SPI */
+  RF24_TRACE_READ_PAYLOAD,      /**< R_RX_PAYLOAD and the data over SPI */
+  RF24_TRACE_TX_WAIT,           /**< Polling STATUS for TX_DS or MAX_RT */
+  RF24_TRACE_FIFO_WAIT,         /**< Polling FIFO_STATUS for TX_EMPTY */
+  RF24_TRACE_SETTLE,            /**< A mode transition, started to done */
+  RF24_TRACE_IRQ_ISR,           /**< IRQ pin change interrupt */
+  RF24_TRACE_CAPTURE_ISR,       /**< Timer1 capture of the IRQ edge */
+  RF24_TRACE_SLOT_ISR,          /**< TDMA slot rtimer callback */
+  RF24_TRACE_MODE = 16          /**< Plus the rf24_power_e entered */
+} rf24_trace_e;
+
+#if defined (nRF24_TRACE)
+
+  /**
+   * Empty the ring and start the drain process
+   *
+   * Called by the driver init.
+   */
+  void nRF24_trace_init(void);
+
+  /**
+   * Store an event with the current Timer1 count
+   *
+   * Safe in interrupts. Use the macros below.
+   *
+   * @param event Operation shifted left, low bit set on its end
+   */
+  void nRF24_trace_record(uint8_t event);
+
+#define nRF24_TRACE_BEGIN(op) nRF24_trace_record((op) << 1)
+#define nRF24_TRACE_END(op) nRF24_trace_record(((op) << 1) | 1)
+#define nRF24_TRACE_MODE(state) nRF24_TRACE_BEGIN(RF24_TRACE_MODE + (state))
+
+#else
+
+#define nRF24_TRACE_BEGIN(op) ((void)0)
+#define nRF24_TRACE_END(op) ((void)0)
+#define nRF24_TRACE_MODE(state) ((void)0)
+
+#endif /* defined (nRF24_TRACE) */
+
+#endif /* nRF24_TRACE_H */
@@ -0,0 +1,264 @@
+#include "nRF24_aggr.h"
+
+#if defined (nRF24_AGGREGATION)
+
+#include "nRF24_esb.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/rime/rimeaddr.h"
+#include "sys/ctimer.h"
+#include <string.h>
+
+#define FRAME_MAX 32
+
+enum { BUF_FREE, BUF_FILLING, BUF_SENDING };
+
+struct message {
+  mac_callback_t sent;
+  void *ptr;
+};
+
+struct buffer {
+  uint8_t state;
+  rimeaddr_t dest;
+  clock_time_t opened;      /**< When the first message came in */
+  struct ctimer deadline;
+  uint8_t len;
+  uint8_t count;
+  struct message msgs[nRF24_AGGR_MESSAGES];
+  uint8_t data[nRF24_AGGR_SIZE];
+};
+
+static struct buffer bufs[nRF24_AGGR_BUFFERS];
+static unsigned long started;   /**< clock_seconds() at init */
+static struct nRF24_aggr_stats stats;
+/*---------------------------------------------------------------------------*/
+/* Radio time of one transmission of the frame in b */
+static uint16_t
+frame_us(const struct buffer *b)
+{
+  uint16_t us = nRF24_ESB_SETTLE_US +
+    nRF24_getAirtime(nRF24_LINK_HEADER_LEN + nRF24_AGGR_OVERHEAD + b->len);
+
+  if(!rimeaddr_cmp(&b->dest, &rimeaddr_null)) {
+    us += nRF24_getAckTime();
+  }
+  return us;
+}
+/*---------------------------------------------------------------------------*/
+static void
+frame_sent(void *ptr, int status, int num_tx)
+{
+  struct buffer *b = ptr;
+  struct message msgs[nRF24_AGGR_MESSAGES];
+  uint8_t count = b->count;
+  uint8_t i;
+
+  stats.frames++;
+  stats.messages += count;
+  stats.airtime_us += (uint32_t)num_tx * frame_us(b);
+
+  // The callbacks may send again, so the buffer is free from here on
+  memcpy(msgs, b->msgs, count * sizeof(struct message));
+  b->state = BUF_FREE;
+  for(i = 0; i < count; i++) {
+    mac_call_sent_callback(msgs[i].sent, msgs[i].ptr, status, num_tx);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+flush(struct buffer *b)
+{
+  ctimer_stop(&b->deadline);
+  b->state = BUF_SENDING;
+
+  packetbuf_clear();
+  packetbuf_copyfrom(b->data, b->len);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &b->dest);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &rimeaddr_node_addr);
+  NETSTACK_RDC.send(frame_sent, b);
+}
+/*---------------------------------------------------------------------------*/
+static void
+deadline(void *ptr)
+{
+  stats.deadline++;
+  flush(ptr);
+}
+/*---------------------------------------------------------------------------*/
+/* The buffer filling for dest, else a free one, else the oldest filling
+ * one is sent to make room. NULL if all wait for the RDC. */
+static struct buffer *
+get_buffer(const rimeaddr_t *dest)
+{
+  struct buffer *b = NULL;
+  struct buffer *oldest = NULL;
+  uint8_t i;
+
+  for(i = 0; i < nRF24_AGGR_BUFFERS; i++) {
+    if(bufs[i].state == BUF_FILLING && rimeaddr_cmp(&bufs[i].dest, dest)) {
+      return &bufs[i];
+    }
+  }
+  for(i = 0; i < nRF24_AGGR_BUFFERS; i++) {
+    if(bufs[i].state == BUF_FREE) {
+      b = &bufs[i];
+    } else if(bufs[i].state == BUF_FILLING &&
+              (oldest == NULL || CLOCK_LT(bufs[i].opened, oldest->opened))) {
+      oldest = &bufs[i];
+    }
+  }
+  if(b == NULL && oldest != NULL) {
+    flush(oldest);
+    // With a synchronous RDC it is free again already
+    if(oldest->state == BUF_FREE) {
+      b = oldest;
+    }
+  }
+  if(b != NULL) {
+    b->state = BUF_FILLING;
+    rimeaddr_copy(&b->dest, dest);
+    b->opened = clock_time();
+    b->len = 0;
+    b->count = 0;
+    ctimer_set(&b->deadline, nRF24_AGGR_LATENCY, deadline, b);
+  }
+  return b;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_packet(mac_callback_t sent, void *ptr)
+{
+  uint8_t msg[nRF24_AGGR_SIZE - 1];
+  uint8_t len;
+  rimeaddr_t dest;
+  struct buffer *b;
+
+  if(packetbuf_totlen() == 0 || packetbuf_totlen() > sizeof(msg)) {
+    stats.dropped++;
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 0);
+    return;
+  }
+  // Flushing reuses packetbuf, keep the message apart
+  len = packetbuf_copyto(msg);
+  rimeaddr_copy(&dest, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+
+  b = get_buffer(&dest);
+  if(b != NULL && b->len + 1 + len > nRF24_AGGR_SIZE) {
+    stats.full++;
+    flush(b);
+    b = get_buffer(&dest);
+  }
+  if(b == NULL) {
+    stats.dropped++;
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 0);
+    return;
+  }
+
+  b->data[b->len++] = len;
+  memcpy(&b->data[b->len], msg, len);
+  b->len += len;
+  b->msgs[b->count].sent = sent;
+  b->msgs[b->count].ptr = ptr;
+  b->count++;
+
+  // Nothing more fits, not even a one byte message
+  if(b->len + 2 > nRF24_AGGR_SIZE || b->count == nRF24_AGGR_MESSAGES) {
+    stats.full++;
+    flush(b);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+input_packet(void)
+{
+  uint8_t frame[FRAME_MAX];
+  rimeaddr_t sender, receiver;
+  packetbuf_attr_t link_quality = packetbuf_attr(PACKETBUF_ATTR_LINK_QUALITY);
+  packetbuf_attr_t timestamp = packetbuf_attr(PACKETBUF_ATTR_TIMESTAMP);
+  uint8_t len = rf24_min(packetbuf_datalen(), sizeof(frame));
+  uint8_t pos, n;
+
+  memcpy(frame, packetbuf_dataptr(), len);
+  rimeaddr_copy(&sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  rimeaddr_copy(&receiver, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+
+  for(pos = 0; pos < len && frame[pos] != 0; pos += 1 + n) {
+    n = frame[pos];
+    if(pos + 1 + n > len) {
+      break;
+    }
+    packetbuf_copyfrom(&frame[pos + 1], n);
+    packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &sender);
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &receiver);
+    packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, link_quality);
+    packetbuf_set_attr(PACKETBUF_ATTR_TIMESTAMP, timestamp);
+    stats.received++;
+    NETSTACK_NETWORK.input();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  uint8_t i;
+
+  for(i = 0; i < nRF24_AGGR_BUFFERS; i++) {
+    bufs[i].state = BUF_FREE;
+  }
+  memset(&stats, 0, sizeof(stats));
+  started = clock_seconds();
+}
+/*---------------------------------------------------------------------------*/
+static int
+on(void)
+{
+  return NETSTACK_RDC.on();
+}
+/*---------------------------------------------------------------------------*/
+static int
+off(int keep_radio_on)
+{
+  return NETSTACK_RDC.off(keep_radio_on);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+channel_check_interval(void)
+{
+  return NETSTACK_RDC.channel_check_interval();
+}
+/*---------------------------------------------------------------------------*/
+const struct mac_driver nRF24_aggr_driver = {
+  "nRF24 aggregation",
+  init,
+  send_packet,
+  input_packet,
+  on,
+  off,
+  channel_check_interval,
+};
+/*---------------------------------------------------------------------------*/
+const struct nRF24_aggr_stats *
+nRF24_aggr_stats(void)
+{
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+void
+nRF24_aggr_print_stats(void)
+{
+  unsigned long seconds = clock_seconds() - started;
+
+  printf_P(PSTR("aggr messages %lu frames %u full %u deadline %u dropped %u received %lu\n"),
+           (unsigned long)stats.messages, stats.frames, stats.full,
+           stats.deadline, stats.dropped, (unsigned long)stats.received);
+  printf_P(PSTR("aggr messages/s %lu.%lu messages/frame %lu.%lu airtime/message %lu us\n"),
+           seconds ? (unsigned long)(stats.messages / seconds) : 0UL,
+           seconds ? (unsigned long)(stats.messages * 10 / seconds % 10) : 0UL,
+           stats.frames ? (unsigned long)(stats.messages / stats.frames) : 0UL,
+           stats.frames ? (unsigned long)(stats.messages * 10 / stats.frames % 10) : 0UL,
+           stats.messages ? (unsigned long)(stats.airtime_us / stats.messages) : 0UL);
+}
+/*---------------------------------------------------------------------------*/
+
+#endif /* defined (nRF24_AGGREGATION) */
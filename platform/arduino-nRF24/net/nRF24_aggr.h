@@ -0,0 +1,96 @@
+/**
+ * \file
+ *         Aggregation of small messages into full nRF24 frames
+ *
+ *         A MAC driver between Rime and the RDC. Messages for the same
+ *         destination are packed into one frame, each behind a one byte
+ *         length, so they share the preamble, address, packet control
+ *         field, CRC, ACK turnaround and settle time of a single ESB
+ *         frame. A frame goes out once no further message fits, or
+ *         nRF24_AGGR_LATENCY after its first message. The receiver hands
+ *         each message to Rime on its own.
+ *
+ *         A zero length ends the messages of a frame, so the padding of
+ *         fixed size payloads needs no length field of its own.
+ *
+ *         Packetbuf attributes other than the addresses are not carried
+ *         over; Rime has put its own header in the message by then.
+ *
+ *         Enable with nRF24_AGGREGATION in platform-conf.h, which makes it
+ *         the MAC driver.
+ */
+
+#ifndef nRF24_AGGR_H
+#define nRF24_AGGR_H
+
+#include "net/mac/mac.h"
+#include "nRF24_driver.h"
+
+/**
+ * Bytes the framer and RDC add in front of the messages: the two
+ * addresses of framer_nullmac, plus the frame type of the TDMA RDC
+ */
+#ifndef nRF24_AGGR_OVERHEAD
+#if defined (nRF24_TDMA)
+#define nRF24_AGGR_OVERHEAD (2 * RIMEADDR_SIZE + 1)
+#else
+#define nRF24_AGGR_OVERHEAD (2 * RIMEADDR_SIZE)
+#endif
+#endif
+
+/**
+ * Room for messages and their lengths in one frame
+ */
+#ifndef nRF24_AGGR_SIZE
+#define nRF24_AGGR_SIZE (32 - nRF24_LINK_HEADER_LEN - nRF24_AGGR_OVERHEAD)
+#endif
+
+/**
+ * Longest a message waits for others, in clock ticks
+ */
+#ifndef nRF24_AGGR_LATENCY
+#define nRF24_AGGR_LATENCY (CLOCK_SECOND / 8)
+#endif
+
+/**
+ * Destinations that can be filled at once. A frame handed to the RDC
+ * keeps its buffer until the RDC reports back.
+ */
+#ifndef nRF24_AGGR_BUFFERS
+#define nRF24_AGGR_BUFFERS 2
+#endif
+
+/**
+ * Messages in one frame at most
+ */
+#ifndef nRF24_AGGR_MESSAGES
+#define nRF24_AGGR_MESSAGES 6
+#endif
+
+/**
+ * Aggregation statistics
+ */
+struct nRF24_aggr_stats {
+  uint32_t messages;        /**< Messages sent in a frame */
+  uint32_t received;        /**< Messages taken out of received frames */
+  uint32_t airtime_us;      /**< Radio time of the frames sent, retries, settle and ACK included */
+  uint16_t frames;          /**< Frames sent */
+  uint16_t full;            /**< Frames sent because the next message did not fit */
+  uint16_t deadline;        /**< Frames sent on nRF24_AGGR_LATENCY */
+  uint16_t dropped;         /**< Messages too long, or without a free buffer */
+};
+
+extern const struct mac_driver nRF24_aggr_driver;
+
+  /**
+   * Statistics since init
+   */
+  const struct nRF24_aggr_stats *nRF24_aggr_stats(void);
+
+  /**
+   * Print the statistics on the serial port, with the messages per second
+   * and per frame, and the radio time per message
+   */
+  void nRF24_aggr_print_stats(void);
+
+#endif /* nRF24_AGGR_H */
@@ -0,0 +1,615 @@
+#include "nRF24_tdma.h"
+
+#if defined (nRF24_TDMA)
+
+#if !defined (nRF24_TIMESTAMP)
+#error nRF24_TDMA needs nRF24_TIMESTAMP to follow the beacons
+#endif
+
+#include "nRF24_esb.h"
+#include "nRF24_power.h"
+#include "nRF24_trace.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/rime/rimeaddr.h"
+#include "lib/list.h"
+#include "lib/random.h"
+#include <string.h>
+
+#define FRAME_MAX 32
+#define SLOT_SHARED 1
+#define SLOT_FIRST_DATA 2
+#define DATA_SLOTS (nRF24_TDMA_SLOTS - SLOT_FIRST_DATA)
+
+enum {
+  FRAME_BEACON = 1,  /**< seq, then the owner of each data slot */
+  FRAME_JOIN,        /**< Address of the node asking for a slot */
+  FRAME_DATA,        /**< Framer header and payload */
+};
+
+enum { KIND_BEACON, KIND_JOIN, KIND_DATA };
+enum { PHASE_IDLE, PHASE_PREP, PHASE_START, PHASE_END, PHASE_DRAIN };
+
+struct frame {
+  mac_callback_t sent;
+  void *ptr;
+  rimeaddr_t dest;   /**< rimeaddr_null for a broadcast */
+  uint8_t len;
+  uint8_t data[FRAME_MAX];
+};
+
+static bool coordinator;
+static rimeaddr_t owners[DATA_SLOTS];
+
+/* Coordinator only */
+static uint8_t sf_seq;
+static uint32_t next_sf;          /**< Start of the next superframe */
+static uint8_t idle[DATA_SLOTS];  /**< Superframes a slot went unused */
+static bool busy[DATA_SLOTS];     /**< Data heard in the slot this superframe */
+
+static uint32_t sf_start;         /**< Start of the current superframe */
+static uint32_t slot_ticks, tx_ticks, prep_ticks;
+static uint32_t frame_ticks;      /**< Worst case radio time of one frame */
+static bool joining;
+static uint8_t unheard;           /**< Own slots in a row the coordinator may not have heard */
+
+/* Slot timer, the callbacks only drive CE and never touch SPI */
+static struct rtimer rt;
+static volatile uint8_t phase;
+static volatile bool slot_due;    /**< The FIFO is to be loaded for the next slot */
+static volatile bool slot_over;   /**< CE is low and the last frame is done */
+static uint32_t slot_start;
+static uint8_t slot_kind;
+
+/* The slot being run. The FIFO holds the beacon or join frame, if any,
+ * then the first inflight frames of the queue, all for tx_dest. */
+static uint8_t ctrl;
+static uint8_t inflight;
+static rimeaddr_t tx_dest;
+static bool heard;                /**< A broadcast left, the coordinator could hear it */
+
+static struct frame queue[nRF24_TDMA_QUEUE];
+static uint8_t queue_head, queued;
+
+static struct nRF24_tdma_stats stats;
+
+PROCESS(nRF24_tdma_process, "nRF24 TDMA");
+/*---------------------------------------------------------------------------*/
+static void
+slot_timer(struct rtimer *t, void *ptr)
+{
+  nRF24_TRACE_BEGIN(RF24_TRACE_SLOT_ISR);
+  switch(phase) {
+  case PHASE_PREP:
+    phase = PHASE_START;
+    slot_due = true;
+    slot_over = false;
+    rtimer_set(t, (rtimer_clock_t)slot_start, 1, slot_timer, NULL);
+    process_poll(&nRF24_tdma_process);
+    break;
+  case PHASE_START:
+    nRF24_txStart();
+    phase = PHASE_END;
+    rtimer_set(t, (rtimer_clock_t)(slot_start + tx_ticks), 1, slot_timer, NULL);
+    break;
+  case PHASE_END:
+    nRF24_txStop();
+    // The frame on air still ends
+    phase = PHASE_DRAIN;
+    rtimer_set(t, (rtimer_clock_t)(slot_start + tx_ticks + frame_ticks), 1,
+               slot_timer, NULL);
+    break;
+  case PHASE_DRAIN:
+    slot_over = true;
+    phase = PHASE_IDLE;
+    process_poll(&nRF24_tdma_process);
+    if(coordinator) {
+      next_sf += nRF24_TDMA_SLOTS * slot_ticks;
+      slot_start = next_sf;
+      slot_kind = KIND_BEACON;
+      phase = PHASE_PREP;
+      rtimer_set(t, (rtimer_clock_t)(next_sf - prep_ticks), 1, slot_timer, NULL);
+    }
+    break;
+  }
+  nRF24_TRACE_END(RF24_TRACE_SLOT_ISR);
+}
+/*---------------------------------------------------------------------------*/
+/* Called from process context on a node */
+static void
+schedule(uint32_t start, uint8_t kind)
+{
+  rtimer_clock_t prep = (rtimer_clock_t)(start - prep_ticks);
+
+  if(phase != PHASE_IDLE) {
+    return;
+  }
+  if(RTIMER_CLOCK_LT(prep, RTIMER_NOW() + 2)) {
+    // Too close to prepare, rtimer would wait for the counter to wrap
+    stats.late++;
+    return;
+  }
+  slot_start = start;
+  slot_kind = kind;
+  phase = PHASE_PREP;
+  rtimer_set(&rt, prep, 1, slot_timer, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+own_slot(void)
+{
+  uint8_t i;
+
+  for(i = 0; i < DATA_SLOTS; i++) {
+    if(rimeaddr_cmp(&owners[i], &rimeaddr_node_addr)) {
+      return SLOT_FIRST_DATA + i;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+aim(const rimeaddr_t *addr)
+{
+  rimeaddr_copy(&tx_dest, addr);
+  nRF24_setDestination(addr);
+}
+/*---------------------------------------------------------------------------*/
+/* Load queued frames after those in the TX FIFO. The frames of a FIFO
+ * share TX_ADDR, so one for another destination waits until it drained.
+ * Unicasts are acknowledged, broadcasts are not. */
+static void
+load_queue(void)
+{
+  struct frame *f;
+
+  if(slot_kind == KIND_JOIN) {
+    return;
+  }
+  while(inflight < queued && ctrl + inflight < nRF24_TDMA_FRAMES) {
+    f = &queue[(queue_head + inflight) % nRF24_TDMA_QUEUE];
+    if(ctrl + inflight == 0) {
+      aim(&f->dest);
+    } else if(!rimeaddr_cmp(&f->dest, &tx_dest)) {
+      break;
+    }
+    nRF24_startFastWrite(f->data, f->len, rimeaddr_cmp(&f->dest, &rimeaddr_null), 0);
+    inflight++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The frame at the head of the queue left the FIFO */
+static void
+finish(uint8_t status)
+{
+  struct frame *f = &queue[queue_head];
+  mac_callback_t sent = f->sent;
+  void *ptr = f->ptr;
+  bool broadcast = rimeaddr_cmp(&f->dest, &rimeaddr_null);
+
+  queue_head = (queue_head + 1) % nRF24_TDMA_QUEUE;
+  queued--;
+  inflight--;
+  if(broadcast) {
+    heard = true;
+  } else {
+    stats.frames_unicast++;
+  }
+  if(status == MAC_TX_OK) {
+    stats.frames_ok++;
+    nRF24_power_delivered();
+  } else {
+    stats.frames_noack++;
+  }
+  mac_call_sent_callback(sent, ptr, status, 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Account for the first n frames of the FIFO */
+static void
+retire(uint8_t n, uint8_t status)
+{
+  for(; n > 0; n--) {
+    if(ctrl) {
+      ctrl = 0;
+      heard = true;
+    } else if(inflight) {
+      finish(status);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Coordinator: close the superframe that ends and open the next one */
+static void
+load_beacon(void)
+{
+  uint8_t beacon[nRF24_LINK_HEADER_LEN + 2 + sizeof(owners)];
+  uint8_t *b = &beacon[nRF24_LINK_HEADER_LEN];
+  uint8_t i;
+
+  for(i = 0; i < DATA_SLOTS; i++) {
+    if(rimeaddr_cmp(&owners[i], &rimeaddr_null)) {
+      continue;
+    }
+    stats.data_slots++;
+    if(busy[i]) {
+      stats.busy_slots++;
+      idle[i] = 0;
+    } else if(++idle[i] >= nRF24_TDMA_IDLE_LIMIT) {
+      rimeaddr_copy(&owners[i], &rimeaddr_null);
+    }
+    busy[i] = false;
+  }
+  sf_start = next_sf;
+  stats.superframes++;
+
+  nRF24_linkHeader(beacon);
+  b[0] = FRAME_BEACON;
+  b[1] = sf_seq++;
+  memcpy(&b[2], owners, sizeof(owners));
+  nRF24_startFastWrite(beacon, sizeof(beacon), true, 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+load_join(void)
+{
+  uint8_t join[nRF24_LINK_HEADER_LEN + 1 + sizeof(rimeaddr_t)];
+  uint8_t *j = &join[nRF24_LINK_HEADER_LEN];
+
+  nRF24_linkHeader(join);
+  j[0] = FRAME_JOIN;
+  memcpy(&j[1], &rimeaddr_node_addr, sizeof(rimeaddr_t));
+  nRF24_startFastWrite(join, sizeof(join), true, 0);
+}
+/*---------------------------------------------------------------------------*/
+/* Load the FIFO ahead of the slot, false if it is too late for it */
+static bool
+slot_begin(void)
+{
+  if(!slot_due) {
+    // A TX IRQ that came after the slot
+    return false;
+  }
+  slot_due = false;
+  if(slot_over) {
+    stats.late++;
+    return false;
+  }
+  nRF24_stopListening();
+  nRF24_setTxProcess(&nRF24_tdma_process);
+  heard = false;
+  ctrl = 0;
+  inflight = 0;
+
+  if(slot_kind == KIND_BEACON) {
+    aim(&rimeaddr_null);
+    load_beacon();
+    ctrl = 1;
+  } else if(slot_kind == KIND_JOIN ||
+            unheard >= nRF24_TDMA_IDLE_LIMIT / 2) {
+    // In its own slot, a join tells the coordinator that the slot is used
+    // when the unicasts in it went to other nodes
+    aim(&rimeaddr_null);
+    load_join();
+    ctrl = 1;
+  }
+  load_queue();
+  if(slot_kind != KIND_JOIN) {
+    stats.slots++;
+  }
+  return true;
+}
+/*---------------------------------------------------------------------------*/
+/* Runs on each TX_DS or MAX_RT and once the slot is over, false when done.
+ * Frames are counted as they leave. An IRQ may come for several frames,
+ * the FIFO only tells when all of them left, so until then one is taken
+ * per TX_DS: a frame counted late is sent again, never lost. */
+static bool
+slot_step(void)
+{
+  bool tx_ok, tx_fail, rx_ready;
+
+  nRF24_whatHappened(&tx_ok, &tx_fail, &rx_ready);
+  if(tx_fail) {
+    // MAX_RT holds the failed unicast at the head of the FIFO, ahead of it
+    // left the beacon or join, or a frame if TX_DS says so
+    retire(ctrl ? ctrl : tx_ok, MAC_TX_OK);
+    retire(1, MAC_TX_NOACK);
+    // Drop the frames behind it and load them again
+    nRF24_flush_tx();
+    ctrl = 0;
+    inflight = 0;
+  } else if(nRF24_txFifoEmpty()) {
+    retire(ctrl + inflight, MAC_TX_OK);
+  } else if(tx_ok) {
+    retire(1, MAC_TX_OK);
+  }
+
+  if(!slot_over) {
+    if(phase == PHASE_START || phase == PHASE_END) {
+      load_queue();
+    }
+    return true;
+  }
+
+  // Whatever is left goes again in the next slot
+  stats.frames_deferred += inflight;
+  ctrl = 0;
+  inflight = 0;
+  nRF24_flush_tx();
+  nRF24_setTxProcess(NULL);
+  nRF24_startListening();
+  if(slot_kind == KIND_DATA) {
+    unheard = heard ? 0 : unheard + 1;
+  }
+  return false;
+}
+/*---------------------------------------------------------------------------*/
+static void
+beacon_input(uint32_t rx)
+{
+  const uint8_t *beacon = packetbuf_dataptr();
+  uint8_t slot;
+
+  if(coordinator || packetbuf_datalen() < 2 + sizeof(owners)) {
+    return;
+  }
+  // The beacon left at the start of slot 0, its stamp is the end of frame.
+  // read() has stripped the link header, which was on air too.
+  sf_start = rx - nRF24_US_TO_TICKS(nRF24_ESB_SETTLE_US +
+                                    nRF24_getAirtime(nRF24_LINK_HEADER_LEN +
+                                                     packetbuf_datalen()));
+  memcpy(owners, &beacon[2], sizeof(owners));
+  stats.superframes++;
+
+  slot = own_slot();
+  if(joining) {
+    joining = false;
+    if(slot == 0) {
+      stats.join_collisions++;
+    }
+  }
+  if(queued == 0) {
+    // Nothing to send, an unused slot is freed by the coordinator
+    return;
+  }
+  if(slot != 0) {
+    schedule(sf_start + slot * slot_ticks, KIND_DATA);
+  } else if(random_rand() & 1) {
+    // Half the nodes without a slot ask each time, to spread requests
+    joining = true;
+    stats.joins++;
+    schedule(sf_start + SLOT_SHARED * slot_ticks, KIND_JOIN);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+join_input(void)
+{
+  const uint8_t *join = packetbuf_dataptr();
+  rimeaddr_t node;
+  uint8_t i;
+
+  if(!coordinator || packetbuf_datalen() < 1 + sizeof(rimeaddr_t)) {
+    return;
+  }
+  memcpy(&node, &join[1], sizeof(rimeaddr_t));
+  for(i = 0; i < DATA_SLOTS; i++) {
+    if(rimeaddr_cmp(&owners[i], &node)) {
+      // The owner keeps its slot
+      busy[i] = true;
+      return;
+    }
+  }
+  for(i = 0; i < DATA_SLOTS; i++) {
+    if(rimeaddr_cmp(&owners[i], &rimeaddr_null)) {
+      rimeaddr_copy(&owners[i], &node);
+      idle[i] = 0;
+      busy[i] = false;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_packet(mac_callback_t sent, void *ptr)
+{
+  struct frame *f;
+
+  if(queued == nRF24_TDMA_QUEUE) {
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 0);
+    return;
+  }
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &rimeaddr_node_addr);
+  if(NETSTACK_FRAMER.create() < 0 ||
+     !packetbuf_hdralloc(nRF24_LINK_HEADER_LEN + 1) ||
+     packetbuf_totlen() > FRAME_MAX) {
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 0);
+    return;
+  }
+  // Retries reload the frame as is, so copies keep their sequence number
+  nRF24_linkHeader(packetbuf_hdrptr());
+  ((uint8_t *)packetbuf_hdrptr())[nRF24_LINK_HEADER_LEN] = FRAME_DATA;
+
+  f = &queue[(queue_head + queued) % nRF24_TDMA_QUEUE];
+  f->sent = sent;
+  f->ptr = ptr;
+  rimeaddr_copy(&f->dest, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  f->len = packetbuf_copyto(f->data);
+  queued++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
+{
+  while(buf_list != NULL) {
+    queuebuf_to_packetbuf(buf_list->buf);
+    send_packet(sent, ptr);
+    buf_list = list_item_next(buf_list);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+input_packet(void)
+{
+  uint8_t type = *(uint8_t *)packetbuf_dataptr();
+  uint32_t rx;
+  bool stamped = nRF24_getRxTime(&rx);
+  uint32_t slot;
+
+  switch(type) {
+  case FRAME_BEACON:
+    if(stamped) {
+      beacon_input(rx);
+    }
+    return;
+  case FRAME_JOIN:
+    join_input();
+    return;
+  case FRAME_DATA:
+    break;
+  default:
+    return;
+  }
+
+  if(coordinator && stamped) {
+    slot = (rx - sf_start) / slot_ticks;
+    if(slot >= SLOT_FIRST_DATA && slot < nRF24_TDMA_SLOTS) {
+      busy[slot - SLOT_FIRST_DATA] = true;
+    }
+  }
+
+  packetbuf_hdrreduce(1);
+  if(NETSTACK_FRAMER.parse() < 0) {
+    return;
+  }
+  if(!rimeaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &rimeaddr_node_addr) &&
+     !rimeaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &rimeaddr_null)) {
+    return;
+  }
+  NETSTACK_MAC.input();
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  uint16_t frame_us = nRF24_ESB_SETTLE_US + nRF24_getAirtime(FRAME_MAX) +
+    nRF24_getAckTime();
+
+  frame_ticks = nRF24_US_TO_TICKS(frame_us);
+  tx_ticks = nRF24_US_TO_TICKS((uint32_t)frame_us * nRF24_TDMA_FRAMES);
+  slot_ticks = tx_ticks + nRF24_US_TO_TICKS(nRF24_TDMA_GUARD_US);
+  prep_ticks = nRF24_US_TO_TICKS(nRF24_TDMA_PREP_US);
+
+  coordinator = false;
+  joining = false;
+  unheard = 0;
+  phase = PHASE_IDLE;
+  slot_due = false;
+  slot_over = true;
+  memset(owners, 0, sizeof(owners));
+  queue_head = 0;
+  queued = 0;
+  memset(&stats, 0, sizeof(stats));
+
+  process_start(&nRF24_tdma_process, NULL);
+  nRF24_startListening();
+}
+/*---------------------------------------------------------------------------*/
+static int
+on(void)
+{
+  nRF24_startListening();
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+off(int keep_radio_on)
+{
+  if(!keep_radio_on) {
+    nRF24_stopListening();
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+channel_check_interval(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+const struct rdc_driver nRF24_tdma_driver = {
+  "nRF24 TDMA",
+  init,
+  send_packet,
+  send_list,
+  input_packet,
+  on,
+  off,
+  channel_check_interval,
+};
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(nRF24_tdma_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+    if(slot_begin()) {
+      // Polled by the radio IRQ and at the end of the slot
+      do {
+        PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+      } while(slot_step());
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+nRF24_tdma_coordinator(void)
+{
+  uint8_t i;
+
+  coordinator = true;
+  sf_seq = 0;
+  for(i = 0; i < DATA_SLOTS; i++) {
+    idle[i] = 0;
+    busy[i] = false;
+  }
+  next_sf = nRF24_arch_now() + nRF24_TDMA_SLOTS * slot_ticks;
+  sf_start = next_sf;
+  slot_start = next_sf;
+  slot_kind = KIND_BEACON;
+  phase = PHASE_PREP;
+  rtimer_set(&rt, (rtimer_clock_t)(next_sf - prep_ticks), 1, slot_timer, NULL);
+}
+/*---------------------------------------------------------------------------*/
+const struct nRF24_tdma_stats *
+nRF24_tdma_stats(void)
+{
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+void
+nRF24_tdma_print_stats(void)
+{
+  uint16_t capacity = stats.slots * nRF24_TDMA_FRAMES;
+
+  printf_P(PSTR("tdma superframes %u slots %u late %u\n"),
+           stats.superframes, stats.slots, stats.late);
+  printf_P(PSTR("tdma frames ok %u noack %u/%u unicast deferred %u joins %u/%u\n"),
+           stats.frames_ok, stats.frames_noack, stats.frames_unicast,
+           stats.frames_deferred, stats.joins - stats.join_collisions, stats.joins);
+  // Unacknowledged unicasts in an owned slot, and slot requests that
+  // collided in the shared one
+  printf_P(PSTR("tdma collisions data %u%% join %u%%\n"),
+           stats.frames_unicast ? (unsigned)((uint32_t)stats.frames_noack * 100 / stats.frames_unicast) : 0,
+           stats.joins ? (unsigned)((uint32_t)stats.join_collisions * 100 / stats.joins) : 0);
+  printf_P(PSTR("tdma own slot use %u%% data slots busy %u%%\n"),
+           capacity ? (unsigned)((uint32_t)stats.frames_ok * 100 / capacity) : 0,
+           stats.data_slots ? (unsigned)((uint32_t)stats.busy_slots * 100 / stats.data_slots) : 0);
+}
+/*---------------------------------------------------------------------------*/
+
+#endif /* defined (nRF24_TDMA) */
@@ -0,0 +1,121 @@
+/**
+ * \file
+ *         TDMA radio duty cycling for the nRF24
+ *
+ *         A coordinator beacons a superframe of nRF24_TDMA_SLOTS slots:
+ *         - slot 0 carries the beacon, followed by the coordinator's data;
+ *         - slot 1 is shared, nodes without a slot ask for one there;
+ *         - the other slots each belong to one node, as listed in the beacon.
+ *
+ *         Ahead of its slot a node loads up to nRF24_TDMA_FRAMES frames into
+ *         the TX FIFO (startFastWrite() with startTx = 0), and an rtimer
+ *         raises CE right at the slot boundary, so frames leave back to back
+ *         without contention. Unicasts are acknowledged and a MAX_RT, which
+ *         in an owned slot means interference or a collision, reports
+ *         MAC_TX_NOACK. Beacons, joins and broadcasts go unacknowledged. The
+ *         FIFO is refilled on the TX IRQ while the slot lasts. Slots are sized from the ESB air time of a
+ *         full payload at the configured rate. A slot unused for
+ *         nRF24_TDMA_IDLE_LIMIT superframes goes back to the pool.
+ *
+ *         The coordinator only hears broadcasts and frames for itself, so a
+ *         node that keeps its slot busy with unicasts to others leads with a
+ *         join every nRF24_TDMA_IDLE_LIMIT / 2 slots to keep it.
+ *
+ *         Nodes follow the superframe from the beacon RX timestamp, so this
+ *         needs nRF24_TIMESTAMP, which also wires the IRQ line. Slot timing is computed at init, changing
+ *         the data rate or payload size afterwards (e.g. link adaptation
+ *         with nRF24_LINK_ADAPTATION_RATE) breaks it.
+ *
+ *         Enable with nRF24_TDMA in platform-conf.h, which makes it the RDC
+ *         driver, and bring the stack up with netstack_init(). Call
+ *         nRF24_tdma_coordinator() on one node.
+ */
+
+#ifndef nRF24_TDMA_H
+#define nRF24_TDMA_H
+
+#include "net/mac/rdc.h"
+#include "nRF24_arch.h"
+
+/**
+ * Slots per superframe, beacon and shared slot included. The superframe
+ * must stay under half the rtimer wrap (131ms at 16MHz).
+ */
+#ifndef nRF24_TDMA_SLOTS
+#define nRF24_TDMA_SLOTS 8
+#endif
+
+/**
+ * Frames a slot is sized for, and loaded into the TX FIFO at once: at most
+ * its depth of 3
+ */
+#ifndef nRF24_TDMA_FRAMES
+#define nRF24_TDMA_FRAMES 3
+#endif
+
+/**
+ * Idle time closing each slot, in microseconds. Covers rtimer latency,
+ * clock drift, a frame still in flight and the preparation of the next
+ * slot owner, so it must not be shorter than nRF24_TDMA_PREP_US.
+ */
+#ifndef nRF24_TDMA_GUARD_US
+#define nRF24_TDMA_GUARD_US 600
+#endif
+
+/**
+ * How long before its slot a node stops listening to load the FIFO
+ */
+#ifndef nRF24_TDMA_PREP_US
+#define nRF24_TDMA_PREP_US 500
+#endif
+
+/**
+ * Superframes a slot may stay unused before the coordinator frees it
+ */
+#ifndef nRF24_TDMA_IDLE_LIMIT
+#define nRF24_TDMA_IDLE_LIMIT 8
+#endif
+
+/**
+ * Frames waiting for the next slot
+ */
+#ifndef nRF24_TDMA_QUEUE
+#define nRF24_TDMA_QUEUE 3
+#endif
+
+/**
+ * TDMA statistics
+ */
+struct nRF24_tdma_stats {
+  uint16_t superframes;     /**< Superframes run, or beacons heard */
+  uint16_t slots;           /**< Own slots used */
+  uint16_t late;            /**< Own slots missed, the FIFO was not loaded in time */
+  uint16_t frames_ok;       /**< Broadcasts sent and unicasts acknowledged */
+  uint16_t frames_unicast;  /**< Unicasts sent, acknowledged or not */
+  uint16_t frames_noack;    /**< Unicasts that ended with MAX_RT */
+  uint16_t frames_deferred; /**< Frames left for the next slot */
+  uint16_t joins;           /**< Slot requests sent */
+  uint16_t join_collisions; /**< Slot requests the next beacon did not grant */
+  uint16_t data_slots;      /**< Coordinator: assigned slots seen */
+  uint16_t busy_slots;      /**< Coordinator: assigned slots that carried data */
+};
+
+extern const struct rdc_driver nRF24_tdma_driver;
+
+  /**
+   * Make this node the coordinator and start beaconing
+   */
+  void nRF24_tdma_coordinator(void);
+
+  /**
+   * Statistics since init
+   */
+  const struct nRF24_tdma_stats *nRF24_tdma_stats(void);
+
+  /**
+   * Print the statistics on the serial port, with the collision rates of
+   * data frames and slot requests and the slot utilization derived from them
+   */
+  void nRF24_tdma_print_stats(void);
+
+#endif /* nRF24_TDMA_H */
@@ -0,0 +1,325 @@
+#include "nRF24_timesync.h"
+
+#if defined (nRF24_TIMESTAMP)
+
+#include "net/rime.h"
+#include "lib/random.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PENDING 3  /**< Neighbors whose last beacon we can pair */
+#define OUTLIERS_MAX 3
+#define THROWOUT nRF24_US_TO_TICKS(nRF24_TIMESYNC_THROWOUT_US)
+
+struct beacon {
+  rimeaddr_t root;      /**< Root the sender follows */
+  uint8_t root_seq;     /**< Round of the root this beacon belongs to */
+  uint8_t seq;          /**< Beacon number of the sender */
+  uint8_t has_prev;     /**< Whether prev_global is set */
+  uint32_t prev_global; /**< Global time beacon seq - 1 ended on air */
+};
+
+struct entry {
+  uint32_t local;  /**< Local time the beacon ended on air */
+  int32_t offset;  /**< Global minus local time at that instant */
+};
+
+struct pending {
+  rimeaddr_t from;
+  uint8_t seq;
+  uint32_t rx;
+};
+
+static struct broadcast_conn bc;
+
+static rimeaddr_t root;
+static uint8_t root_seq;     /**< Last round taken a sample from */
+static uint8_t heartbeats;   /**< Periods since the last new round */
+static uint8_t outliers;     /**< Outliers in a row */
+
+static struct entry table[nRF24_TIMESYNC_ENTRIES];
+static uint8_t entries, next_entry;
+static uint32_t ref_local;   /**< Regression point, local time */
+static int32_t ref_offset;   /**< Regression point, offset */
+static float skew;           /**< Offset change per local tick */
+
+static struct pending pending[PENDING];
+static uint8_t next_pending;
+
+static uint8_t seq;          /**< Number of our next beacon */
+static uint32_t last_tx;     /**< Local time our last beacon ended on air */
+static bool last_tx_valid;
+
+static struct nRF24_timesync_stats stats;
+
+PROCESS(nRF24_timesync_process, "nRF24 timesync");
+/*---------------------------------------------------------------------------*/
+static bool
+is_root(void)
+{
+  return rimeaddr_cmp(&root, &rimeaddr_node_addr);
+}
+/*---------------------------------------------------------------------------*/
+static void
+clear_table(void)
+{
+  entries = 0;
+  next_entry = 0;
+  outliers = 0;
+  skew = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Least squares fit of offset over local time, as FTSP does it: the means
+ * are taken relative to the first entry to keep the sums in range. */
+static void
+regress(void)
+{
+  int32_t local_sum = 0;
+  int32_t offset_sum = 0;
+  float xy = 0;
+  float xx = 0;
+  uint8_t i;
+
+  for(i = 0; i < entries; i++) {
+    local_sum += (int32_t)(table[i].local - table[0].local) / entries;
+    offset_sum += (table[i].offset - table[0].offset) / entries;
+  }
+  ref_local = table[0].local + local_sum;
+  ref_offset = table[0].offset + offset_sum;
+
+  for(i = 0; i < entries; i++) {
+    int32_t x = table[i].local - ref_local;
+    int32_t y = table[i].offset - ref_offset;
+    xy += (float)x * y;
+    xx += (float)x * x;
+  }
+  skew = xx > 0 ? xy / xx : 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_sample(uint32_t local, uint32_t global)
+{
+  int32_t error;
+  uint32_t abs_error;
+
+  if(nRF24_timesync_synced()) {
+    error = nRF24_timesync_global(local) - global;
+    abs_error = labs(error);
+    if(abs_error > THROWOUT) {
+      stats.outliers++;
+      if(++outliers >= OUTLIERS_MAX) {
+        // Our model went wrong, e.g. the root changed its clock
+        clear_table();
+      }
+      return;
+    }
+    outliers = 0;
+    stats.samples++;
+    stats.last_us = error * (int32_t)nRF24_TICK_US;
+    stats.abs_sum_us += abs_error * nRF24_TICK_US;
+    if(abs_error * nRF24_TICK_US > stats.max_us) {
+      stats.max_us = abs_error * nRF24_TICK_US;
+    }
+  }
+
+  table[next_entry].local = local;
+  table[next_entry].offset = global - local;
+  next_entry = (next_entry + 1) % nRF24_TIMESYNC_ENTRIES;
+  if(entries < nRF24_TIMESYNC_ENTRIES) {
+    entries++;
+  }
+  regress();
+}
+/*---------------------------------------------------------------------------*/
+/* Remember when a sender's beacon arrived. Returns true, with the arrival
+ * of the previous one in prev_rx, if we have the beacon right before. */
+static bool
+pair(const rimeaddr_t *from, uint8_t beacon_seq, uint32_t rx, bool rx_valid,
+     uint32_t *prev_rx)
+{
+  struct pending *p = NULL;
+  bool paired = false;
+  uint8_t i;
+
+  for(i = 0; i < PENDING; i++) {
+    if(rimeaddr_cmp(&pending[i].from, from)) {
+      p = &pending[i];
+      break;
+    }
+  }
+  if(p != NULL) {
+    paired = p->seq == (uint8_t)(beacon_seq - 1);
+    *prev_rx = p->rx;
+  } else {
+    p = &pending[next_pending];
+    next_pending = (next_pending + 1) % PENDING;
+    rimeaddr_copy(&p->from, from);
+  }
+
+  if(rx_valid) {
+    p->seq = beacon_seq;
+    p->rx = rx;
+  } else {
+    // A beacon without a stamp breaks the chain
+    p->seq = beacon_seq - 1;
+  }
+  return paired;
+}
+/*---------------------------------------------------------------------------*/
+static void
+recv(struct broadcast_conn *c, const rimeaddr_t *from)
+{
+  struct beacon b;
+  uint32_t rx, prev_rx;
+  bool rx_valid;
+  int cmp;
+
+  if(packetbuf_datalen() != sizeof(b)) {
+    return;
+  }
+  memcpy(&b, packetbuf_dataptr(), sizeof(b));
+  rx_valid = nRF24_getRxTime(&rx);
+  rx -= nRF24_TIMESYNC_RX_DELAY;
+
+  cmp = memcmp(&b.root, &root, sizeof(rimeaddr_t));
+  if(cmp > 0 || (cmp == 0 && is_root())) {
+    return;
+  }
+  if(cmp < 0) {
+    // A lower root wins, its clock is a different timescale
+    rimeaddr_copy(&root, &b.root);
+    root_seq = b.root_seq - 1;
+    clear_table();
+  }
+
+  if(pair(from, b.seq, rx, rx_valid, &prev_rx) && b.has_prev &&
+     (int8_t)(b.root_seq - root_seq) > 0) {
+    root_seq = b.root_seq;
+    heartbeats = 0;
+    add_sample(prev_rx, b.prev_global);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+sent(struct broadcast_conn *c, int status, int num_tx)
+{
+  // The driver only has a stamp for a frame that went out
+  last_tx_valid = nRF24_getTxTime(&last_tx);
+}
+/*---------------------------------------------------------------------------*/
+static const struct broadcast_callbacks broadcast_call = {recv, sent};
+/*---------------------------------------------------------------------------*/
+static void
+send_beacon(void)
+{
+  struct beacon b;
+
+  rimeaddr_copy(&b.root, &root);
+  b.root_seq = root_seq;
+  b.seq = seq;
+  b.has_prev = last_tx_valid;
+  b.prev_global = nRF24_timesync_global(last_tx);
+
+  // Until sent() says otherwise the previous beacon is unknown
+  last_tx_valid = false;
+  seq++;
+
+  packetbuf_copyfrom(&b, sizeof(b));
+  broadcast_send(&bc);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(nRF24_timesync_process, ev, data)
+{
+  static struct etimer et;
+
+  PROCESS_EXITHANDLER(broadcast_close(&bc));
+
+  PROCESS_BEGIN();
+
+  broadcast_open(&bc, nRF24_TIMESYNC_CHANNEL, &broadcast_call);
+
+  while(1) {
+    // Some jitter keeps neighbors from beaconing in step
+    etimer_set(&et, nRF24_TIMESYNC_PERIOD - nRF24_TIMESYNC_PERIOD / 8 +
+               random_rand() % (nRF24_TIMESYNC_PERIOD / 4));
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+    if(!is_root() && ++heartbeats >= nRF24_TIMESYNC_ROOT_TIMEOUT) {
+      // No root heard for a while, our clock becomes the global time
+      rimeaddr_copy(&root, &rimeaddr_node_addr);
+      clear_table();
+    }
+
+    if(is_root()) {
+      root_seq++;
+      send_beacon();
+    } else if(nRF24_timesync_synced()) {
+      send_beacon();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+nRF24_timesync_init(void)
+{
+  // No root yet: every address is lower than this one
+  memset(&root, 0xff, sizeof(root));
+  root_seq = 0;
+  heartbeats = 0;
+  clear_table();
+  memset(pending, 0xff, sizeof(pending));
+  next_pending = 0;
+  seq = 0;
+  last_tx_valid = false;
+  memset(&stats, 0, sizeof(stats));
+
+  process_start(&nRF24_timesync_process, NULL);
+}
+/*---------------------------------------------------------------------------*/
+bool
+nRF24_timesync_synced(void)
+{
+  return is_root() || entries >= nRF24_TIMESYNC_MIN_ENTRIES;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+nRF24_timesync_global(uint32_t local)
+{
+  int32_t x;
+
+  if(is_root() || entries == 0) {
+    return local;
+  }
+  x = local - ref_local;
+  return local + ref_offset + (int32_t)(skew * x);
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+nRF24_timesync_now(void)
+{
+  return nRF24_timesync_global(nRF24_arch_now());
+}
+/*---------------------------------------------------------------------------*/
+const struct nRF24_timesync_stats *
+nRF24_timesync_stats(void)
+{
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+void
+nRF24_timesync_print_stats(void)
+{
+  printf_P(PSTR("timesync root %d.%d synced %d samples %u outliers %u\n"),
+           root.u8[0], root.u8[1], nRF24_timesync_synced(),
+           stats.samples, stats.outliers);
+  printf_P(PSTR("error us last %ld mean %lu max %lu\n"),
+           (long)stats.last_us,
+           stats.samples ? (unsigned long)(stats.abs_sum_us / stats.samples) : 0UL,
+           (unsigned long)stats.max_us);
+}
+/*---------------------------------------------------------------------------*/
+
+#endif /* defined (nRF24_TIMESTAMP) */
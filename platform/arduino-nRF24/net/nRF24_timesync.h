@@ -0,0 +1,131 @@
+/**
+ * \file
+ *         Network time synchronization over the nRF24 timestamps
+ *
+ *         FTSP style flooding: the node with the lowest Rime address is the
+ *         root and its clock is the global time. Synchronized nodes
+ *         broadcast a beacon every nRF24_TIMESYNC_PERIOD, and receivers fit
+ *         a line through the last nRF24_TIMESYNC_ENTRIES (local time,
+ *         offset) pairs, following both the offset and the skew of their
+ *         clock to the root.
+ *
+ *         A frame can't carry the time it is sent at, so beacons work in two
+ *         steps: each one carries the global time at which the previous
+ *         beacon of the same sender ended on air, taken from its TX_DS
+ *         capture, and receivers pair it with the RX_DR capture they kept
+ *         for that beacon. Both stamps mark the end of the frame, so the
+ *         ESB air time cancels out; the driver already takes the ACK
+ *         turnaround off acknowledged frames.
+ *
+ *         Needs nRF24_TIMESTAMP. Times are in rtimer ticks on the 32 bit
+ *         timebase of nRF24_arch_now().
+ */
+
+#ifndef nRF24_TIMESYNC_H
+#define nRF24_TIMESYNC_H
+
+#include "contiki.h"
+#include "nRF24_arch.h"
+
+/**
+ * Rime channel used by the beacons
+ */
+#ifndef nRF24_TIMESYNC_CHANNEL
+#define nRF24_TIMESYNC_CHANNEL 140
+#endif
+
+/**
+ * Time between beacons
+ */
+#ifndef nRF24_TIMESYNC_PERIOD
+#define nRF24_TIMESYNC_PERIOD (10 * CLOCK_SECOND)
+#endif
+
+/**
+ * Samples kept for the regression
+ */
+#ifndef nRF24_TIMESYNC_ENTRIES
+#define nRF24_TIMESYNC_ENTRIES 8
+#endif
+
+/**
+ * Samples needed before a node counts as synchronized and forwards
+ */
+#ifndef nRF24_TIMESYNC_MIN_ENTRIES
+#define nRF24_TIMESYNC_MIN_ENTRIES 3
+#endif
+
+/**
+ * Periods without a new round from the root before a node takes over
+ */
+#ifndef nRF24_TIMESYNC_ROOT_TIMEOUT
+#define nRF24_TIMESYNC_ROOT_TIMEOUT 5
+#endif
+
+/**
+ * Largest error, in microseconds, before a sample is taken for an outlier.
+ * Several outliers in a row clear the table.
+ */
+#ifndef nRF24_TIMESYNC_THROWOUT_US
+#define nRF24_TIMESYNC_THROWOUT_US 1000
+#endif
+
+/**
+ * Fixed delay from the end of a frame to RX_DR minus the one to TX_DS,
+ * in rtimer ticks. Taken off received stamps.
+ */
+#ifndef nRF24_TIMESYNC_RX_DELAY
+#define nRF24_TIMESYNC_RX_DELAY 0
+#endif
+
+/**
+ * Synchronization error statistics
+ *
+ * The error of a sample is the global time we predicted for a beacon,
+ * before learning from it, minus the global time its sender reported.
+ * Only samples taken while synchronized are counted.
+ */
+struct nRF24_timesync_stats {
+  uint16_t samples;    /**< Samples counted */
+  uint16_t outliers;   /**< Samples dropped for an error above the throwout */
+  int32_t last_us;     /**< Error of the last sample */
+  uint32_t abs_sum_us; /**< Sum of the absolute errors */
+  uint32_t max_us;     /**< Largest absolute error */
+};
+
+  /**
+   * Open the beacon channel and start synchronizing
+   */
+  void nRF24_timesync_init(void);
+
+  /**
+   * Whether the global time is known
+   *
+   * @return True on the root and on nodes with enough samples
+   */
+  bool nRF24_timesync_synced(void);
+
+  /**
+   * Convert a local time to global time
+   *
+   * @param local Time from nRF24_arch_now() or a driver timestamp
+   * @return The matching global time, or @p local if not synchronized
+   */
+  uint32_t nRF24_timesync_global(uint32_t local);
+
+  /**
+   * Current global time
+   */
+  uint32_t nRF24_timesync_now(void);
+
+  /**
+   * Error statistics since init
+   */
+  const struct nRF24_timesync_stats *nRF24_timesync_stats(void);
+
+  /**
+   * Print the error statistics on the serial port
+   */
+  void nRF24_timesync_print_stats(void);
+
+#endif /* nRF24_TIMESYNC_H */
@@ -176,8 +176,27 @@
 #define nRF24_PAYLOAD             32
 #define nRF24_AUTO_PAYLOAD_SIZE   0 //0 to false, 1 to true
 #define nRF24_ADRESS_SIZE         5 //3-5 bytes selectable 
+//#define nRF24_FIXED_CONFIG        1 //The three above never change: read as constants, their setters not built
 //#define FAILURE_HANDLING          1
-//#define SERIAL_DEBUG_NRF24
+//#define SERIAL_DEBUG_NRF24          //Driver debug log, same as nRF24_LOG 64
+//#define nRF24_LINK_ADAPTATION     1 //Per-destination data rate, PA level and retries
+//#define nRF24_LINK_ESTIMATE       1 //ETX per neighbor, received frames carry the ETX towards their sender (needs nRF24_DUP_CACHE)
+//#define nRF24_TIMESTAMP           1 //IRQ wired to pin 8 (ICP1), frames get Timer1 timestamps
+//#define nRF24_TDMA                1 //TDMA RDC driver, needs nRF24_TIMESTAMP
+//#define nRF24_NEIGHBORS           8 //Neighbors remembered by the driver
+//#define nRF24_ACK_PAYLOAD_SIZE    32 //Largest ACK payload expected, sizes the retry delay
+//#define nRF24_ACK_PAYLOAD_TTL     20000UL //Microseconds an ACK payload waits before it is flushed
+//#define nRF24_STATS               1 //Driver counters, "nrf24 stats" on the serial line prints them
+//#define nRF24_TRACE               64 //Records in the trace ring, hot path timings sent over the serial port
+//#define nRF24_LOG                 64 //Bytes in the debug log ring, drained to the serial port when idle
+//#define nRF24_DUP_CACHE           4 //Sequence numbered frames, senders remembered to drop duplicates
+//#define nRF24_AGGREGATION         1 //MAC driver packing small messages into full frames
+//#define nRF24_POWER_IDLE          (CLOCK_SECOND / 10) //Idle time in Standby-I before the radio powers down
+//#define nRF24_SLEEP               1 //MCU sleeps when idle, woken by the IRQ on pin 8 (PB0)
+//#define nRF24_SLEEP_32K           1 //32.768kHz crystal on TOSC for Timer2, allows power-save
+//#define nRF24_SNIFFER             4 //Frames per capture bank, "nrf24 sniff <channel>" streams raw frames to the serial port
+//#define nRF24_RADIOS              2 //Radios on the SPI bus, nRF24_driver_1 drives the second
+//#define nRF24_RADIO_PINS          { { 9, 10, 2 }, { 7, 6, 3 } } //CE, CSN and IRQ pin per radio, nRF24_NO_PIN without IRQ
 
 
 #endif /* __PLATFORM_CONF_H__ */
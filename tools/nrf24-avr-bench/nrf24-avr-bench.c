@@ -0,0 +1,386 @@
+/* Cycle counts of the driver on a simulated ATmega328p, see README.md.
+ *
+ * simavr runs the examples/nRF24-cycles image. Its SPI bus and the CE and
+ * CSN pins go to an emulated nRF24L01+ of tools/nrf24-emu, a second one is
+ * the peer, and the medium follows the AVR's cycle counter. Writes to
+ * GPIOR0 mark where an operation starts and ends. */
+
+#include "contiki.h"
+#include "nRF24_driver.h"
+#include "nRF24L01.h"
+#include "nrf24-emu.h"
+#include "nRF24-cycles.h"
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_irq.h"
+#include "sim_cycle_timers.h"
+#include "avr_ioport.h"
+#include "avr_spi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define GPIOR0_ADDR 0x3e        /* Data space addresses */
+#define GPIOR1_ADDR 0x4a
+#define CE_PIN 1                /* PB1, Arduino pin 9 */
+#define CSN_PIN 2               /* PB2, Arduino pin 10 */
+#define IRQ_PIN 0               /* PB0, Arduino pin 8 */
+#define TICK_US 10              /* The peer and the IRQ pin are looked at this often */
+#define TIMEOUT_S 20            /* Simulated */
+#define PAYLOAD 32
+#define BASELINE_MAX 256
+
+static const char *names[CYCLES_OPS] = {
+  [CYCLES_MARKER] = "marker",
+  [CYCLES_DIGITAL_WRITE] = "digitalWrite",
+  [CYCLES_SPI_BYTE] = "spi_write_byte",
+  [CYCLES_STOP_LISTENING] = "stopListening",
+  [CYCLES_START_LISTENING] = "startListening",
+  [CYCLES_SEND_UNICAST] = "send_unicast",
+  [CYCLES_SEND_BROADCAST] = "send_broadcast",
+  [CYCLES_READ] = "read_contiki",
+};
+
+struct result {
+  unsigned runs;
+  avr_cycle_count_t min, max, sum;
+};
+
+static avr_t *avr;
+static struct nrf24_emu_air air;
+static struct nrf24_emu dut, peer;
+static avr_irq_t *spi_in, *irq_pin;
+static uint8_t peer_sending;
+static uint8_t op;
+static avr_cycle_count_t op_start;
+static struct result results[CYCLES_OPS];
+static int done;
+
+/*---------------------------------------------------------------------------*/
+/* The medium catches up with the AVR */
+static void
+follow(void)
+{
+  nrf24_emu_air_run(&air, avr->cycle * 1000000ULL / avr->frequency);
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_address(struct nrf24_emu *r, uint8_t reg, uint8_t node)
+{
+  static const uint8_t net[] = nRF24_NET_ADDRESS;
+  uint8_t address[5];
+
+  address[0] = node;
+  memcpy(&address[1], net, 4);
+  nrf24_emu_command(r, W_REGISTER | reg, address, NULL, 5);
+}
+/*---------------------------------------------------------------------------*/
+/* The peer as the driver sets itself up, listening */
+static void
+peer_listen(void)
+{
+  nrf24_emu_write_register(&peer, CONFIG, _BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP) | _BV(PRIM_RX));
+  nrf24_emu_ce(&peer, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+peer_setup(void)
+{
+  nrf24_emu_write_register(&peer, RF_SETUP, 0x06);          // 1Mbps
+  nrf24_emu_write_register(&peer, RF_CH, 76);
+  nrf24_emu_write_register(&peer, SETUP_RETR, 0x2f);
+  write_address(&peer, RX_ADDR_P1, nRF24_BROADCAST_NODE);
+  nrf24_emu_write_register(&peer, RX_ADDR_P2, CYCLES_PEER);
+  nrf24_emu_write_register(&peer, RX_PW_P0, PAYLOAD);
+  nrf24_emu_write_register(&peer, RX_PW_P1, PAYLOAD);
+  nrf24_emu_write_register(&peer, RX_PW_P2, PAYLOAD);
+  nrf24_emu_write_register(&peer, EN_RXADDR, _BV(ERX_P0) | _BV(ERX_P1) | _BV(ERX_P2));
+  peer_listen();
+}
+/*---------------------------------------------------------------------------*/
+static void
+peer_send(void)
+{
+  uint8_t data[PAYLOAD] = { 0 };
+
+  nrf24_emu_ce(&peer, 0);
+  nrf24_emu_write_register(&peer, CONFIG, _BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP));
+  write_address(&peer, TX_ADDR, CYCLES_NODE);
+  write_address(&peer, RX_ADDR_P0, CYCLES_NODE);
+  nrf24_emu_command(&peer, W_TX_PAYLOAD, data, NULL, PAYLOAD);
+  nrf24_emu_ce(&peer, 1);
+  peer_sending = 1;
+}
+/*---------------------------------------------------------------------------*/
+/* What the peer does between the AVR's steps: finish a frame it sends, and
+ * drop what it received */
+static void
+peer_poll(void)
+{
+  uint8_t status = nrf24_emu_command(&peer, NOP, NULL, NULL, 0);
+
+  if(peer_sending && (status & (_BV(TX_DS) | _BV(MAX_RT)))) {
+    nrf24_emu_ce(&peer, 0);
+    nrf24_emu_command(&peer, FLUSH_TX, NULL, NULL, 0);
+    peer_sending = 0;
+    peer_listen();
+  }
+  if(status & _BV(RX_DR)) {
+    nrf24_emu_command(&peer, FLUSH_RX, NULL, NULL, 0);
+  }
+  nrf24_emu_write_register(&peer, STATUS, _BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT));
+}
+/*---------------------------------------------------------------------------*/
+static avr_cycle_count_t
+tick(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+  follow();
+  peer_poll();
+  avr_raise_irq(irq_pin, nrf24_emu_irq(&dut));
+  return when + avr_usec_to_cycles(avr, TICK_US);
+}
+/*---------------------------------------------------------------------------*/
+static void
+spi_out(avr_irq_t *irq, uint32_t value, void *param)
+{
+  follow();
+  avr_raise_irq(spi_in, nrf24_emu_spi(&dut, value));
+}
+/*---------------------------------------------------------------------------*/
+static void
+pin_changed(avr_irq_t *irq, uint32_t value, void *param)
+{
+  follow();
+  if((intptr_t)param == CE_PIN) {
+    nrf24_emu_ce(&dut, value);
+  } else {
+    nrf24_emu_csn(&dut, value);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+marker(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+  struct result *r;
+  avr_cycle_count_t cycles;
+
+  if(v == CYCLES_DONE) {
+    done = 1;
+  } else if(v == CYCLES_END && op != CYCLES_END) {
+    cycles = avr->cycle - op_start;
+    r = &results[op];
+    if(r->runs == 0 || cycles < r->min) {
+      r->min = cycles;
+    }
+    if(cycles > r->max) {
+      r->max = cycles;
+    }
+    r->sum += cycles;
+    r->runs++;
+    op = CYCLES_END;
+  } else if(v < CYCLES_OPS) {
+    op = v;
+    op_start = avr->cycle;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+request(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+  if(v == CYCLES_PEER_SEND) {
+    follow();
+    peer_send();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(const char *path, const char *mcu, uint32_t frequency)
+{
+  elf_firmware_t firmware;
+  avr_cycle_count_t limit;
+  int state;
+
+  memset(&firmware, 0, sizeof(firmware));
+  if(elf_read_firmware(path, &firmware) != 0) {
+    fprintf(stderr, "%s: cannot read the image\n", path);
+    exit(2);
+  }
+  snprintf(firmware.mmcu, sizeof(firmware.mmcu), "%s", mcu);
+  firmware.frequency = frequency;
+  avr = avr_make_mcu_by_name(firmware.mmcu);
+  if(avr == NULL) {
+    fprintf(stderr, "simavr does not know %s\n", mcu);
+    exit(2);
+  }
+  avr_init(avr);
+  avr_load_firmware(avr, &firmware);
+
+  nrf24_emu_air_init(&air, 1);
+  nrf24_emu_init(&dut, &air);
+  nrf24_emu_init(&peer, &air);
+  peer_setup();
+
+  spi_in = avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_INPUT);
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_OUTPUT),
+                          spi_out, NULL);
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), CE_PIN),
+                          pin_changed, (void *)(intptr_t)CE_PIN);
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), CSN_PIN),
+                          pin_changed, (void *)(intptr_t)CSN_PIN);
+  irq_pin = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), IRQ_PIN);
+  avr_register_io_write(avr, GPIOR0_ADDR, marker, NULL);
+  avr_register_io_write(avr, GPIOR1_ADDR, request, NULL);
+  avr_cycle_timer_register_usec(avr, TICK_US, tick, NULL);
+
+  limit = (avr_cycle_count_t)TIMEOUT_S * frequency;
+  do {
+    state = avr_run(avr);
+  } while(!done && state != cpu_Done && state != cpu_Crashed &&
+          avr->cycle < limit);
+  if(!done) {
+    fprintf(stderr, "%s: the firmware did not finish\n", path);
+    exit(2);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Cycles of @p op without the marks */
+static unsigned long
+mean(int op)
+{
+  struct result *r = &results[op];
+  unsigned long marks = op == CYCLES_MARKER ? 0 : results[CYCLES_MARKER].min;
+
+  return r->runs ? (r->sum + r->runs / 2) / r->runs - marks : 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Compare with, or with @p update write, the lines for @p frequency in the
+ * baseline file. With @p delta every operation is printed with its change
+ * and none fails. Returns the number of operations that got slower, or
+ * have no baseline to compare with. */
+static int
+baseline(const char *path, uint32_t frequency, int update, int delta)
+{
+  char *lines[BASELINE_MAX];
+  char line[128], name[64];
+  unsigned long f, cycles;
+  int count = 0, worse = 0, i, o;
+  int known[CYCLES_OPS] = { 0 };
+  FILE *file = fopen(path, "r");
+
+  while(file != NULL && count < BASELINE_MAX && fgets(line, sizeof(line), file)) {
+    if(sscanf(line, "%lu %63s %lu", &f, name, &cycles) == 3 && f == frequency) {
+      for(o = CYCLES_MARKER; o < CYCLES_OPS; o++) {
+        if(strcmp(name, names[o]) != 0) {
+          continue;
+        }
+        known[o] = 1;
+        if(delta) {
+          printf("%-16s %8lu %8lu %+8ld\n", name, cycles, mean(o),
+                 (long)mean(o) - (long)cycles);
+        } else if(!update && mean(o) > cycles) {
+          printf("%-16s %lu cycles, was %lu\n", name, mean(o), cycles);
+          worse++;
+        }
+      }
+      if(update) {
+        continue;
+      }
+    }
+    lines[count++] = strdup(line);
+  }
+  if(file != NULL) {
+    fclose(file);
+  }
+  if(delta) {
+    worse = 0;
+  }
+  if(!update) {
+    // A check without a baseline would pass whatever the counts
+    for(o = CYCLES_MARKER; o < CYCLES_OPS; o++) {
+      if(!known[o]) {
+        printf("%-16s no baseline at %lu Hz in %s, see \"make baseline\"\n",
+               names[o], (unsigned long)frequency, path);
+        worse++;
+      }
+    }
+    return worse;
+  }
+
+  file = fopen(path, "w");
+  if(file == NULL) {
+    perror(path);
+    exit(2);
+  }
+  if(count == 0) {
+    fprintf(file, "# f_cpu operation cycles\n");
+  }
+  for(i = 0; i < count; i++) {
+    fputs(lines[i], file);
+  }
+  for(o = CYCLES_MARKER; o < CYCLES_OPS; o++) {
+    fprintf(file, "%lu %s %lu\n", (unsigned long)frequency, names[o], mean(o));
+  }
+  fclose(file);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  const char *mcu = "atmega328p", *baseline_file = NULL;
+  uint32_t frequency = 16000000;
+  int update = 0, delta = 0, missing = 0, opt, o;
+
+  while((opt = getopt(argc, argv, "m:f:b:ud")) != -1) {
+    switch(opt) {
+    case 'm': mcu = optarg; break;
+    case 'f': frequency = strtoul(optarg, NULL, 0); break;
+    case 'b': baseline_file = optarg; break;
+    case 'u': update = 1; break;
+    case 'd': delta = 1; break;
+    default: optind = argc + 1; break;
+    }
+  }
+  if(optind != argc - 1 || frequency == 0 || (update && delta)) {
+    fprintf(stderr, "usage: %s [-m mcu] [-f f_cpu] [-b baseline [-u | -d]] image.elf\n",
+            argv[0]);
+    return 2;
+  }
+  run(argv[optind], mcu, frequency);
+
+  printf("%s, %s at %.0f MHz, cycles without the marker\n",
+         argv[optind], mcu, frequency / 1e6);
+  printf("%-16s %5s %8s %8s %8s %10s\n", "operation", "runs", "min", "mean",
+         "max", "mean us");
+  for(o = CYCLES_MARKER; o < CYCLES_OPS; o++) {
+    unsigned long marks = o == CYCLES_MARKER ? 0 : results[CYCLES_MARKER].min;
+
+    printf("%-16s %5u %8lu %8lu %8lu %10.1f\n", names[o], results[o].runs,
+           results[o].runs ? (unsigned long)(results[o].min - marks) : 0,
+           mean(o),
+           results[o].runs ? (unsigned long)(results[o].max - marks) : 0,
+           mean(o) * 1e6 / frequency);
+  }
+  if(baseline_file == NULL) {
+    return 0;
+  }
+  // A mean of no runs is 0 and would pass any comparison, or go into the
+  // baseline as if the operation were free
+  for(o = CYCLES_MARKER; o < CYCLES_OPS; o++) {
+    if(results[o].runs == 0) {
+      printf("%-16s never completed\n", names[o]);
+      missing++;
+    }
+  }
+  if(missing > 0) {
+    return 1;
+  }
+  if(delta) {
+    printf("%-16s %8s %8s %8s\n", "operation", "before", "now", "delta");
+  }
+  return baseline(baseline_file, frequency, update, delta) > 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,100 @@
+/* Connects the host build of the driver to emulated radios: SPI bytes and
+ * the CE and CSN pins go to them, and the medium follows the host clock. */
+
+#include "contiki.h"
+#include "Arduino.h"
+#include "nRF24_driver.h"
+#include "emu-host.h"
+
+/* Time the MCU spends per SPI byte at F_CPU / 4, and per digitalWrite() */
+#define SPI_BYTE_US 3
+#define PIN_US 4
+/* Radios on the bus, as many as the driver drives */
+#define BUS 4
+
+static struct {
+  struct nrf24_emu *radio;
+  uint8_t ce, csn, irq;
+} bus[BUS];
+static uint8_t attached;
+static struct nrf24_emu *selected;  /* The last one CSN went low on */
+
+/*---------------------------------------------------------------------------*/
+static void
+follow(void)
+{
+  nrf24_emu_air_run(bus[0].radio->medium, nRF24_host_us);
+}
+/*---------------------------------------------------------------------------*/
+void
+nrf24_emu_host_bind(struct nrf24_emu *r)
+{
+  attached = 0;
+  nrf24_emu_host_attach(r, nRF24_CEPIN, nRF24_CSPIN, nRF24_NO_PIN);
+  nRF24_host_us = r->medium->now;
+  nRF24_host_elapsed = follow;
+}
+/*---------------------------------------------------------------------------*/
+void
+nrf24_emu_host_attach(struct nrf24_emu *r, uint8_t ce, uint8_t csn, uint8_t irq)
+{
+  uint8_t i;
+
+  for(i = 0; i < attached && bus[i].radio != r; i++);
+  if(i == BUS) {
+    return;
+  }
+  bus[i].radio = r;
+  bus[i].ce = ce;
+  bus[i].csn = csn;
+  bus[i].irq = irq;
+  if(i == attached) {
+    attached++;
+  }
+  selected = bus[0].radio;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+nRF24_host_spi(uint8_t mosi)
+{
+  nRF24_host_elapse(SPI_BYTE_US);
+  return nrf24_emu_spi(selected, mosi);
+}
+/*---------------------------------------------------------------------------*/
+void
+digitalWrite(uint8_t pin, uint8_t value)
+{
+  uint8_t i;
+
+  nRF24_host_elapse(PIN_US);
+  for(i = 0; i < attached; i++) {
+    if(pin == bus[i].csn) {
+      nrf24_emu_csn(bus[i].radio, value);
+      if(value == LOW) {
+        selected = bus[i].radio;
+      }
+    } else if(pin == bus[i].ce) {
+      nrf24_emu_ce(bus[i].radio, value);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+digitalRead(uint8_t pin)
+{
+  uint8_t i;
+
+  nRF24_host_elapse(PIN_US);
+  for(i = 0; i < attached; i++) {
+    if(pin == bus[i].irq) {
+      return nrf24_emu_irq(bus[i].radio);
+    }
+  }
+  return LOW;
+}
+/*---------------------------------------------------------------------------*/
+void
+pinMode(uint8_t pin, uint8_t mode)
+{
+}
+/*---------------------------------------------------------------------------*/
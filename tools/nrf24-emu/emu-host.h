@@ -0,0 +1,34 @@
+/**
+ * \file
+ *         The host build of the driver on an emulated nRF24L01+
+ */
+
+#ifndef EMU_HOST_H
+#define EMU_HOST_H
+
+#include "nrf24-emu.h"
+
+  /**
+   * Attach the driver's SPI bus and pins to @p radio, alone on the bus
+   *
+   * From here on the host clock and the radio's medium move together: each
+   * SPI byte, pin write, delay and rtimer read runs the medium up to the
+   * new time.
+   */
+  void nrf24_emu_host_bind(struct nrf24_emu *radio);
+
+  /**
+   * Put one more radio on the bus, for a driver built with nRF24_RADIOS
+   * above 1, or change the pins of one already on it
+   *
+   * SPI bytes go to the radio whose CSN pin was pulled low last.
+   *
+   * @param radio The radio
+   * @param ce Its CE pin
+   * @param csn Its CSN pin
+   * @param irq Its IRQ pin, read with digitalRead(), or nRF24_NO_PIN
+   */
+  void nrf24_emu_host_attach(struct nrf24_emu *radio, uint8_t ce,
+                             uint8_t csn, uint8_t irq);
+
+#endif /* EMU_HOST_H */
@@ -0,0 +1,319 @@
+/* The unmodified driver against emulated radios.
+ *
+ * Node 1 runs the driver. Node 2 is a second emulated radio driven straight
+ * through its registers, set up the way the driver sets up its own. Every
+ * scenario checks what arrived and prints throughput and retries. */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "nRF24_driver.h"
+#include "nRF24L01.h"
+#include "emu-host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DUT_NODE 1
+#define PEER_NODE 2
+#define FRAMES 300
+#define PAYLOAD 32
+
+static struct nrf24_emu_air air;
+static struct nrf24_emu dut, peer;
+static double loss_to_peer, loss_to_dut;
+static int failed;
+
+/* Sequence numbers the peer saw, see peer_drain() */
+static int peer_next;
+static int peer_delivered;
+static int peer_ack_payloads;
+
+/*---------------------------------------------------------------------------*/
+static void
+check(int ok, const char *scenario, const char *what)
+{
+  if(!ok) {
+    printf("FAIL %s: %s\n", scenario, what);
+    failed = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static double
+loss(const struct nrf24_emu *from, const struct nrf24_emu *to)
+{
+  return to == &peer ? loss_to_peer : loss_to_dut;
+}
+/*---------------------------------------------------------------------------*/
+static void
+node_address(uint8_t node, uint8_t *address)
+{
+  static const uint8_t net[] = nRF24_NET_ADDRESS;
+
+  address[0] = node;
+  memcpy(&address[1], net, 4);
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_address(struct nrf24_emu *r, uint8_t reg, uint8_t node)
+{
+  uint8_t address[5];
+
+  node_address(node, address);
+  nrf24_emu_command(r, W_REGISTER | reg, address, NULL, 5);
+}
+/*---------------------------------------------------------------------------*/
+/* The peer as the driver would set it up, listening */
+static void
+peer_setup(uint8_t features)
+{
+  nrf24_emu_write_register(&peer, RF_SETUP, 0x06);          // 1Mbps
+  nrf24_emu_write_register(&peer, RF_CH, 76);
+  nrf24_emu_write_register(&peer, SETUP_RETR, 0x2f);        // 750us, 15
+  nrf24_emu_write_register(&peer, FEATURE, features | _BV(EN_DYN_ACK));
+  nrf24_emu_write_register(&peer, DYNPD, features & _BV(EN_DPL) ? 0x3f : 0);
+  write_address(&peer, RX_ADDR_P1, nRF24_BROADCAST_NODE);
+  nrf24_emu_write_register(&peer, RX_ADDR_P2, PEER_NODE);
+  nrf24_emu_write_register(&peer, RX_PW_P0, PAYLOAD);
+  nrf24_emu_write_register(&peer, RX_PW_P1, PAYLOAD);
+  nrf24_emu_write_register(&peer, RX_PW_P2, PAYLOAD);
+  nrf24_emu_write_register(&peer, EN_RXADDR, _BV(ERX_P0) | _BV(ERX_P1) | _BV(ERX_P2));
+  nrf24_emu_write_register(&peer, CONFIG, _BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP) | _BV(PRIM_RX));
+  nrf24_emu_ce(&peer, 1);
+}
+/*---------------------------------------------------------------------------*/
+/* A fresh medium, the driver initialised on one radio and the peer ready */
+static void
+setup(uint32_t seed, double to_peer, double to_dut, uint8_t features)
+{
+  nrf24_emu_air_init(&air, seed);
+  air.loss = loss;
+  loss_to_peer = to_peer;
+  loss_to_dut = to_dut;
+  nrf24_emu_init(&dut, &air);
+  nrf24_emu_init(&peer, &air);
+  nrf24_emu_host_bind(&dut);
+
+  rimeaddr_node_addr.u8[0] = DUT_NODE;
+  nRF24_driver.init();
+  peer_setup(features);
+  nRF24_host_elapse(2000);
+
+  peer_next = 0;
+  peer_delivered = 0;
+  peer_ack_payloads = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Read what the peer received. Frames must come in order, each once. */
+static void
+peer_drain(const char *scenario)
+{
+  uint8_t buf[32];
+  uint8_t status, len;
+  int seq;
+
+  while(!(nrf24_emu_read_register(&peer, FIFO_STATUS) & _BV(RX_EMPTY))) {
+    status = nrf24_emu_command(&peer, NOP, NULL, NULL, 0);
+    len = PAYLOAD;
+    if(nrf24_emu_read_register(&peer, FEATURE) & _BV(EN_DPL)) {
+      nrf24_emu_command(&peer, R_RX_PL_WID, NULL, &len, 1);
+    }
+    nrf24_emu_command(&peer, R_RX_PAYLOAD, NULL, buf, len);
+    seq = buf[0] | buf[1] << 8;
+    if(((status >> RX_P_NO) & 7) == 0) {
+      // An ACK payload
+      check(seq == peer_ack_payloads, scenario, "ACK payload out of order");
+      peer_ack_payloads++;
+      continue;
+    }
+    check(seq >= peer_next, scenario, "frame repeated or out of order");
+    peer_next = seq + 1;
+    peer_delivered++;
+  }
+  nrf24_emu_write_register(&peer, STATUS, _BV(RX_DR));
+}
+/*---------------------------------------------------------------------------*/
+/* The peer sends one frame to @p node, returns whether it was acknowledged */
+static int
+peer_send(uint8_t node, const uint8_t *data, uint8_t len)
+{
+  uint8_t status;
+
+  nrf24_emu_ce(&peer, 0);
+  nrf24_emu_write_register(&peer, CONFIG, _BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP));
+  write_address(&peer, TX_ADDR, node);
+  write_address(&peer, RX_ADDR_P0, node);
+  nrf24_emu_command(&peer, W_TX_PAYLOAD, data, NULL, len);
+  nrf24_emu_ce(&peer, 1);
+  do {
+    nRF24_host_elapse(20);
+    status = nrf24_emu_command(&peer, NOP, NULL, NULL, 0);
+  } while(!(status & (_BV(TX_DS) | _BV(MAX_RT))));
+  nrf24_emu_ce(&peer, 0);
+  nrf24_emu_write_register(&peer, STATUS, _BV(TX_DS) | _BV(MAX_RT));
+  if(status & _BV(MAX_RT)) {
+    nrf24_emu_command(&peer, FLUSH_TX, NULL, NULL, 0);
+  }
+  // Back to listening
+  nrf24_emu_write_register(&peer, CONFIG, _BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP) | _BV(PRIM_RX));
+  nrf24_emu_ce(&peer, 1);
+  return !(status & _BV(MAX_RT));
+}
+/*---------------------------------------------------------------------------*/
+/* The driver sends FRAMES frames to @p node, 0 for broadcast */
+static int
+dut_send(const char *scenario, uint8_t node, int *acked)
+{
+  rimeaddr_t dest = rimeaddr_null;
+  uint8_t buf[PAYLOAD];
+  int i, ret;
+
+  dest.u8[0] = node;
+  *acked = 0;
+  nRF24_startListening();
+  for(i = 0; i < FRAMES; i++) {
+    memset(buf, 0, sizeof(buf));
+    buf[0] = i;
+    buf[1] = i >> 8;
+    packetbuf_clear();
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
+    ret = nRF24_driver.send(buf, sizeof(buf));
+    check(ret == RADIO_TX_OK || ret == RADIO_TX_NOACK, scenario, "send error");
+    if(ret == RADIO_TX_OK) {
+      (*acked)++;
+    }
+    peer_drain(scenario);
+  }
+  return FRAMES;
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(const char *scenario, int sent, int acked, int delivered,
+       const struct nrf24_emu *tx, const struct nrf24_emu *rx,
+       uint64_t start)
+{
+  double seconds = (air.now - start) / 1e6;
+
+  printf("%-22s %4d sent %4d acked %4d delivered %5lu retx %4lu dup %5.2f ms/frame %6.1f kbit/s\n",
+         scenario, sent, acked, delivered,
+         (unsigned long)tx->stats.retransmits,
+         (unsigned long)rx->stats.duplicates,
+         seconds * 1e3 / sent, delivered * PAYLOAD * 8 / seconds / 1e3);
+}
+/*---------------------------------------------------------------------------*/
+static void
+unicast(const char *scenario, double to_peer, double to_dut)
+{
+  uint64_t start;
+  int sent, acked;
+
+  setup(1, to_peer, to_dut, 0);
+  start = air.now;
+  sent = dut_send(scenario, PEER_NODE, &acked);
+  report(scenario, sent, acked, peer_delivered, &dut, &peer, start);
+
+  // A frame may arrive with all its ACKs lost, never the other way round
+  check(peer_delivered >= acked, scenario, "acknowledged frame not delivered");
+  if(to_peer == 0 && to_dut == 0) {
+    check(acked == sent && dut.stats.retransmits == 0, scenario, "retries on a perfect link");
+  }
+  if(to_peer == 0 && to_dut > 0) {
+    // Every frame gets through the first time, lost ACKs only make repeats
+    check(peer_delivered == sent, scenario, "frame lost on a perfect forward link");
+    check(peer.stats.duplicates > 0, scenario, "no repeated packet ID seen");
+    check(peer.stats.duplicates == dut.stats.retransmits, scenario,
+          "duplicates and retransmissions differ");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+broadcast(const char *scenario)
+{
+  uint64_t start;
+  int sent, acked;
+
+  setup(2, 0, 0, 0);
+  start = air.now;
+  sent = dut_send(scenario, 0, &acked);
+  report(scenario, sent, acked, peer_delivered, &dut, &peer, start);
+  check(peer_delivered == sent && acked == sent, scenario, "broadcast lost");
+  check(dut.stats.retransmits == 0 && peer.stats.acks == 0, scenario,
+        "broadcast acknowledged");
+}
+/*---------------------------------------------------------------------------*/
+static void
+no_receiver(const char *scenario)
+{
+  uint8_t arc;
+  uint64_t start;
+  int sent, acked;
+
+  setup(3, 0, 0, 0);
+  nrf24_emu_ce(&peer, 0);
+  start = air.now;
+  sent = dut_send(scenario, PEER_NODE, &acked);
+  report(scenario, sent, acked, peer_delivered, &dut, &peer, start);
+  arc = nrf24_emu_read_register(&dut, SETUP_RETR) & 0x0f;
+  check(acked == 0 && dut.stats.max_rt == (uint32_t)sent, scenario, "MAX_RT not raised");
+  check(dut.stats.retransmits == (uint32_t)sent * arc, scenario, "ARC retries not made");
+}
+/*---------------------------------------------------------------------------*/
+/* The peer sends to the driver, which answers with ACK payloads if @p features
+ * asks for them */
+static void
+receive(const char *scenario, uint8_t features)
+{
+  uint8_t buf[PAYLOAD], ack[4];
+  uint64_t start;
+  int i, acked = 0, received = 0, delivered = 0, len;
+
+  setup(4, 0.1, 0.1, features);
+  if(features & _BV(EN_ACK_PAY)) {
+    nRF24_enableDynamicPayloads();
+    nRF24_enableAckPayload();
+  }
+  nRF24_startListening();
+  start = air.now;
+  for(i = 0; i < FRAMES; i++) {
+    if(features & _BV(EN_ACK_PAY)) {
+      ack[0] = i;
+      ack[1] = i >> 8;
+      nRF24_writeAckPayload(2, ack, sizeof(ack));
+    }
+    memset(buf, 0, sizeof(buf));
+    buf[0] = i;
+    buf[1] = i >> 8;
+    acked += peer_send(DUT_NODE, buf, sizeof(buf));
+    while(nRF24_available(NULL)) {
+      len = nRF24_driver.read(buf, sizeof(buf));
+      check(len == PAYLOAD, scenario, "wrong length");
+      check((buf[0] | buf[1] << 8) >= received, scenario, "frame repeated or out of order");
+      received = (buf[0] | buf[1] << 8) + 1;
+      delivered++;
+    }
+    peer_drain(scenario);
+  }
+  report(scenario, FRAMES, acked, delivered, &peer, &dut, start);
+  check(delivered >= acked, scenario, "acknowledged frame not read");
+  if(features & _BV(EN_ACK_PAY)) {
+    printf("%-22s %4d ACK payloads\n", "", peer_ack_payloads);
+    check(peer_ack_payloads == acked, scenario, "ACK payload missing");
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  unicast("unicast", 0, 0);
+  unicast("unicast 10% loss", 0.1, 0.1);
+  unicast("unicast 30% loss", 0.3, 0.3);
+  unicast("unicast 50% ACK loss", 0, 0.5);
+  broadcast("broadcast");
+  no_receiver("no receiver");
+  receive("receive 10% loss", 0);
+  receive("receive ACK payload", _BV(EN_DPL) | _BV(EN_ACK_PAY));
+
+  printf(failed ? "FAILED\n" : "ok\n");
+  return failed;
+}
+/*---------------------------------------------------------------------------*/
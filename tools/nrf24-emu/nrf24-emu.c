@@ -0,0 +1,783 @@
+#include "nrf24-emu.h"
+#include "nRF24L01.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define BV(bit) (1 << (bit))
+#define FLAGS (BV(RX_DR) | BV(TX_DS) | BV(MAX_RT))
+
+#define FIFO_DEPTH 3
+#define TPD2STBY_US 1500    /* Power down to standby, worst case */
+#define TSTBY2A_US 130      /* Standby to RX or TX */
+
+enum { RATE_1M, RATE_2M, RATE_250K };
+
+/*---------------------------------------------------------------------------*/
+static uint8_t
+rate(const struct nrf24_emu *r)
+{
+  if(r->regs[RF_SETUP] & BV(RF_DR_LOW)) {
+    return RATE_250K;
+  }
+  return r->regs[RF_SETUP] & BV(RF_DR_HIGH) ? RATE_2M : RATE_1M;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+address_width(const struct nrf24_emu *r)
+{
+  uint8_t aw = r->regs[SETUP_AW] & 3;
+
+  return aw == 0 ? 3 : aw + 2;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+crc_length(const struct nrf24_emu *r)
+{
+  // Auto acknowledgement forces the CRC on
+  if(!(r->regs[CONFIG] & BV(EN_CRC)) && r->regs[EN_AA] == 0) {
+    return 0;
+  }
+  return r->regs[CONFIG] & BV(CRCO) ? 2 : 1;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+dynamic(const struct nrf24_emu *r, uint8_t pipe)
+{
+  return (r->regs[FEATURE] & BV(EN_DPL)) && (r->regs[DYNPD] & BV(pipe));
+}
+/*---------------------------------------------------------------------------*/
+/* Address of @p pipe, LSB first. Pipes 2-5 share the upper bytes of pipe 1. */
+static void
+pipe_address(const struct nrf24_emu *r, uint8_t pipe, uint8_t *address)
+{
+  if(pipe == 0) {
+    memcpy(address, r->address[0], 5);
+  } else {
+    memcpy(address, r->address[1], 5);
+    if(pipe > 1) {
+      address[0] = r->regs[RX_ADDR_P2 + pipe - 2];
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+checksum(const struct nrf24_emu_frame *f)
+{
+  uint16_t sum = f->len;
+  uint8_t i;
+
+  for(i = 0; i < f->len; i++) {
+    sum = ((sum << 1) | (sum >> 15)) + f->data[i];
+  }
+  return sum;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+random32(struct nrf24_emu_air *air)
+{
+  // xorshift32
+  air->seed ^= air->seed << 13;
+  air->seed ^= air->seed >> 17;
+  air->seed ^= air->seed << 5;
+  return air->seed;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+nrf24_emu_airtime(const struct nrf24_emu *r, uint8_t len)
+{
+  // Preamble, address, 9 bit packet control field, payload and CRC
+  uint32_t bits = 8 + 8 * address_width(r) + 9 + 8 * len + 8 * crc_length(r);
+
+  switch(rate(r)) {
+  case RATE_2M:
+    return (bits + 8 + 1) / 2;      // 2 byte preamble
+  case RATE_250K:
+    return bits * 4;
+  }
+  return bits;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_state(struct nrf24_emu *r, enum nrf24_emu_state state, uint64_t next)
+{
+  uint64_t now = r->medium->now;
+
+  r->stats.time_in[r->state] += now - r->since;
+  r->since = now;
+  r->state = state;
+  r->next_event = next;
+  if(next < r->medium->earliest) {
+    r->medium->earliest = next;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+raise(struct nrf24_emu *r, uint8_t flag)
+{
+  r->regs[STATUS] |= flag;
+  if(r->medium->irq != NULL && (flag & ~r->regs[CONFIG])) {
+    r->medium->irq(r);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+pop(struct nrf24_emu_frame *fifo, uint8_t *count, uint8_t i)
+{
+  if(i < *count) {
+    memmove(&fifo[i], &fifo[i + 1], (*count - i - 1) * sizeof(fifo[0]));
+    (*count)--;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+push_rx(struct nrf24_emu *r, const struct nrf24_emu_frame *f, uint8_t pipe)
+{
+  r->rx[r->rx_count] = *f;
+  r->rx[r->rx_count].pipe = pipe;
+  r->rx_count++;
+  r->stats.received++;
+  raise(r, BV(RX_DR));
+}
+/*---------------------------------------------------------------------------*/
+/* Index of the first frame in the TX FIFO the PTX may send, -1 if none. ACK
+ * payloads only leave with an ACK. */
+static int
+next_tx(const struct nrf24_emu *r)
+{
+  uint8_t i;
+
+  for(i = 0; i < r->tx_count; i++) {
+    if(!r->tx[i].ack_payload) {
+      return i;
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+leave_air(struct nrf24_emu *r)
+{
+  struct nrf24_emu_tx **t;
+
+  for(t = &r->medium->in_air; *t != NULL; t = &(*t)->next) {
+    if(*t == &r->out) {
+      *t = r->out.next;
+      break;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+overlap(struct nrf24_emu_tx *t, struct nrf24_emu *from)
+{
+  if(t->overlaps < NRF24_EMU_OVERLAPS) {
+    t->overlap[t->overlaps++] = from;
+  } else {
+    t->corrupt = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Whether a frame that overlapped @p t reaches @p r */
+static int
+corrupted(const struct nrf24_emu_air *air, const struct nrf24_emu_tx *t,
+          const struct nrf24_emu *r)
+{
+  uint8_t i;
+
+  if(t->corrupt) {
+    return 1;
+  }
+  for(i = 0; i < t->overlaps; i++) {
+    if(air->interferes == NULL || air->interferes(t->overlap[i], r)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+enter_air(struct nrf24_emu *r, uint32_t airtime)
+{
+  struct nrf24_emu_tx *t;
+
+  r->out.from = r;
+  r->out.start = r->medium->now;
+  r->out.end = r->medium->now + airtime;
+  r->out.channel = r->regs[RF_CH];
+  r->out.rate = rate(r);
+  r->out.aw = address_width(r);
+  r->out.crc = crc_length(r);
+  r->out.corrupt = 0;
+  r->out.overlaps = 0;
+  // Whatever else is on the channel now overlaps this frame
+  for(t = r->medium->in_air; t != NULL; t = t->next) {
+    if(t->channel == r->out.channel) {
+      overlap(t, r);
+      overlap(&r->out, t->from);
+    }
+  }
+  r->out.next = r->medium->in_air;
+  r->medium->in_air = &r->out;
+  r->stats.frames++;
+  set_state(r, NRF24_EMU_TX, r->out.end);
+}
+/*---------------------------------------------------------------------------*/
+/* What the radio does next, after its inputs changed or a state ended */
+static void
+idle(struct nrf24_emu *r)
+{
+  uint64_t now = r->medium->now;
+
+  if(!(r->regs[CONFIG] & BV(PWR_UP))) {
+    if(r->state == NRF24_EMU_TX) {
+      leave_air(r);
+    }
+    if(r->state != NRF24_EMU_DOWN) {
+      set_state(r, NRF24_EMU_DOWN, NRF24_EMU_NEVER);
+    }
+    return;
+  }
+  switch(r->state) {
+  case NRF24_EMU_DOWN:
+    set_state(r, NRF24_EMU_POWERING, now + TPD2STBY_US);
+    return;
+  case NRF24_EMU_POWERING:
+  case NRF24_EMU_TX_SETTLE:
+  case NRF24_EMU_TX:
+  case NRF24_EMU_ACK_WAIT:
+  case NRF24_EMU_ACK_SETTLE:
+    // Once started, a transmission completes whatever CE does
+    return;
+  default:
+    break;
+  }
+
+  if(!r->ce) {
+    if(r->state != NRF24_EMU_STANDBY) {
+      set_state(r, NRF24_EMU_STANDBY, NRF24_EMU_NEVER);
+    }
+  } else if(r->regs[CONFIG] & BV(PRIM_RX)) {
+    if(r->state != NRF24_EMU_RX && r->state != NRF24_EMU_RX_SETTLE) {
+      set_state(r, NRF24_EMU_RX_SETTLE, now + TSTBY2A_US);
+    }
+  } else if(next_tx(r) >= 0 && !(r->regs[STATUS] & BV(MAX_RT))) {
+    set_state(r, NRF24_EMU_TX_SETTLE, now + TSTBY2A_US);
+  } else if(r->state != NRF24_EMU_STANDBY) {
+    set_state(r, NRF24_EMU_STANDBY, NRF24_EMU_NEVER);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Frame done, sent without ACK or acknowledged */
+static void
+tx_done(struct nrf24_emu *r)
+{
+  int i = next_tx(r);
+
+  r->regs[OBSERVE_TX] = (r->regs[OBSERVE_TX] & 0xf0) | r->arc;
+  if(!r->reuse && i >= 0) {
+    pop(r->tx, &r->tx_count, i);
+  }
+  raise(r, BV(TX_DS));
+  set_state(r, NRF24_EMU_STANDBY, NRF24_EMU_NEVER);
+  idle(r);
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_tx(struct nrf24_emu *r)
+{
+  int i = next_tx(r);
+
+  if(i < 0 || (r->regs[STATUS] & BV(MAX_RT))) {
+    set_state(r, NRF24_EMU_STANDBY, NRF24_EMU_NEVER);
+    idle(r);
+    return;
+  }
+  r->out.frame = r->tx[i];
+  r->out.ack = 0;
+  r->out.dpl = dynamic(r, 0);
+  memcpy(r->out.address, r->address[2], 5);
+  enter_air(r, nrf24_emu_airtime(r, r->tx[i].len));
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_ack(struct nrf24_emu *r)
+{
+  uint8_t i;
+
+  r->out.frame.len = 0;
+  // An ACK payload needs dynamic payloads on the pipe
+  if((r->regs[FEATURE] & BV(EN_ACK_PAY)) && dynamic(r, r->ack_pipe)) {
+    for(i = 0; i < r->tx_count; i++) {
+      if(r->tx[i].ack_payload && r->tx[i].pipe == r->ack_pipe) {
+        r->out.frame = r->tx[i];
+        r->tx[i].sent = 1;
+        break;
+      }
+    }
+  }
+  r->out.ack = 1;
+  r->out.dpl = 1;
+  pipe_address(r, r->ack_pipe, r->out.address);
+  r->stats.acks++;
+  enter_air(r, nrf24_emu_airtime(r, r->out.frame.len));
+}
+/*---------------------------------------------------------------------------*/
+/* A PRX hears a frame for @p pipe */
+static void
+receive(struct nrf24_emu *r, const struct nrf24_emu_tx *t, uint8_t pipe)
+{
+  uint8_t auto_ack = (r->regs[EN_AA] & BV(pipe)) && !t->frame.no_ack;
+  uint8_t i;
+
+  if(dynamic(r, pipe) != t->dpl ||
+     (!t->dpl && t->frame.len != (r->regs[RX_PW_P0 + pipe] & 0x3f))) {
+    // The packet control field or the length is not what the pipe expects,
+    // the CRC fails
+    return;
+  }
+  if(auto_ack && r->last_pid[pipe] == t->frame.pid &&
+     r->last_crc[pipe] == t->frame.crc) {
+    // The ACK was lost, acknowledge again but do not store it twice
+    r->stats.duplicates++;
+  } else if(r->rx_count == FIFO_DEPTH) {
+    // No room, no ACK: the PTX retries
+    r->stats.overflows++;
+    return;
+  } else {
+    push_rx(r, &t->frame, pipe);
+    if(auto_ack) {
+      r->last_pid[pipe] = t->frame.pid;
+      r->last_crc[pipe] = t->frame.crc;
+      // A new packet confirms the ACK payload sent with the previous ACK
+      for(i = 0; i < r->tx_count; i++) {
+        if(r->tx[i].ack_payload && r->tx[i].pipe == pipe && r->tx[i].sent) {
+          pop(r->tx, &r->tx_count, i);
+          break;
+        }
+      }
+    }
+  }
+  if(auto_ack) {
+    r->ack_pipe = pipe;
+    set_state(r, NRF24_EMU_ACK_SETTLE, r->medium->now + TSTBY2A_US);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* A PTX waiting in ACK_WAIT hears the ACK */
+static void
+acknowledged(struct nrf24_emu *r, const struct nrf24_emu_tx *t)
+{
+  if(t->frame.len > 0 && r->rx_count < FIFO_DEPTH) {
+    push_rx(r, &t->frame, 0);
+  }
+  tx_done(r);
+}
+/*---------------------------------------------------------------------------*/
+/* @p t ended, hand it to whoever listens */
+static void
+deliver(struct nrf24_emu_air *air, const struct nrf24_emu_tx *t)
+{
+  struct nrf24_emu *r;
+  uint8_t address[5];
+  uint8_t pipe;
+  int match;
+
+  for(r = air->radios; r != NULL; r = r->next) {
+    if(r == t->from || r->regs[RF_CH] != t->channel || rate(r) != t->rate ||
+       address_width(r) != t->aw || crc_length(r) != t->crc) {
+      continue;
+    }
+    if(t->ack) {
+      // Only the PTX waiting for it takes an ACK, on pipe 0
+      if(r->state != NRF24_EMU_ACK_WAIT || r->since > t->start) {
+        continue;
+      }
+      pipe = 0;
+      pipe_address(r, 0, address);
+      match = memcmp(address, t->address, t->aw) == 0;
+    } else {
+      // Listening since before the frame began
+      if(r->state != NRF24_EMU_RX || r->since > t->start) {
+        continue;
+      }
+      r->regs[RPD] = 1;
+      match = 0;
+      for(pipe = 0; pipe < 6 && !match; pipe++) {
+        if(r->regs[EN_RXADDR] & BV(pipe)) {
+          pipe_address(r, pipe, address);
+          match = memcmp(address, t->address, t->aw) == 0;
+        }
+      }
+      pipe--;
+    }
+    if(!match) {
+      continue;
+    }
+    if(corrupted(air, t, r)) {
+      r->stats.collisions++;
+      continue;
+    }
+    if(air->loss != NULL &&
+       random32(air) < air->loss(t->from, r) * 4294967296.0) {
+      r->stats.lost++;
+      continue;
+    }
+    if(t->ack) {
+      acknowledged(r, t);
+    } else {
+      receive(r, t, pipe);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The current state of @p r ended */
+static void
+event(struct nrf24_emu *r)
+{
+  uint64_t now = r->medium->now;
+
+  switch(r->state) {
+  case NRF24_EMU_POWERING:
+    set_state(r, NRF24_EMU_STANDBY, NRF24_EMU_NEVER);
+    idle(r);
+    break;
+
+  case NRF24_EMU_RX_SETTLE:
+    r->regs[RPD] = 0;
+    set_state(r, NRF24_EMU_RX, NRF24_EMU_NEVER);
+    break;
+
+  case NRF24_EMU_TX_SETTLE:
+    // A new packet, not a retransmission
+    r->arc = 0;
+    r->regs[OBSERVE_TX] &= 0xf0;
+    start_tx(r);
+    break;
+
+  case NRF24_EMU_TX:
+    leave_air(r);
+    deliver(r->medium, &r->out);
+    if(r->out.ack) {
+      // The ESB engine goes straight back to RX, the retransmission may
+      // come one ARD after the frame. Elsewhere if CE or PRIM_RX changed.
+      if(r->ce && (r->regs[CONFIG] & BV(PRIM_RX))) {
+        set_state(r, NRF24_EMU_RX, NRF24_EMU_NEVER);
+      } else {
+        set_state(r, NRF24_EMU_STANDBY, NRF24_EMU_NEVER);
+        idle(r);
+      }
+    } else if(r->out.frame.no_ack) {
+      tx_done(r);
+    } else {
+      // ARD counts from the end of the frame to the retransmission
+      set_state(r, NRF24_EMU_ACK_WAIT,
+                now + 250 * ((r->regs[SETUP_RETR] >> ARD) + 1));
+    }
+    break;
+
+  case NRF24_EMU_ACK_WAIT:
+    if(r->arc >= (r->regs[SETUP_RETR] & 0x0f)) {
+      if((r->regs[OBSERVE_TX] >> PLOS_CNT) < 15) {
+        r->regs[OBSERVE_TX] += 1 << PLOS_CNT;
+      }
+      r->regs[OBSERVE_TX] = (r->regs[OBSERVE_TX] & 0xf0) | r->arc;
+      r->stats.max_rt++;
+      raise(r, BV(MAX_RT));
+      // The frame stays in the FIFO
+      set_state(r, NRF24_EMU_STANDBY, NRF24_EMU_NEVER);
+      idle(r);
+    } else {
+      r->arc++;
+      r->regs[OBSERVE_TX] = (r->regs[OBSERVE_TX] & 0xf0) | r->arc;
+      r->stats.retransmits++;
+      start_tx(r);
+    }
+    break;
+
+  case NRF24_EMU_ACK_SETTLE:
+    send_ack(r);
+    break;
+
+  default:
+    r->next_event = NRF24_EMU_NEVER;
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+nrf24_emu_air_init(struct nrf24_emu_air *air, uint32_t seed)
+{
+  memset(air, 0, sizeof(*air));
+  air->seed = seed != 0 ? seed : 1;
+  air->earliest = NRF24_EMU_NEVER;
+}
+/*---------------------------------------------------------------------------*/
+void
+nrf24_emu_air_run(struct nrf24_emu_air *air, uint64_t until)
+{
+  struct nrf24_emu *r, *first;
+
+  // Most calls come from a polling driver with nothing due
+  while(air->earliest <= until) {
+    first = NULL;
+    for(r = air->radios; r != NULL; r = r->next) {
+      if(first == NULL || r->next_event < first->next_event) {
+        first = r;
+      }
+    }
+    air->earliest = first != NULL ? first->next_event : NRF24_EMU_NEVER;
+    if(air->earliest > until) {
+      break;
+    }
+    air->now = air->earliest;
+    event(first);
+  }
+  if(until > air->now) {
+    air->now = until;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+nrf24_emu_init(struct nrf24_emu *r, struct nrf24_emu_air *air)
+{
+  uint8_t i;
+
+  memset(r, 0, sizeof(*r));
+  r->medium = air;
+  r->regs[CONFIG] = 0x08;
+  r->regs[EN_AA] = 0x3f;
+  r->regs[EN_RXADDR] = 0x03;
+  r->regs[SETUP_AW] = 0x03;
+  r->regs[SETUP_RETR] = 0x03;
+  r->regs[RF_CH] = 0x02;
+  r->regs[RF_SETUP] = 0x0e;
+  for(i = 0; i < 4; i++) {
+    r->regs[RX_ADDR_P2 + i] = 0xc3 + i;
+  }
+  memset(r->address[0], 0xe7, 5);
+  memset(r->address[1], 0xc2, 5);
+  memset(r->address[2], 0xe7, 5);
+  // No PID matches before the first frame
+  memset(r->last_pid, 0xff, sizeof(r->last_pid));
+  r->csn = 1;
+  r->state = NRF24_EMU_DOWN;
+  r->since = air->now;
+  r->next_event = NRF24_EMU_NEVER;
+  r->next = air->radios;
+  air->radios = r;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+status(const struct nrf24_emu *r)
+{
+  return (r->regs[STATUS] & FLAGS) |
+         (r->rx_count ? r->rx[0].pipe : 7) << RX_P_NO |
+         (r->tx_count == FIFO_DEPTH ? BV(TX_FULL) : 0);
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+fifo_status(const struct nrf24_emu *r)
+{
+  return (r->reuse ? BV(TX_REUSE) : 0) |
+         (r->tx_count == FIFO_DEPTH ? BV(FIFO_FULL) : 0) |
+         (r->tx_count == 0 ? BV(TX_EMPTY) : 0) |
+         (r->rx_count == FIFO_DEPTH ? BV(RX_FULL) : 0) |
+         (r->rx_count == 0 ? BV(RX_EMPTY) : 0);
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+address_of(struct nrf24_emu *r, uint8_t reg)
+{
+  switch(reg) {
+  case RX_ADDR_P0:
+    return r->address[0];
+  case RX_ADDR_P1:
+    return r->address[1];
+  case TX_ADDR:
+    return r->address[2];
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* MISO for the n-th byte after the command */
+static uint8_t
+exchange(struct nrf24_emu *r, uint8_t mosi, uint8_t n)
+{
+  uint8_t reg = r->command & REGISTER_MASK;
+  uint8_t *addr = address_of(r, reg);
+
+  if((r->command & 0xe0) == R_REGISTER) {
+    if(addr != NULL) {
+      return n < 5 ? addr[n] : 0;
+    }
+    return reg == FIFO_STATUS ? fifo_status(r) :
+           reg == STATUS ? status(r) : r->regs[reg];
+  }
+  if((r->command & 0xe0) == W_REGISTER) {
+    if(addr != NULL) {
+      if(n < 5) {
+        addr[n] = mosi;
+      }
+    } else if(n > 0) {
+      // One byte registers take the first
+    } else if(reg == STATUS) {
+      // The interrupt flags clear when written with 1
+      r->regs[STATUS] &= ~(mosi & FLAGS);
+    } else if(reg == RF_CH) {
+      r->regs[RF_CH] = mosi & 0x7f;
+      r->regs[OBSERVE_TX] &= 0x0f;      // Clears PLOS_CNT
+    } else if(reg != FIFO_STATUS && reg != OBSERVE_TX && reg != RPD) {
+      r->regs[reg] = mosi;
+    }
+    return 0;
+  }
+  switch(r->command) {
+  case R_RX_PL_WID:
+    return r->rx_count ? r->rx[0].len : 0;
+  case R_RX_PAYLOAD:
+    return r->rx_count && n < r->rx[0].len ? r->rx[0].data[n] : 0;
+  }
+  if(r->command == W_TX_PAYLOAD || r->command == W_TX_PAYLOAD_NO_ACK ||
+     (r->command & 0xf8) == W_ACK_PAYLOAD) {
+    if(n < sizeof(r->building.data)) {
+      r->building.data[n] = mosi;
+      r->building.len = n + 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* CSN went high: commands that act on the FIFOs take effect */
+static void
+end_command(struct nrf24_emu *r)
+{
+  struct nrf24_emu_frame *f = &r->building;
+  uint8_t cmd = r->command;
+
+  if(r->pos == 0) {
+    return;
+  }
+  if(cmd == W_TX_PAYLOAD_NO_ACK && !(r->regs[FEATURE] & BV(EN_DYN_ACK))) {
+    cmd = NOP;
+  }
+  if((cmd & 0xf8) == W_ACK_PAYLOAD &&
+     ((cmd & 7) > 5 || !(r->regs[FEATURE] & BV(EN_ACK_PAY)))) {
+    cmd = NOP;
+  }
+
+  if(cmd == W_TX_PAYLOAD || cmd == W_TX_PAYLOAD_NO_ACK ||
+     (cmd & 0xf8) == W_ACK_PAYLOAD) {
+    if(r->tx_count < FIFO_DEPTH && f->len > 0) {
+      f->no_ack = cmd == W_TX_PAYLOAD_NO_ACK;
+      f->ack_payload = (cmd & 0xf8) == W_ACK_PAYLOAD;
+      f->pipe = cmd & 7;
+      f->sent = 0;
+      f->pid = r->pid = (r->pid + 1) & 3;
+      f->crc = checksum(f);
+      r->tx[r->tx_count++] = *f;
+      r->reuse = 0;
+    }
+  } else {
+    switch(cmd) {
+    case R_RX_PAYLOAD:
+      pop(r->rx, &r->rx_count, 0);
+      break;
+    case FLUSH_TX:
+      r->tx_count = 0;
+      r->reuse = 0;
+      break;
+    case FLUSH_RX:
+      r->rx_count = 0;
+      break;
+    case REUSE_TX_PL:
+      r->reuse = 1;
+      break;
+    }
+  }
+  idle(r);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+nrf24_emu_spi(struct nrf24_emu *r, uint8_t mosi)
+{
+  uint8_t miso;
+
+  if(r->csn) {
+    return 0xff;
+  }
+  if(r->pos == 0) {
+    r->command = mosi;
+    r->building.len = 0;
+    miso = status(r);
+  } else {
+    miso = exchange(r, mosi, r->pos - 1);
+  }
+  if(r->pos < 0xff) {
+    r->pos++;
+  }
+  return miso;
+}
+/*---------------------------------------------------------------------------*/
+void
+nrf24_emu_csn(struct nrf24_emu *r, uint8_t level)
+{
+  level = level != 0;
+  if(level == r->csn) {
+    return;
+  }
+  r->csn = level;
+  if(level) {
+    end_command(r);
+  } else {
+    r->pos = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+nrf24_emu_ce(struct nrf24_emu *r, uint8_t level)
+{
+  r->ce = level != 0;
+  idle(r);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+nrf24_emu_irq(const struct nrf24_emu *r)
+{
+  // The MASK_ bits of CONFIG sit where the flags sit in STATUS
+  return !(r->regs[STATUS] & FLAGS & ~r->regs[CONFIG]);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+nrf24_emu_command(struct nrf24_emu *r, uint8_t command,
+                  const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+  uint8_t status, miso, i;
+
+  nrf24_emu_csn(r, 0);
+  status = nrf24_emu_spi(r, command);
+  for(i = 0; i < len; i++) {
+    miso = nrf24_emu_spi(r, tx != NULL ? tx[i] : NOP);
+    if(rx != NULL) {
+      rx[i] = miso;
+    }
+  }
+  nrf24_emu_csn(r, 1);
+  return status;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+nrf24_emu_read_register(struct nrf24_emu *r, uint8_t reg)
+{
+  uint8_t value;
+
+  nrf24_emu_command(r, R_REGISTER | reg, NULL, &value, 1);
+  return value;
+}
+/*---------------------------------------------------------------------------*/
+void
+nrf24_emu_write_register(struct nrf24_emu *r, uint8_t reg, uint8_t value)
+{
+  nrf24_emu_command(r, W_REGISTER | reg, &value, NULL, 1);
+}
+/*---------------------------------------------------------------------------*/
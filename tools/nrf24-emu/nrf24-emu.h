@@ -0,0 +1,193 @@
+/**
+ * \file
+ *         Register level emulator of the nRF24L01+ for host builds
+ *
+ *         Every struct nrf24_emu is one radio: register file, 3 deep TX and
+ *         RX FIFOs, STATUS and FIFO_STATUS, DYNPD and FEATURE (dynamic
+ *         payloads, ACK payloads, W_TX_PAYLOAD_NO_ACK), REUSE_TX_PL, the
+ *         2 bit ESB packet ID and auto retransmit after ARD, up to ARC
+ *         times. The radio is driven like the real one: bytes on SPI
+ *         framed by CSN, and the CE pin.
+ *
+ *         Radios share a struct nrf24_emu_air. It keeps the simulated time
+ *         in microseconds, carries frames between radios on the same
+ *         channel, data rate and address, loses them by a per link
+ *         probability and corrupts frames that overlap on a channel, for
+ *         the receivers the overlapping sender reaches.
+ *         Nothing happens between calls: nrf24_emu_air_run() moves time
+ *         forward and runs what the radios do meanwhile.
+ */
+
+#ifndef NRF24_EMU_H
+#define NRF24_EMU_H
+
+#include <stdint.h>
+
+#define NRF24_EMU_NEVER UINT64_MAX
+/* Overlapping frames remembered per frame, more corrupt it everywhere */
+#define NRF24_EMU_OVERLAPS 4
+
+struct nrf24_emu;
+
+/* Radio states, also the buckets of time_in[] */
+enum nrf24_emu_state {
+  NRF24_EMU_DOWN,
+  NRF24_EMU_POWERING,     /**< Tpd2stby after PWR_UP */
+  NRF24_EMU_STANDBY,      /**< Standby-I, or Standby-II with CE high */
+  NRF24_EMU_RX_SETTLE,    /**< 130us to RX */
+  NRF24_EMU_RX,
+  NRF24_EMU_TX_SETTLE,    /**< 130us to TX */
+  NRF24_EMU_TX,           /**< Frame or ACK in the air */
+  NRF24_EMU_ACK_WAIT,     /**< PTX listening for the ACK, up to ARD */
+  NRF24_EMU_ACK_SETTLE,   /**< PRX turning around to send the ACK */
+  NRF24_EMU_STATES
+};
+
+struct nrf24_emu_frame {
+  uint8_t len;
+  uint8_t pipe;           /**< RX: pipe it came in on. TX: ACK payload pipe */
+  uint8_t pid;
+  uint8_t no_ack;         /**< TX: sent with W_TX_PAYLOAD_NO_ACK */
+  uint8_t ack_payload;    /**< TX: written with W_ACK_PAYLOAD */
+  uint8_t sent;           /**< TX: ACK payload sent at least once */
+  uint16_t crc;
+  uint8_t data[32];
+};
+
+/* Counters of one radio */
+struct nrf24_emu_stats {
+  uint32_t frames;        /**< Frames put in the air, retransmissions too */
+  uint32_t retransmits;
+  uint32_t acks;          /**< ACKs sent */
+  uint32_t max_rt;
+  uint32_t received;      /**< Frames put in the RX FIFO */
+  uint32_t duplicates;    /**< Same PID and CRC again: ACKed, not stored */
+  uint32_t overflows;     /**< Dropped on a full RX FIFO, not ACKed */
+  uint32_t lost;          /**< Lost on the link to this radio */
+  uint32_t collisions;    /**< Corrupted by an overlapping frame */
+  uint64_t time_in[NRF24_EMU_STATES]; /**< Microseconds per state */
+};
+
+/* A frame in the air */
+struct nrf24_emu_tx {
+  struct nrf24_emu *from;
+  struct nrf24_emu_tx *next;
+  uint64_t start, end;
+  uint8_t channel, rate, aw, crc, dpl;  /**< Sender's settings */
+  uint8_t address[5];
+  uint8_t ack;            /**< An ACK, from a PRX */
+  struct nrf24_emu *overlap[NRF24_EMU_OVERLAPS];  /**< Senders of the frames it overlapped */
+  uint8_t overlaps;
+  uint8_t corrupt;        /**< Overlapped more frames than fit in overlap[] */
+  struct nrf24_emu_frame frame;
+};
+
+struct nrf24_emu_air {
+  uint64_t now;           /**< Microseconds */
+  struct nrf24_emu *radios;
+  uint32_t seed;          /**< Random state for link losses */
+  /**
+   * Probability in [0, 1] that a frame from @p from does not reach @p to.
+   * NULL loses nothing.
+   */
+  double (*loss)(const struct nrf24_emu *from, const struct nrf24_emu *to);
+  /**
+   * Called when @p radio raises an interrupt flag that CONFIG does not
+   * mask, the falling edge of its IRQ pin. May be NULL.
+   */
+  void (*irq)(struct nrf24_emu *radio);
+  /**
+   * Whether a frame from @p from corrupts what @p to receives at the same
+   * time. NULL: every overlap on the channel does.
+   */
+  int (*interferes)(const struct nrf24_emu *from, const struct nrf24_emu *to);
+  struct nrf24_emu_tx *in_air;    /**< Frames in the air */
+  uint64_t earliest;      /**< No radio has an event before this */
+};
+
+struct nrf24_emu {
+  struct nrf24_emu_air *medium;
+  struct nrf24_emu *next;
+  void *user;             /**< Free for the caller, e.g. the node it belongs to */
+
+  uint8_t regs[0x20];
+  uint8_t address[3][5];  /**< RX_ADDR_P0, RX_ADDR_P1, TX_ADDR */
+  struct nrf24_emu_frame tx[3], rx[3];
+  uint8_t tx_count, rx_count;
+  uint8_t reuse;          /**< REUSE_TX_PL in effect */
+  uint8_t pid;            /**< PID of the last frame loaded */
+  uint8_t last_pid[6];    /**< Per pipe, PID and CRC of the last frame */
+  uint16_t last_crc[6];
+  uint8_t arc;            /**< Retransmissions of the current frame */
+
+  /* Pins and SPI */
+  uint8_t ce, csn;
+  uint8_t command, pos;
+  struct nrf24_emu_frame building;
+
+  enum nrf24_emu_state state;
+  uint64_t next_event;    /**< When the current state ends, or NRF24_EMU_NEVER */
+  uint64_t since;         /**< When the current state began */
+  uint8_t ack_pipe;       /**< PRX: pipe the ACK answers */
+  struct nrf24_emu_tx out;        /**< What this radio sends, in the air in NRF24_EMU_TX */
+
+  struct nrf24_emu_stats stats;
+};
+
+  /**
+   * Empty medium at time 0
+   */
+  void nrf24_emu_air_init(struct nrf24_emu_air *air, uint32_t seed);
+
+  /**
+   * Run the medium up to @p until microseconds
+   */
+  void nrf24_emu_air_run(struct nrf24_emu_air *air, uint64_t until);
+
+  /**
+   * Power-on reset of @p radio, added to @p air
+   */
+  void nrf24_emu_init(struct nrf24_emu *radio, struct nrf24_emu_air *air);
+
+  /**
+   * Exchange a byte on SPI
+   *
+   * @return The byte clocked out, the STATUS register for the command byte
+   */
+  uint8_t nrf24_emu_spi(struct nrf24_emu *radio, uint8_t mosi);
+
+  /**
+   * Set the CSN pin, low to high ends the command
+   */
+  void nrf24_emu_csn(struct nrf24_emu *radio, uint8_t level);
+
+  /**
+   * Set the CE pin
+   */
+  void nrf24_emu_ce(struct nrf24_emu *radio, uint8_t level);
+
+  /**
+   * Level of the active low IRQ pin
+   */
+  uint8_t nrf24_emu_irq(const struct nrf24_emu *radio);
+
+  /**
+   * One SPI command, CSN framed
+   *
+   * @param tx Bytes after the command, NULL sends NOP bytes
+   * @param rx Where to store the bytes clocked out after STATUS, or NULL
+   * @return STATUS
+   */
+  uint8_t nrf24_emu_command(struct nrf24_emu *radio, uint8_t command,
+                            const uint8_t *tx, uint8_t *rx, uint8_t len);
+
+  uint8_t nrf24_emu_read_register(struct nrf24_emu *radio, uint8_t reg);
+  void nrf24_emu_write_register(struct nrf24_emu *radio, uint8_t reg, uint8_t value);
+
+  /**
+   * Airtime of a frame with @p len payload bytes, with the radio's data
+   * rate, address width and CRC
+   */
+  uint32_t nrf24_emu_airtime(const struct nrf24_emu *radio, uint8_t len);
+
+#endif /* NRF24_EMU_H */
@@ -0,0 +1,244 @@
+/* Forwarding rate of a gateway with two radios against one.
+ *
+ * Node 1 runs the driver built with nRF24_RADIOS 2. Node 2, the source,
+ * sends numbered frames to it as fast as its radio acknowledges them, with
+ * its TX FIFO kept full and CE high. Node 3, the sink, listens. The input
+ * callback of radio 0 sends every frame on to the sink:
+ *
+ * - one radio: the sink shares the source's channel, and radio 0 stops
+ *   listening for each frame it forwards;
+ * - two radios: radio 0 keeps listening on the source's channel while
+ *   radio 1 sends on another one.
+ *
+ * Either way frames wait in the RX FIFO of radio 0 while a frame is
+ * forwarded; once it is full the source's frames go unacknowledged and
+ * are retried.
+ *
+ * Source and sink are scripted through their registers from the host
+ * clock's hook, so they run alongside the gateway and take no time. The
+ * run checks that every frame arrives once and in order, and prints the
+ * forwarding rate of both. */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "nRF24_driver.h"
+#include "nRF24L01.h"
+#include "emu-host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GATEWAY_NODE 1
+#define SINK_NODE 3
+#define CHANNEL_IN 76
+#define CHANNEL_OUT 90
+#define FRAMES 1000
+#define PAYLOAD 32
+/* Give up on a run after this long, in microseconds */
+#define TIMEOUT_US 20000000ULL
+
+static const uint8_t pins[nRF24_RADIOS][3] = nRF24_RADIO_PINS;
+
+static struct nrf24_emu_air air;
+static struct nrf24_emu gateway[2], source, sink;
+static int failed;
+
+/* Source and sink, see peers() */
+static int source_next;
+static int sink_next;
+static uint64_t sink_last;
+
+/* The radio the gateway forwards with, and frames the sink did not ACK */
+static const struct radio_driver *out;
+static int relay_failures;
+
+/*---------------------------------------------------------------------------*/
+static void
+check(int ok, const char *scenario, const char *what)
+{
+  if(!ok) {
+    printf("FAIL %s: %s\n", scenario, what);
+    failed = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_address(struct nrf24_emu *r, uint8_t reg, uint8_t node)
+{
+  static const uint8_t net[] = nRF24_NET_ADDRESS;
+  uint8_t address[5];
+
+  address[0] = node;
+  memcpy(&address[1], net, 4);
+  nrf24_emu_command(r, W_REGISTER | reg, address, NULL, 5);
+}
+/*---------------------------------------------------------------------------*/
+/* Settings shared by source and sink, as the driver programs them */
+static void
+peer_setup(struct nrf24_emu *r, uint8_t channel)
+{
+  nrf24_emu_write_register(r, RF_SETUP, 0x06);          // 1Mbps
+  nrf24_emu_write_register(r, RF_CH, channel);
+  nrf24_emu_write_register(r, SETUP_RETR, 0x2f);        // 750us, 15
+  nrf24_emu_write_register(r, RX_PW_P0, PAYLOAD);
+  nrf24_emu_write_register(r, RX_PW_P2, PAYLOAD);
+}
+/*---------------------------------------------------------------------------*/
+/* Runs with every step of the host clock: the medium catches up, then
+ * the source tops up its TX FIFO and the sink empties its RX FIFO */
+static void
+peers(void)
+{
+  uint8_t buf[PAYLOAD];
+  uint8_t status;
+  int seq;
+
+  nrf24_emu_air_run(&air, nRF24_host_us);
+
+  status = nrf24_emu_command(&source, NOP, NULL, NULL, 0);
+  if(status & _BV(MAX_RT)) {
+    // Not dropped: clearing MAX_RT sends the same frame again
+    nrf24_emu_write_register(&source, STATUS, _BV(MAX_RT));
+  }
+  if(status & _BV(TX_DS)) {
+    nrf24_emu_write_register(&source, STATUS, _BV(TX_DS));
+  }
+  while(source_next < FRAMES &&
+        !(nrf24_emu_read_register(&source, FIFO_STATUS) & _BV(FIFO_FULL))) {
+    memset(buf, 0, sizeof(buf));
+    buf[0] = source_next;
+    buf[1] = source_next >> 8;
+    nrf24_emu_command(&source, W_TX_PAYLOAD, buf, NULL, PAYLOAD);
+    source_next++;
+  }
+
+  while(!(nrf24_emu_read_register(&sink, FIFO_STATUS) & _BV(RX_EMPTY))) {
+    nrf24_emu_command(&sink, R_RX_PAYLOAD, NULL, buf, PAYLOAD);
+    seq = buf[0] | buf[1] << 8;
+    if(seq != sink_next) {
+      printf("FAIL frame %d arrived as number %d\n", seq, sink_next);
+      failed = 1;
+    }
+    sink_next = seq + 1;
+    sink_last = air.now;
+  }
+  nrf24_emu_write_register(&sink, STATUS, _BV(RX_DR));
+}
+/*---------------------------------------------------------------------------*/
+/* nRF24_setInput() callback of radio 0 */
+static void
+relay(void)
+{
+  rimeaddr_t dest = rimeaddr_null;
+  uint8_t buf[PAYLOAD];
+  uint8_t len = packetbuf_datalen();
+
+  memcpy(buf, packetbuf_dataptr(), len);
+  dest.u8[0] = SINK_NODE;
+  packetbuf_clear();
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
+  if(out == &nRF24_driver) {
+    // Frames left in the RX FIFO would make send() back off
+    nRF24_stopListening();
+  }
+  if(out->send(buf, len) != RADIO_TX_OK) {
+    relay_failures++;
+  }
+  if(out == &nRF24_driver) {
+    nRF24_startListening();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+setup(int radios)
+{
+  uint8_t i;
+
+  nrf24_emu_air_init(&air, 1);
+  for(i = 0; i < 2; i++) {
+    nrf24_emu_init(&gateway[i], &air);
+  }
+  nrf24_emu_init(&source, &air);
+  nrf24_emu_init(&sink, &air);
+  nrf24_emu_host_bind(&gateway[0]);
+  for(i = 0; i < 2; i++) {
+    nrf24_emu_host_attach(&gateway[i], pins[i][0], pins[i][1], pins[i][2]);
+  }
+
+  rimeaddr_node_addr.u8[0] = GATEWAY_NODE;
+  nRF24_driver.init();
+  nRF24_driver_1.init();
+  nRF24_select(1);
+  nRF24_setChannel(CHANNEL_OUT);
+  nRF24_select(0);
+  out = radios == 2 ? &nRF24_driver_1 : &nRF24_driver;
+  nRF24_setInput(0, relay);
+  nRF24_startListening();
+  // Not scheduled on the host: run to its first yield
+  nRF24_process.thread(&nRF24_process.pt, PROCESS_EVENT_INIT, NULL);
+
+  peer_setup(&source, CHANNEL_IN);
+  write_address(&source, TX_ADDR, GATEWAY_NODE);
+  write_address(&source, RX_ADDR_P0, GATEWAY_NODE);
+  nrf24_emu_write_register(&source, EN_RXADDR, _BV(ERX_P0));
+  nrf24_emu_write_register(&source, CONFIG, _BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP));
+
+  peer_setup(&sink, radios == 2 ? CHANNEL_OUT : CHANNEL_IN);
+  write_address(&sink, RX_ADDR_P1, nRF24_BROADCAST_NODE);
+  nrf24_emu_write_register(&sink, RX_ADDR_P2, SINK_NODE);
+  nrf24_emu_write_register(&sink, EN_RXADDR, _BV(ERX_P2));
+  nrf24_emu_write_register(&sink, CONFIG, _BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP) | _BV(PRIM_RX));
+  nrf24_emu_ce(&sink, 1);
+  nRF24_host_elapse(2000);
+
+  source_next = 0;
+  sink_next = 0;
+  relay_failures = 0;
+  nRF24_host_elapsed = peers;
+  nrf24_emu_ce(&source, 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Forward FRAMES frames, returns the frames per second */
+static double
+forward(const char *scenario, int radios)
+{
+  uint64_t start;
+  double seconds;
+
+  setup(radios);
+  start = air.now;
+  while(sink_next < FRAMES && air.now - start < TIMEOUT_US) {
+    if(nRF24_process.needspoll) {
+      nRF24_process.needspoll = 0;
+      nRF24_process.thread(&nRF24_process.pt, PROCESS_EVENT_POLL, NULL);
+    } else {
+      nRF24_host_elapse(10);
+    }
+  }
+  nRF24_host_elapsed = NULL;
+
+  check(sink_next == FRAMES, scenario, "frames missing at the sink");
+  check(relay_failures == 0, scenario, "frame not acknowledged by the sink");
+  seconds = (sink_last - start) / 1e6;
+  printf("%-12s %4d forwarded %5lu source retx %4lu gateway RX overflows %5.2f ms/frame %6.1f kbit/s\n",
+         scenario, sink_next, (unsigned long)source.stats.retransmits,
+         (unsigned long)gateway[0].stats.overflows, seconds * 1e3 / sink_next,
+         sink_next * PAYLOAD * 8 / seconds / 1e3);
+  return sink_next / seconds;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  double one, two;
+
+  one = forward("one radio", 1);
+  two = forward("two radios", 2);
+  printf("two radios forward %.2f times the frames of one\n", two / one);
+  check(two > 1.5 * one, "two radios", "less than 1.5 times the rate of one radio");
+
+  printf(failed ? "FAILED\n" : "ok\n");
+  return failed;
+}
+/*---------------------------------------------------------------------------*/
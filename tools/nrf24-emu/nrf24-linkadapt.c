@@ -0,0 +1,156 @@
+/* Link adaptation fed by acknowledged unicasts.
+ *
+ * Node 1 runs the driver built with nRF24_LINK_ADAPTATION. Node 2, a radio
+ * scripted through its registers, acknowledges its frames. The link is
+ * perfect, then loses 40% of the frames and ACKs, then is perfect again.
+ * The ARC_CNT and MAX_RT outcome of every send must move node 2 up the
+ * ladder while frames are lost and back down once they are not; the run
+ * checks the step and the SETUP_RETR and RF_SETUP the driver programmed. */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "nRF24_driver.h"
+#include "nRF24L01.h"
+#include "nRF24_nbr.h"
+#include "emu-host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DUT_NODE 1
+#define PEER_NODE 2
+#define FRAMES 100
+#define PAYLOAD 32
+/* The ends of the ladder in nRF24_linkadapt.c, without rate changes */
+#define STEP_FAST 0
+#define STEP_ROBUST 4
+#define ARC_FAST 3
+#define ARC_ROBUST 15
+
+static struct nrf24_emu_air air;
+static struct nrf24_emu dut, peer;
+static double link_loss;
+static int failed;
+
+/*---------------------------------------------------------------------------*/
+static void
+check(int ok, const char *scenario, const char *what)
+{
+  if(!ok) {
+    printf("FAIL %s: %s\n", scenario, what);
+    failed = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static double
+loss(const struct nrf24_emu *from, const struct nrf24_emu *to)
+{
+  return link_loss;
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_address(struct nrf24_emu *r, uint8_t reg, uint8_t node)
+{
+  static const uint8_t net[] = nRF24_NET_ADDRESS;
+  uint8_t address[5];
+
+  address[0] = node;
+  memcpy(&address[1], net, 4);
+  nrf24_emu_command(r, W_REGISTER | reg, address, NULL, 5);
+}
+/*---------------------------------------------------------------------------*/
+/* The peer as the driver would set it up, listening */
+static void
+peer_setup(void)
+{
+  nrf24_emu_write_register(&peer, RF_SETUP, 0x06);          // 1Mbps
+  nrf24_emu_write_register(&peer, RF_CH, 76);
+  nrf24_emu_write_register(&peer, FEATURE, _BV(EN_DYN_ACK));
+  write_address(&peer, RX_ADDR_P1, nRF24_BROADCAST_NODE);
+  nrf24_emu_write_register(&peer, RX_ADDR_P2, PEER_NODE);
+  nrf24_emu_write_register(&peer, RX_PW_P1, PAYLOAD);
+  nrf24_emu_write_register(&peer, RX_PW_P2, PAYLOAD);
+  nrf24_emu_write_register(&peer, EN_RXADDR, _BV(ERX_P1) | _BV(ERX_P2));
+  nrf24_emu_write_register(&peer, CONFIG, _BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP) | _BV(PRIM_RX));
+  nrf24_emu_ce(&peer, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+peer_drain(void)
+{
+  uint8_t buf[PAYLOAD];
+
+  while(!(nrf24_emu_read_register(&peer, FIFO_STATUS) & _BV(RX_EMPTY))) {
+    nrf24_emu_command(&peer, R_RX_PAYLOAD, NULL, buf, PAYLOAD);
+  }
+  nrf24_emu_write_register(&peer, STATUS, _BV(RX_DR));
+}
+/*---------------------------------------------------------------------------*/
+/* Send FRAMES frames to the peer over a link losing @p p of the frames and
+ * ACKs, then check the step it ended on and what the radio is set to */
+static void
+phase(const char *scenario, double p, uint8_t step, uint8_t arc, uint8_t pa)
+{
+  rimeaddr_t dest = rimeaddr_null;
+  uint8_t buf[PAYLOAD];
+  struct nRF24_nbr *n;
+  int i, acked = 0, max_step = 0, min_step = 0xff;
+  uint32_t retx = dut.stats.retransmits;
+
+  link_loss = p;
+  dest.u8[0] = PEER_NODE;
+  for(i = 0; i < FRAMES; i++) {
+    memset(buf, 0, sizeof(buf));
+    buf[0] = i;
+    packetbuf_clear();
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
+    if(nRF24_driver.send(buf, sizeof(buf)) == RADIO_TX_OK) {
+      acked++;
+    }
+    peer_drain();
+    n = nRF24_nbr_lookup(&dest);
+    if(n != NULL) {
+      max_step = rf24_max(max_step, n->step);
+      min_step = rf24_min(min_step, n->step);
+    }
+  }
+
+  n = nRF24_nbr_lookup(&dest);
+  check(n != NULL, scenario, "destination not in the neighbor table");
+  if(n == NULL) {
+    return;
+  }
+  printf("%-16s %4d sent %4d acked %5lu retx  steps %u-%u, ends on %u\n",
+         scenario, FRAMES, acked, (unsigned long)(dut.stats.retransmits - retx),
+         min_step, max_step, n->step);
+  check(n->step == step, scenario, "wrong ladder step");
+  check((nrf24_emu_read_register(&dut, SETUP_RETR) & 0x0f) == arc, scenario,
+        "retry count of the step not programmed");
+  check(((nrf24_emu_read_register(&dut, RF_SETUP) >> RF_PWR_LOW) & 3) == pa, scenario,
+        "PA level of the step not programmed");
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  nrf24_emu_air_init(&air, 5);
+  air.loss = loss;
+  nrf24_emu_init(&dut, &air);
+  nrf24_emu_init(&peer, &air);
+  nrf24_emu_host_bind(&dut);
+
+  rimeaddr_node_addr.u8[0] = DUT_NODE;
+  nRF24_driver.init();
+  peer_setup();
+  nRF24_host_elapse(2000);
+  nRF24_startListening();
+
+  phase("perfect link", 0, STEP_FAST, ARC_FAST, RF24_PA_MIN);
+  phase("40% loss", 0.4, STEP_ROBUST, ARC_ROBUST, RF24_PA_MAX);
+  phase("perfect again", 0, STEP_FAST, ARC_FAST, RF24_PA_MIN);
+
+  printf(failed ? "FAILED\n" : "ok\n");
+  return failed;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,67 @@
+/* The auto retransmit delay of nRF24_esb.h against the datasheet.
+ *
+ * For 5 byte addresses and 16 bit CRC the nRF24L01+ product specification
+ * gives the shortest ARD per data rate and ACK payload length (section
+ * 7.4.2). Every length from 0 to 32 bytes is checked at each rate, and the
+ * model's table is printed. */
+
+#include "contiki.h"
+#include "nRF24_driver.h"
+#include "nRF24_esb.h"
+
+#include <stdio.h>
+
+#define AW 5
+#define CRC 2
+
+static int failed;
+
+/*---------------------------------------------------------------------------*/
+/* Shortest ARD in microseconds the datasheet allows */
+static int
+datasheet_ard_us(rf24_datarate_e rate, int ack_len)
+{
+  switch(rate) {
+  case RF24_2MBPS:
+    return ack_len <= 15 ? 250 : 500;
+  case RF24_1MBPS:
+    return ack_len <= 5 ? 250 : 500;
+  default:
+    // 500us without ACK payload, then 250us more per 8 bytes
+    return ack_len == 0 ? 500 : 500 + 250 * ((ack_len + 7) / 8);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_rate(const char *name, rf24_datarate_e rate)
+{
+  int len, model, sheet;
+
+  printf("%-8s", name);
+  for(len = 0; len <= 32; len++) {
+    model = (nRF24_ESB_ARD(rate, AW, CRC, len) + 1) * 250;
+    sheet = datasheet_ard_us(rate, len);
+    if(len % 4 == 0) {
+      printf(" %2d:%4d", len, model);
+    }
+    if(model != sheet) {
+      printf("\nFAIL %s, %d byte ACK payload: ARD %d us, datasheet %d us\n",
+             name, len, model, sheet);
+      failed = 1;
+    }
+  }
+  printf("\n");
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  printf("ARD in us per ACK payload length, %d byte address, %d byte CRC\n", AW, CRC);
+  check_rate("2Mbps", RF24_2MBPS);
+  check_rate("1Mbps", RF24_1MBPS);
+  check_rate("250Kbps", RF24_250KBPS);
+
+  printf(failed ? "FAILED\n" : "ok\n");
+  return failed;
+}
+/*---------------------------------------------------------------------------*/
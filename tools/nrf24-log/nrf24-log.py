@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Expand the nRF24 driver debug log.
+
+Reads the serial output of a node built with nRF24_LOG (or
+SERIAL_DEBUG_NRF24), from a capture file or a serial device set to raw
+mode, and prints each logged message as text. Records the node dropped
+because its ring was full, and frames lost on the way, are reported where
+they happened and counted at the end.
+"""
+
+import argparse
+import sys
+
+SLIP_END = 0o300
+SLIP_ESC = 0o333
+SLIP_ESC_END = 0o334
+SLIP_ESC_ESC = 0o335
+
+MAGIC = ord('L')
+HEADER_LEN = 3
+
+# rf24_log_e in platform/arduino-nRF24/dev/nRF24_log.h
+MESSAGES = [
+    'write_register(%02x,%02x)',
+    '[Writing %u bytes %u blanks]',
+    '[Reading %u bytes %u blanks]',
+    'FEATURE=%i',
+    'CE pin: %d CSN pin: %d',
+    'RF24 HARDWARE FAIL: Radio not responding, verify pin connections, '
+    'wiring, etc.',
+]
+
+
+def frames(stream):
+    """Yield the SLIP frames in a byte stream, text between them is skipped."""
+    frame = None
+    escaped = False
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            return
+        for c in chunk:
+            if c == SLIP_END:
+                if frame:
+                    yield bytes(frame)
+                frame = bytearray()
+                escaped = False
+            elif frame is None:
+                continue
+            elif escaped:
+                frame.append({SLIP_ESC_END: SLIP_END,
+                              SLIP_ESC_ESC: SLIP_ESC}.get(c, c))
+                escaped = False
+            elif c == SLIP_ESC:
+                escaped = True
+            else:
+                frame.append(c)
+
+
+def expand(message, args):
+    if message >= len(MESSAGES):
+        return 'message %d %s' % (message, ' '.join(str(a) for a in args))
+    try:
+        return MESSAGES[message] % tuple(args)
+    except TypeError:
+        return '%s %r' % (MESSAGES[message], args)
+
+
+def messages(stream, stats):
+    """Yield the text of each record, and a note where records were lost."""
+    sequence = None
+    for frame in frames(stream):
+        if len(frame) < HEADER_LEN or frame[0] != MAGIC:
+            stats['skipped'] += 1
+            continue
+        seq, dropped = frame[1], frame[2]
+        if sequence is not None and seq != (sequence + 1) & 0xff:
+            lost = (seq - sequence - 1) & 0xff
+            stats['lost_frames'] += lost
+            yield '-- %d frames lost' % lost
+        sequence = seq
+        if dropped:
+            stats['dropped'] += dropped
+            yield '-- %d records dropped on the node' % dropped
+        stats['frames'] += 1
+        i = HEADER_LEN
+        while i < len(frame):
+            header = frame[i]
+            count = header >> 6
+            if i + 1 + 2 * count > len(frame):
+                stats['damaged'] += 1
+                break
+            args = [frame[i + 1 + 2 * j] | frame[i + 2 + 2 * j] << 8
+                    for j in range(count)]
+            stats['records'] += 1
+            yield expand(header & 0x3f, args)
+            i += 1 + 2 * count
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('input', nargs='?', default='-',
+                        help='capture file or raw serial device, - for stdin')
+    args = parser.parse_args()
+
+    stream = (sys.stdin.buffer if args.input == '-'
+              else open(args.input, 'rb', buffering=0))
+    stats = {'frames': 0, 'records': 0, 'skipped': 0, 'damaged': 0,
+             'lost_frames': 0, 'dropped': 0}
+    try:
+        for line in messages(stream, stats):
+            print(line, flush=True)
+    except KeyboardInterrupt:
+        pass
+    print('%(records)d records in %(frames)d frames, %(skipped)d skipped '
+          '(text, traces or damaged), %(lost_frames)d frames lost, '
+          '%(dropped)d records dropped on the node' % stats, file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,163 @@
+/* Application of a simulated node: a reading every period, sent to the
+ * parent on the routing tree. Frames from children join the same queue.
+ * The MAC on top of the radio's own retransmissions retries a frame that
+ * got no ACK after a random backoff, doubled per retry, and drops it after
+ * the last retry. The sink only receives. */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/netstack.h"
+#include "nRF24_driver.h"
+#include "sim.h"
+
+PROCESS(app_process, "sim app");
+
+static struct sim_frame queue[SIM_QUEUE_MAX];
+static uint8_t queue_first, queue_count;
+static uint8_t retries;
+static uint8_t backing_off;
+static uint16_t seq;
+static struct etimer reading_timer, backoff_timer;
+
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+ms_to_ticks(uint32_t ms)
+{
+  return (clock_time_t)((ms * CLOCK_SECOND + 999) / 1000);
+}
+/*---------------------------------------------------------------------------*/
+/* Next reading after a period with +-50% jitter */
+static void
+schedule_reading(void)
+{
+  uint32_t period = sim_params()->period_ms;
+
+  etimer_set(&reading_timer,
+             ms_to_ticks(period / 2 + (uint32_t)sim_random() * period / 65536));
+}
+/*---------------------------------------------------------------------------*/
+static void
+enqueue(const struct sim_frame *frame)
+{
+  if(sim_parent() == 0) {
+    sim_dropped(SIM_DROP_NO_ROUTE);
+    return;
+  }
+  if(queue_count == sim_params()->queue) {
+    sim_dropped(SIM_DROP_QUEUE);
+    return;
+  }
+  queue[(queue_first + queue_count) % SIM_QUEUE_MAX] = *frame;
+  queue_count++;
+  process_poll(&app_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+dequeue(void)
+{
+  queue_first = (queue_first + 1) % SIM_QUEUE_MAX;
+  queue_count--;
+  retries = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_queued(void)
+{
+  rimeaddr_t parent;
+  uint16_t backoff;
+
+  while(queue_count > 0 && !backing_off) {
+    packetbuf_clear();
+    rimeaddr_copy(&parent, &rimeaddr_null);
+    parent.u8[0] = sim_parent();
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &parent);
+
+    switch(nRF24_driver.send(&queue[queue_first], sizeof(struct sim_frame))) {
+    case RADIO_TX_OK:
+      dequeue();
+      break;
+    case RADIO_TX_COLLISION:
+      // The frame that came in first is read before the next try
+      process_poll(&app_process);
+      return;
+    default:
+      if(retries == sim_params()->mac_retries) {
+        sim_dropped(SIM_DROP_MAC);
+        dequeue();
+        break;
+      }
+      sim_mac_retry();
+      backoff = sim_params()->backoff_ms << retries;
+      retries++;
+      etimer_set(&backoff_timer,
+                 ms_to_ticks(backoff / 2 + (uint32_t)sim_random() * backoff / 65536));
+      backing_off = 1;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+input(void)
+{
+  struct sim_frame frame;
+
+  if(packetbuf_datalen() < sizeof(frame)) {
+    return;
+  }
+  memcpy(&frame, packetbuf_dataptr(), sizeof(frame));
+  if(frame.type != SIM_FRAME_DATA) {
+    return;
+  }
+  frame.hops++;
+  if(sim_is_sink()) {
+    sim_delivered(&frame);
+  } else {
+    sim_forwarded();
+    enqueue(&frame);
+  }
+}
+/*---------------------------------------------------------------------------*/
+const struct rdc_driver nRF24_host_rdc = { "sim", input };
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(app_process, ev, data)
+{
+  struct sim_frame frame;
+
+  PROCESS_BEGIN();
+
+  nRF24_setChannel(sim_channel());
+  nRF24_startListening();
+  if(!sim_is_sink()) {
+    schedule_reading();
+  }
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+
+    if(ev == PROCESS_EVENT_TIMER && data == &reading_timer) {
+      memset(&frame, 0, sizeof(frame));
+      frame.type = SIM_FRAME_DATA;
+      frame.origin = sim_node();
+      frame.seq = seq++;
+      frame.generated_ms = nRF24_host_us / 1000;
+      sim_generated();
+      enqueue(&frame);
+      schedule_reading();
+    } else if(ev == PROCESS_EVENT_TIMER && data == &backoff_timer) {
+      backing_off = 0;
+    }
+    send_queued();
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+firmware_boot(void)
+{
+  rimeaddr_node_addr.u8[0] = sim_node();
+  nRF24_driver.init();
+  process_start(&app_process, NULL);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,250 @@
+/* Contiki kernel of a simulated node: processes, polls, events, etimers and
+ * one rtimer, on the simulated clock. Its variables are node state like
+ * the driver's, see sim.h.
+ *
+ * A poll nRF24_process makes of itself, to check the RX FIFO again while
+ * listening, waits for the IRQ pin or the node's next wake-up: the node
+ * sleeps as if the IRQ line were wired instead of spinning on the SPI bus,
+ * which would keep every simulated node busy all the time. */
+
+#include "contiki.h"
+#include "sim.h"
+#include "nrf24-emu.h"
+
+#define PROCESSES 8
+#define EVENTS 16
+#define TICK_US (1000000UL / RTIMER_ARCH_SECOND)
+#define CLOCK_TICK_US (1000000UL / CLOCK_SECOND)
+
+PROCESS_NAME(nRF24_process);
+
+static struct process *processes[PROCESSES];
+static uint8_t process_count;
+static struct process *current;
+static uint8_t poll_requested;
+
+static struct {
+  struct process *p;
+  process_event_t ev;
+  process_data_t data;
+} events[EVENTS];
+static uint8_t event_first, event_count;
+
+static struct etimer *timers;
+
+static struct rtimer *rtimer;
+static uint64_t rtimer_due;
+
+/*---------------------------------------------------------------------------*/
+static void
+call(struct process *p, process_event_t ev, process_data_t data)
+{
+  struct process *caller = current;
+
+  current = p;
+  if(p->thread(&p->pt, ev, data) == PT_ENDED) {
+    process_exit(p);
+  }
+  current = caller;
+}
+/*---------------------------------------------------------------------------*/
+static void
+post(struct process *p, process_event_t ev, process_data_t data)
+{
+  if(event_count < EVENTS) {
+    events[(event_first + event_count) % EVENTS].p = p;
+    events[(event_first + event_count) % EVENTS].ev = ev;
+    events[(event_first + event_count) % EVENTS].data = data;
+    event_count++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+poll(struct process *p)
+{
+  if(p->running) {
+    p->needspoll = 1;
+    poll_requested = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+process_start(struct process *p, process_data_t data)
+{
+  if(p->running || process_count == PROCESSES) {
+    return;
+  }
+  processes[process_count++] = p;
+  p->running = 1;
+  p->needspoll = 0;
+  p->pt.lc = 0;
+  call(p, PROCESS_EVENT_INIT, data);
+}
+/*---------------------------------------------------------------------------*/
+void
+process_exit(struct process *p)
+{
+  uint8_t i;
+
+  p->running = 0;
+  for(i = 0; i < process_count; i++) {
+    if(processes[i] == p) {
+      processes[i] = processes[--process_count];
+      break;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+process_poll(struct process *p)
+{
+  if(p == NULL || (p == &nRF24_process && current == p)) {
+    return;
+  }
+  poll(p);
+}
+/*---------------------------------------------------------------------------*/
+static void
+timer_add(struct etimer *et)
+{
+  struct etimer *t;
+
+  for(t = timers; t != NULL; t = t->next) {
+    if(t == et) {
+      return;
+    }
+  }
+  et->next = timers;
+  timers = et;
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_set(struct etimer *et, clock_time_t interval)
+{
+  et->timer.start = clock_time();
+  et->timer.interval = interval;
+  et->p = current;
+  timer_add(et);
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_reset(struct etimer *et)
+{
+  et->timer.start += et->timer.interval;
+  timer_add(et);
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_stop(struct etimer *et)
+{
+  struct etimer **t;
+
+  for(t = &timers; *t != NULL; t = &(*t)->next) {
+    if(*t == et) {
+      *t = et->next;
+      break;
+    }
+  }
+  et->p = NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+etimer_expired(struct etimer *et)
+{
+  return et->p == NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+timers_check(void)
+{
+  struct etimer **t = &timers;
+  struct etimer *et;
+
+  while(*t != NULL) {
+    et = *t;
+    if((clock_time_t)(clock_time() - et->timer.start) >= et->timer.interval) {
+      *t = et->next;
+      if(et->p != NULL && et->p->running) {
+        post(et->p, PROCESS_EVENT_TIMER, et);
+      }
+      et->p = NULL;
+    } else {
+      t = &et->next;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_set(struct rtimer *t, rtimer_clock_t time, rtimer_clock_t duration,
+           rtimer_callback_t func, void *ptr)
+{
+  t->time = time;
+  t->func = func;
+  t->ptr = ptr;
+  rtimer = t;
+  // The 16 bit tick counter wraps, the time is the next one it reaches
+  rtimer_due = nRF24_host_us +
+    (rtimer_clock_t)(time - nRF24_host_us / TICK_US) * TICK_US;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+kernel_run(void)
+{
+  struct rtimer *t;
+  uint8_t i;
+
+  while(1) {
+    if(sim_take_irq()) {
+      poll(&nRF24_process);
+    }
+    if(rtimer != NULL && rtimer_due <= nRF24_host_us) {
+      t = rtimer;
+      rtimer = NULL;
+      t->func(t, t->ptr);
+    }
+    timers_check();
+
+    if(poll_requested) {
+      poll_requested = 0;
+      for(i = 0; i < process_count; i++) {
+        if(processes[i]->needspoll) {
+          processes[i]->needspoll = 0;
+          call(processes[i], PROCESS_EVENT_POLL, NULL);
+        }
+      }
+      continue;
+    }
+    if(event_count > 0) {
+      i = event_first;
+      event_first = (event_first + 1) % EVENTS;
+      event_count--;
+      if(events[i].p->running) {
+        call(events[i].p, events[i].ev, events[i].data);
+      }
+      continue;
+    }
+    return;
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint64_t
+kernel_next_wakeup(void)
+{
+  uint64_t next = rtimer != NULL ? rtimer_due : NRF24_EMU_NEVER;
+  uint64_t due;
+  struct etimer *et;
+
+  for(et = timers; et != NULL; et = et->next) {
+    // Tick of clock_time() the timer expires on
+    due = nRF24_host_us -
+          (nRF24_host_us + nRF24_host_clock_phase) % CLOCK_TICK_US +
+          (uint64_t)(clock_time_t)(et->timer.start + et->timer.interval -
+                                   clock_time()) * CLOCK_TICK_US;
+    if(due < next) {
+      next = due;
+    }
+  }
+  return next;
+}
+/*---------------------------------------------------------------------------*/
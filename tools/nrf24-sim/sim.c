@@ -0,0 +1,761 @@
+/* Discrete-event simulation of many nRF24 nodes running the real driver.
+ * See README.md. */
+
+#include "contiki.h"
+#include "Arduino.h"
+#include "nrf24-emu.h"
+#include "sim.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+/* MCU time per SPI byte at F_CPU / 4, and per digitalWrite() */
+#define SPI_BYTE_US 3
+#define PIN_US 4
+
+#define STACK_SIZE (64 * 1024)
+#define MAX_CLUSTER 253         /* Node bytes 1 to 253, 0 and 0xFF are taken */
+#define BOOT_US 1000000         /* Nodes boot within the first second */
+#define ROUTE_MAX_LOSS 0.3      /* Worse links are not used for routing */
+#define VOLTS 3.0
+/* How far a busy node may run ahead of one that is due. Its SPI commands
+ * reach the radio up to this late, the radio's own timing is exact. */
+#define SKEW_US 50
+
+/* Supply current per radio state in mA, from the datasheet */
+static const double current_ma[NRF24_EMU_STATES] = {
+  [NRF24_EMU_DOWN] = 0.0009,
+  [NRF24_EMU_POWERING] = 0.3,
+  [NRF24_EMU_STANDBY] = 0.026,
+  [NRF24_EMU_RX_SETTLE] = 8.0,
+  [NRF24_EMU_RX] = 13.5,
+  [NRF24_EMU_TX_SETTLE] = 8.0,
+  [NRF24_EMU_TX] = 11.3,
+  [NRF24_EMU_ACK_WAIT] = 13.5,
+  [NRF24_EMU_ACK_SETTLE] = 8.0,
+};
+
+struct node {
+  int index, cluster;
+  uint8_t addr;                 /* Node byte within the cluster */
+  double x, y;
+  struct node *parent;
+  int hops;                     /* On the routing tree */
+  double etx;                   /* Path cost to the sink */
+
+  struct nrf24_emu radio;
+  ucontext_t context;
+  void *stack;
+  uint8_t *state;               /* Its copy of the node_state section */
+  uint64_t wake;                /* When it runs next, NRF24_EMU_NEVER: on IRQ */
+  int slot;                     /* In the heap, -1 if not in it */
+  uint8_t irq;                  /* IRQ pin fell since the kernel looked */
+  uint8_t preempted;            /* Busy in the middle of its code */
+  uint32_t rng;
+  unsigned long clock_phase;    /* Of its clock tick */
+
+  /* Frames it originated */
+  uint32_t generated, delivered, duplicates;
+  uint64_t latency_sum;
+  uint32_t latency_max, hops_sum;
+  uint8_t *seen;                /* Bitmap of the sequence numbers delivered */
+  uint32_t seen_bits;
+  /* Frames it handled */
+  uint32_t forwarded, retries;
+  uint32_t drops[3];
+};
+
+struct cluster {
+  struct node *sink;
+  uint8_t channel;
+  int size;
+  struct node *by_addr[256];
+};
+
+/* The node_state section of the firmware image, see the Makefile */
+extern uint8_t __start_node_state[], __stop_node_state[];
+
+static struct sim_params params = { 60000, 3, 20, 8 };
+static int node_count = 100, cluster_count;
+static double range = 30, interference = 2, degree = 10, seconds = 600;
+static uint32_t seed = 1;
+static const char *csv;
+static int verbose;
+
+static struct node *nodes;
+static struct cluster *clusters;
+static struct nrf24_emu_air air;
+static struct node **heap;
+static int heap_count;
+static struct node *running;
+static ucontext_t scheduler;
+static uint8_t *pristine;
+static size_t state_size;
+
+static uint32_t *latencies;
+static size_t latency_count, latency_size;
+static unsigned long switches;
+
+/*---------------------------------------------------------------------------*/
+static uint32_t
+xorshift(uint32_t *s)
+{
+  *s ^= *s << 13;
+  *s ^= *s >> 17;
+  *s ^= *s << 5;
+  return *s;
+}
+/*---------------------------------------------------------------------------*/
+static double
+uniform(uint32_t *s)
+{
+  return xorshift(s) / 4294967296.0;
+}
+/*---------------------------------------------------------------------------*/
+/* Static per link deviation of the path loss, in [0.8, 1.2] */
+static double
+shadowing(const struct node *a, const struct node *b)
+{
+  uint32_t s = seed * 2654435761u ^
+    (uint32_t)(a->index < b->index ? a->index * 65599 + b->index :
+               b->index * 65599 + a->index);
+
+  xorshift(&s);
+  xorshift(&s);
+  return 0.8 + 0.4 * uniform(&s);
+}
+/*---------------------------------------------------------------------------*/
+static double
+distance(const struct node *a, const struct node *b)
+{
+  return hypot(a->x - b->x, a->y - b->y);
+}
+/*---------------------------------------------------------------------------*/
+static double
+link_loss(const struct node *a, const struct node *b)
+{
+  double d = distance(a, b) * shadowing(a, b) / range;
+
+  if(d > 2) {
+    return 1;
+  }
+  return 1 / (1 + exp(-(d - 1) * 8));
+}
+/*---------------------------------------------------------------------------*/
+static double
+air_loss(const struct nrf24_emu *from, const struct nrf24_emu *to)
+{
+  return link_loss(from->user, to->user);
+}
+/*---------------------------------------------------------------------------*/
+static int
+air_interferes(const struct nrf24_emu *from, const struct nrf24_emu *to)
+{
+  return distance(from->user, to->user) < interference * range;
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_swap(int i, int j)
+{
+  struct node *n = heap[i];
+
+  heap[i] = heap[j];
+  heap[j] = n;
+  heap[i]->slot = i;
+  heap[j]->slot = j;
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_up(int i)
+{
+  while(i > 0 && heap[(i - 1) / 2]->wake > heap[i]->wake) {
+    heap_swap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_down(int i)
+{
+  int child;
+
+  while((child = 2 * i + 1) < heap_count) {
+    if(child + 1 < heap_count && heap[child + 1]->wake < heap[child]->wake) {
+      child++;
+    }
+    if(heap[i]->wake <= heap[child]->wake) {
+      break;
+    }
+    heap_swap(i, child);
+    i = child;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_push(struct node *n)
+{
+  n->slot = heap_count;
+  heap[heap_count++] = n;
+  heap_up(n->slot);
+}
+/*---------------------------------------------------------------------------*/
+static struct node *
+heap_pop(void)
+{
+  struct node *n = heap[0];
+
+  heap_swap(0, --heap_count);
+  heap_down(0);
+  n->slot = -1;
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+/* Run @p n no later than @p when */
+static void
+wake_at(struct node *n, uint64_t when)
+{
+  if(n->slot < 0) {
+    n->wake = when;
+    heap_push(n);
+  } else if(when < n->wake) {
+    n->wake = when;
+    heap_up(n->slot);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+air_irq(struct nrf24_emu *radio)
+{
+  struct node *n = radio->user;
+
+  n->irq = 1;
+  // A node that runs or was preempted sees it when its kernel looks
+  if(n != running && !n->preempted) {
+    wake_at(n, air.now);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The clock moved: the medium follows, and a node that got ahead of others
+ * lets them catch up first */
+static void
+elapsed(void)
+{
+  struct node *n = running;
+
+  if(n != NULL && heap_count > 0 && heap[0]->wake + SKEW_US < nRF24_host_us) {
+    n->wake = nRF24_host_us;
+    n->preempted = 1;
+    nRF24_host_us = air.now;
+    swapcontext(&n->context, &scheduler);
+    n->preempted = 0;
+    return;
+  }
+  nrf24_emu_air_run(&air, nRF24_host_us);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+nRF24_host_spi(uint8_t mosi)
+{
+  nRF24_host_elapse(SPI_BYTE_US);
+  return nrf24_emu_spi(&running->radio, mosi);
+}
+/*---------------------------------------------------------------------------*/
+void
+digitalWrite(uint8_t pin, uint8_t value)
+{
+  nRF24_host_elapse(PIN_US);
+  if(pin == nRF24_CSPIN) {
+    nrf24_emu_csn(&running->radio, value);
+  } else if(pin == nRF24_CEPIN) {
+    nrf24_emu_ce(&running->radio, value);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+pinMode(uint8_t pin, uint8_t mode)
+{
+}
+/*---------------------------------------------------------------------------*/
+const struct sim_params *
+sim_params(void)
+{
+  return &params;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sim_node(void)
+{
+  return running->addr;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sim_parent(void)
+{
+  return running->parent != NULL ? running->parent->addr : 0;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sim_is_sink(void)
+{
+  return clusters[running->cluster].sink == running;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sim_channel(void)
+{
+  return clusters[running->cluster].channel;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+sim_random(void)
+{
+  return xorshift(&running->rng) >> 16;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+sim_take_irq(void)
+{
+  uint8_t irq = running->irq;
+
+  running->irq = 0;
+  return irq;
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_generated(void)
+{
+  running->generated++;
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_forwarded(void)
+{
+  running->forwarded++;
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_dropped(enum sim_drop why)
+{
+  running->drops[why]++;
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_mac_retry(void)
+{
+  running->retries++;
+}
+/*---------------------------------------------------------------------------*/
+void
+sim_delivered(const struct sim_frame *frame)
+{
+  struct node *origin = clusters[running->cluster].by_addr[frame->origin];
+  uint32_t latency;
+
+  if(origin == NULL) {
+    return;
+  }
+  if(frame->seq >= origin->seen_bits) {
+    origin->seen = realloc(origin->seen, 65536 / 8);
+    memset(origin->seen + origin->seen_bits / 8, 0,
+           (65536 - origin->seen_bits) / 8);
+    origin->seen_bits = 65536;
+  }
+  if(origin->seen[frame->seq / 8] & (1 << frame->seq % 8)) {
+    origin->duplicates++;
+    return;
+  }
+  origin->seen[frame->seq / 8] |= 1 << frame->seq % 8;
+
+  latency = (uint32_t)(nRF24_host_us / 1000) - frame->generated_ms;
+  origin->delivered++;
+  origin->latency_sum += latency;
+  if(latency > origin->latency_max) {
+    origin->latency_max = latency;
+  }
+  origin->hops_sum += frame->hops;
+  if(latency_count == latency_size) {
+    latency_size = latency_size ? 2 * latency_size : 4096;
+    latencies = realloc(latencies, latency_size * sizeof(latencies[0]));
+  }
+  latencies[latency_count++] = latency;
+}
+/*---------------------------------------------------------------------------*/
+/* Body of every node's coroutine */
+static void
+node_main(void)
+{
+  struct node *n;
+
+  firmware_boot();
+  while(1) {
+    kernel_run();
+    n = running;
+    if(n->irq) {
+      continue;
+    }
+    n->wake = kernel_next_wakeup();
+    swapcontext(&n->context, &scheduler);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+resume(struct node *n)
+{
+  memcpy(__start_node_state, n->state, state_size);
+  nRF24_host_clock_phase = n->clock_phase;
+  swapcontext(&scheduler, &n->context);
+  memcpy(n->state, __start_node_state, state_size);
+  switches++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+place(void)
+{
+  double side = range * sqrt(M_PI * node_count / degree);
+  int cols = (int)ceil(sqrt(cluster_count));
+  int rows = (cluster_count + cols - 1) / cols;
+  uint32_t rng = seed;
+  struct node *n;
+  double best, d;
+  int i, k;
+
+  for(i = 0; i < node_count; i++) {
+    n = &nodes[i];
+    n->index = i;
+    if(i < cluster_count) {
+      // Sinks in the middle of their part of the area
+      n->x = side * (i % cols + 0.5) / cols;
+      n->y = side * (i / cols + 0.5) / rows;
+      n->cluster = i;
+      clusters[i].size = 1;
+    } else {
+      n->x = side * uniform(&rng);
+      n->y = side * uniform(&rng);
+      // The nearest sink that has room
+      best = INFINITY;
+      for(k = 0; k < cluster_count; k++) {
+        d = distance(n, &nodes[k]);
+        if(d < best && clusters[k].size < MAX_CLUSTER) {
+          best = d;
+          n->cluster = k;
+        }
+      }
+      clusters[n->cluster].size++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Shortest ETX paths to the sink of each cluster, over links within it */
+static void
+route(void)
+{
+  uint8_t *done = calloc(node_count, 1);
+  struct node *n, *m;
+  double loss, cost;
+  int i, j;
+
+  for(i = 0; i < node_count; i++) {
+    nodes[i].etx = i < cluster_count ? 0 : INFINITY;
+    nodes[i].hops = 0;
+  }
+  while(1) {
+    n = NULL;
+    for(i = 0; i < node_count; i++) {
+      if(!done[i] && isfinite(nodes[i].etx) &&
+         (n == NULL || nodes[i].etx < n->etx)) {
+        n = &nodes[i];
+      }
+    }
+    if(n == NULL) {
+      break;
+    }
+    done[n->index] = 1;
+    for(j = 0; j < node_count; j++) {
+      m = &nodes[j];
+      if(done[j] || m->cluster != n->cluster) {
+        continue;
+      }
+      loss = link_loss(m, n);
+      if(loss > ROUTE_MAX_LOSS) {
+        continue;
+      }
+      // Frame and ACK both have to make it
+      cost = n->etx + 1 / ((1 - loss) * (1 - loss));
+      if(cost < m->etx) {
+        m->etx = cost;
+        m->parent = n;
+        m->hops = n->hops + 1;
+      }
+    }
+  }
+  free(done);
+}
+/*---------------------------------------------------------------------------*/
+static void
+setup(void)
+{
+  struct cluster *c;
+  struct node *n;
+  int i;
+
+  nodes = calloc(node_count, sizeof(*nodes));
+  clusters = calloc(cluster_count, sizeof(*clusters));
+  heap = calloc(node_count, sizeof(*heap));
+  place();
+  route();
+  for(i = 0; i < cluster_count; i++) {
+    clusters[i].size = 0;
+  }
+
+  state_size = __stop_node_state - __start_node_state;
+  pristine = malloc(state_size);
+  memcpy(pristine, __start_node_state, state_size);
+
+  nrf24_emu_air_init(&air, seed);
+  air.loss = air_loss;
+  air.interferes = air_interferes;
+  air.irq = air_irq;
+
+  for(i = 0; i < cluster_count; i++) {
+    clusters[i].sink = &nodes[i];
+    clusters[i].channel = (76 + i * (126 / cluster_count)) % 126;
+  }
+  for(i = 0; i < node_count; i++) {
+    n = &nodes[i];
+    c = &clusters[n->cluster];
+    n->addr = ++c->size;
+    c->by_addr[n->addr] = n;
+
+    nrf24_emu_init(&n->radio, &air);
+    n->radio.user = n;
+    n->state = malloc(state_size);
+    memcpy(n->state, pristine, state_size);
+    n->stack = malloc(STACK_SIZE);
+    getcontext(&n->context);
+    n->context.uc_stack.ss_sp = n->stack;
+    n->context.uc_stack.ss_size = STACK_SIZE;
+    n->context.uc_link = NULL;
+    makecontext(&n->context, node_main, 0);
+    n->rng = seed * 2654435761u + i * 40503u + 1;
+    xorshift(&n->rng);
+    n->clock_phase = xorshift(&n->rng) % 1000000;
+    n->slot = -1;
+    wake_at(n, (uint64_t)(uniform(&n->rng) * BOOT_US));
+  }
+  nRF24_host_elapsed = elapsed;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(uint64_t end)
+{
+  uint64_t report = 60000000;
+  struct node *n;
+
+  while(heap_count > 0 && heap[0]->wake <= end) {
+    n = heap_pop();
+    if(n->wake > nRF24_host_us) {
+      nRF24_host_us = n->wake;
+    }
+    running = n;
+    nrf24_emu_air_run(&air, nRF24_host_us);
+    resume(n);
+    running = NULL;
+    if(n->wake != NRF24_EMU_NEVER) {
+      heap_push(n);
+    }
+    if(verbose && nRF24_host_us >= report) {
+      fprintf(stderr, "%llu s\n", nRF24_host_us / 1000000);
+      report += 60000000;
+    }
+  }
+  nRF24_host_us = end;
+  nrf24_emu_air_run(&air, end);
+}
+/*---------------------------------------------------------------------------*/
+static int
+compare(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+/*---------------------------------------------------------------------------*/
+/* Radio energy of @p n in mJ, and the share of time it listened */
+static double
+energy(const struct node *n, double *rx_share)
+{
+  uint64_t time_in[NRF24_EMU_STATES];
+  double mj = 0;
+  int s;
+
+  memcpy(time_in, n->radio.stats.time_in, sizeof(time_in));
+  time_in[n->radio.state] += air.now - n->radio.since;
+  for(s = 0; s < NRF24_EMU_STATES; s++) {
+    mj += current_ma[s] * VOLTS * time_in[s] / 1e6;
+  }
+  *rx_share = (double)time_in[NRF24_EMU_RX] / air.now;
+  return mj;
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_csv(const char *path)
+{
+  FILE *f = fopen(path, "w");
+  struct node *n;
+  double mj, rx;
+  int i;
+
+  if(f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fprintf(f, "node,cluster,channel,addr,x,y,parent,hops,etx,generated,"
+          "delivered,duplicates,pdr,latency_mean_ms,latency_max_ms,"
+          "forwarded,mac_retries,drops_queue,drops_mac,drops_no_route,"
+          "frames,retransmits,max_rt,collisions,lost,energy_mj,rx_share\n");
+  for(i = 0; i < node_count; i++) {
+    n = &nodes[i];
+    mj = energy(n, &rx);
+    fprintf(f, "%d,%d,%u,%u,%.1f,%.1f,%d,%d,%.2f,%u,%u,%u,%.4f,%.1f,%u,"
+            "%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%.1f,%.4f\n",
+            i, n->cluster, clusters[n->cluster].channel, n->addr, n->x, n->y,
+            n->parent != NULL ? n->parent->index : -1, n->hops, n->etx,
+            n->generated, n->delivered, n->duplicates,
+            n->generated ? (double)n->delivered / n->generated : 0,
+            n->delivered ? (double)n->latency_sum / n->delivered : 0,
+            n->latency_max, n->forwarded, n->retries, n->drops[SIM_DROP_QUEUE],
+            n->drops[SIM_DROP_MAC], n->drops[SIM_DROP_NO_ROUTE],
+            n->radio.stats.frames, n->radio.stats.retransmits,
+            n->radio.stats.max_rt, n->radio.stats.collisions,
+            n->radio.stats.lost, mj, rx);
+  }
+  fclose(f);
+}
+/*---------------------------------------------------------------------------*/
+static void
+summary(double wall)
+{
+  unsigned long generated = 0, delivered = 0, duplicates = 0, hops = 0;
+  unsigned long drops[3] = { 0 }, retries = 0, frames = 0, retransmits = 0;
+  unsigned long collisions = 0, lost = 0, unrouted = 0;
+  uint64_t latency = 0;
+  double mj, rx, mj_sum = 0, mj_max = 0, rx_sum = 0;
+  struct node *n;
+  int i, s, max_hops = 0;
+
+  for(i = 0; i < node_count; i++) {
+    n = &nodes[i];
+    generated += n->generated;
+    delivered += n->delivered;
+    duplicates += n->duplicates;
+    latency += n->latency_sum;
+    hops += n->hops_sum;
+    retries += n->retries;
+    for(s = 0; s < 3; s++) {
+      drops[s] += n->drops[s];
+    }
+    frames += n->radio.stats.frames;
+    retransmits += n->radio.stats.retransmits;
+    collisions += n->radio.stats.collisions;
+    lost += n->radio.stats.lost;
+    unrouted += i >= cluster_count && n->parent == NULL;
+    if(n->hops > max_hops) {
+      max_hops = n->hops;
+    }
+    mj = energy(n, &rx);
+    mj_sum += mj;
+    rx_sum += rx;
+    if(mj > mj_max) {
+      mj_max = mj;
+    }
+  }
+  qsort(latencies, latency_count, sizeof(latencies[0]), compare);
+
+  printf("nodes %d  channels %d  simulated %.0f s  wall %.1f s  (%.0fx real time)\n",
+         node_count, cluster_count, seconds, wall, seconds / wall);
+  printf("state %zu bytes per node  context switches %lu\n",
+         state_size, switches);
+  printf("routes: depth max %d  nodes without a route %lu\n", max_hops, unrouted);
+  printf("generated %lu  delivered %lu  PDR %.2f%%  duplicates %lu\n",
+         generated, delivered, generated ? 100.0 * delivered / generated : 0,
+         duplicates);
+  if(latency_count > 0) {
+    printf("latency ms: mean %.1f  p50 %u  p95 %u  max %u  hops mean %.2f\n",
+           (double)latency / delivered, latencies[latency_count / 2],
+           latencies[latency_count * 95 / 100], latencies[latency_count - 1],
+           (double)hops / delivered);
+  }
+  printf("drops: queue %lu  mac %lu  no route %lu  mac retries %lu\n",
+         drops[SIM_DROP_QUEUE], drops[SIM_DROP_MAC], drops[SIM_DROP_NO_ROUTE],
+         retries);
+  printf("radio: frames %lu  retransmits %lu  collisions %lu  lost %lu\n",
+         frames, retransmits, collisions, lost);
+  printf("energy per node: mean %.0f mJ  max %.0f mJ  listening %.1f%%\n",
+         mj_sum / node_count, mj_max, 100 * rx_sum / node_count);
+}
+/*---------------------------------------------------------------------------*/
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [-n nodes] [-t seconds] [-p period] [-c channels]\n"
+          "          [-r range] [-i interference] [-d degree] [-m retries]\n"
+          "          [-b backoff] [-q queue] [-s seed] [-o file.csv] [-v]\n",
+          name);
+  exit(2);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  struct timespec start, stop;
+  double period = params.period_ms / 1000.0;
+  int opt;
+
+  while((opt = getopt(argc, argv, "n:t:p:c:r:i:d:m:b:q:s:o:v")) != -1) {
+    switch(opt) {
+    case 'n': node_count = atoi(optarg); break;
+    case 't': seconds = atof(optarg); break;
+    case 'p': period = atof(optarg); break;
+    case 'c': cluster_count = atoi(optarg); break;
+    case 'r': range = atof(optarg); break;
+    case 'i': interference = atof(optarg); break;
+    case 'd': degree = atof(optarg); break;
+    case 'm': params.mac_retries = atoi(optarg); break;
+    case 'b': params.backoff_ms = atoi(optarg); break;
+    case 'q': params.queue = atoi(optarg); break;
+    case 's': seed = strtoul(optarg, NULL, 0); break;
+    case 'o': csv = optarg; break;
+    case 'v': verbose = 1; break;
+    default: usage(argv[0]);
+    }
+  }
+  if(cluster_count == 0) {
+    cluster_count = (node_count + 199) / 200;
+  }
+  // The etimer of a reading has to fit the 16 bit clock
+  if(node_count < 2 || cluster_count < 1 || cluster_count > node_count ||
+     period < 0.01 || period > 250 || seconds <= 0 || range <= 0 || interference < 0 ||
+     degree <= 0 || node_count > cluster_count * MAX_CLUSTER ||
+     params.queue < 1 || params.queue > SIM_QUEUE_MAX ||
+     seed == 0) {
+    usage(argv[0]);
+  }
+  params.period_ms = period * 1000;
+
+  setup();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  run((uint64_t)(seconds * 1e6));
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  summary(stop.tv_sec - start.tv_sec + (stop.tv_nsec - start.tv_nsec) / 1e9);
+  if(csv != NULL) {
+    write_csv(csv);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
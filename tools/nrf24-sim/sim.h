@@ -0,0 +1,87 @@
+/**
+ * \file
+ *         Interface between the node firmware and the simulator
+ *
+ *         The firmware, firmware/ with the driver, is linked into one
+ *         relocatable object whose variables all live in the node_state
+ *         section. The simulator keeps a copy of that section per node and
+ *         swaps it in before the node runs, the way Cooja runs native
+ *         motes. Everything below sim_ is the simulator's side, the rest
+ *         is in the image and only acts on the node swapped in.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+/* Application frame, the fixed 32 byte payload */
+struct sim_frame {
+  uint8_t type;
+  uint8_t origin;         /**< Node byte of the originator */
+  uint8_t hops;           /**< Links travelled so far */
+  uint8_t reserved;
+  uint32_t generated_ms;  /**< Simulated time of generation */
+  uint16_t seq;
+  uint8_t filler[22];
+};
+
+#define SIM_FRAME_DATA 1
+
+/* Traffic and MAC settings, the same on every node */
+struct sim_params {
+  uint32_t period_ms;     /**< Mean time between readings of a node */
+  uint8_t mac_retries;    /**< Sends after the first one that got no ACK */
+  uint16_t backoff_ms;    /**< Backoff before the first retry, doubled per retry */
+  uint8_t queue;          /**< Forwarding queue length, up to SIM_QUEUE_MAX */
+};
+
+#define SIM_QUEUE_MAX 16
+
+/* Why a frame did not make it to the sink */
+enum sim_drop {
+  SIM_DROP_QUEUE,         /**< Queue full */
+  SIM_DROP_MAC,           /**< No ACK after all retries */
+  SIM_DROP_NO_ROUTE,      /**< No parent */
+};
+
+/* Image: called by the simulator on the node swapped in */
+  /**
+   * Boot: driver init and the application process
+   */
+  void firmware_boot(void);
+
+  /**
+   * Run processes until nothing is left to do at the current time
+   */
+  void kernel_run(void);
+
+  /**
+   * Simulated microseconds of the next timer, NRF24_EMU_NEVER if none
+   */
+  uint64_t kernel_next_wakeup(void);
+
+/* Simulator: called by the image, about the node that runs */
+  const struct sim_params *sim_params(void);
+  uint8_t sim_node(void);         /**< Node byte of the rime address */
+  uint8_t sim_parent(void);       /**< Node byte of the next hop, 0 for none */
+  uint8_t sim_is_sink(void);
+  uint8_t sim_channel(void);
+  uint16_t sim_random(void);
+
+  /**
+   * Whether the IRQ pin fell since the last call
+   */
+  uint8_t sim_take_irq(void);
+
+  void sim_generated(void);
+  void sim_forwarded(void);
+  void sim_dropped(enum sim_drop why);
+  void sim_mac_retry(void);
+
+  /**
+   * The sink received @p frame
+   */
+  void sim_delivered(const struct sim_frame *frame);
+
+#endif /* SIM_H */
@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""Convert the nRF24 sniffer stream into a pcap file.
+
+Reads the serial output of a node built with nRF24_SNIFFER, from a capture
+file or a serial device set to raw mode, and writes every captured frame to
+a pcap file with link type USER0 (147). Each packet is a 4 byte header
+(channel, data rate, preamble, address width of the frame found) and the
+32 bytes the radio received. Frames whose Enhanced ShockBurst CRC checks
+are decoded, the others are noise or truncated.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+SLIP_END = 0o300
+SLIP_ESC = 0o333
+SLIP_ESC_END = 0o334
+SLIP_ESC_ESC = 0o335
+
+MAGIC = ord('S')
+HEADER_LEN = 6
+FRAME_LEN = 32
+RECORD_LEN = 4 + 1 + FRAME_LEN
+WRAP = 1 << 32
+
+LINKTYPE_USER0 = 147
+RATES = ['1M', '2M', '250K']  # rf24_datarate_e
+PREAMBLES = [0xaa, 0x55]      # by pipe
+
+
+def frames(stream):
+    """Yield the SLIP frames in a byte stream, text between them is skipped."""
+    frame = None
+    escaped = False
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            return
+        for c in chunk:
+            if c == SLIP_END:
+                if frame:
+                    yield bytes(frame)
+                frame = bytearray()
+                escaped = False
+            elif frame is None:
+                continue
+            elif escaped:
+                frame.append({SLIP_ESC_END: SLIP_END,
+                              SLIP_ESC_ESC: SLIP_ESC}.get(c, c))
+                escaped = False
+            elif c == SLIP_ESC:
+                escaped = True
+            else:
+                frame.append(c)
+
+
+def records(stream, stats):
+    """Yield (ticks, tick_us, channel, rate, pipe, data) per captured frame."""
+    sequence = None
+    for frame in frames(stream):
+        if (len(frame) < HEADER_LEN or frame[0] != MAGIC or
+                (len(frame) - HEADER_LEN) % RECORD_LEN):
+            stats['skipped'] += 1
+            continue
+        seq, dropped, tick_us, channel, rate = frame[1:HEADER_LEN]
+        if sequence is not None and seq != (sequence + 1) & 0xff:
+            stats['lost_banks'] += (seq - sequence - 1) & 0xff
+        sequence = seq
+        stats['banks'] += 1
+        stats['dropped'] += dropped
+        for i in range(HEADER_LEN, len(frame), RECORD_LEN):
+            ticks = struct.unpack_from('<I', frame, i)[0]
+            yield (ticks, tick_us, channel, rate, frame[i + 4],
+                   frame[i + 5:i + RECORD_LEN])
+
+
+def bits(data, start, count):
+    """Integer of count bits from bit start, MSB first as on air."""
+    value = 0
+    for i in range(start, start + count):
+        value = value << 1 | (data[i >> 3] >> (7 - (i & 7))) & 1
+    return value
+
+
+def crc(data, count, width):
+    """nRF24 CRC of the first count bits: CCITT for 16 bits, 0x07 for 8."""
+    poly, value = (0x1021, 0xffff) if width == 16 else (0x07, 0xff)
+    top = 1 << (width - 1)
+    mask = (1 << width) - 1
+    for i in range(count):
+        bit = (data[i >> 3] >> (7 - (i & 7))) & 1
+        value = ((value << 1) ^ (poly if bool(value & top) != bool(bit)
+                                 else 0)) & mask
+    return value
+
+
+def decode(data, widths, payload, crc_width):
+    """Find an Enhanced ShockBurst frame at the start of data.
+
+    Returns (address, length, pid, no_ack, payload) or None. The length comes
+    from the packet control field with dynamic payloads, or is the fixed
+    payload size. The shortest frame that checks wins: the CRC of a frame
+    followed by its CRC is zero, so longer reads padded with zeros check too.
+    """
+    candidates = []
+    for width in widths:
+        length = bits(data, width * 8, 6)
+        for n in {length, payload} - {0}:
+            covered = width * 8 + 9 + n * 8
+            if n <= 32 and covered + crc_width <= FRAME_LEN * 8:
+                candidates.append((covered, width, n))
+    for covered, width, n in sorted(candidates):
+        if crc(data, covered, crc_width) == bits(data, covered, crc_width):
+            start = width * 8 + 9
+            body = bytes(bits(data, start + j * 8, 8) for j in range(n))
+            return (data[:width], n, bits(data, width * 8 + 6, 2),
+                    bits(data, width * 8 + 8, 1), body)
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('input', nargs='?', default='-',
+                        help='capture file or raw serial device, - for stdin')
+    parser.add_argument('-o', '--output', default='-',
+                        help='pcap file to write, - for stdout')
+    parser.add_argument('-w', '--width', type=int, action='append',
+                        choices=[3, 4, 5],
+                        help='address width to look for, default all')
+    parser.add_argument('-l', '--payload', type=int, default=32,
+                        help='fixed payload size of the network')
+    parser.add_argument('-c', '--crc', type=int, default=16, choices=[8, 16],
+                        help='CRC length of the network')
+    parser.add_argument('-V', '--valid', action='store_true',
+                        help='only write frames whose CRC checks')
+    parser.add_argument('-b', '--boot', action='store_true',
+                        help='timestamps from the node boot instead of '
+                        'the host clock at the first frame')
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help='print the frames decoded on stderr')
+    args = parser.parse_args()
+
+    stream = (sys.stdin.buffer if args.input == '-'
+              else open(args.input, 'rb', buffering=0))
+    out = (sys.stdout.buffer if args.output == '-'
+           else open(args.output, 'wb'))
+    widths = args.width or [3, 4, 5]
+    stats = {'banks': 0, 'skipped': 0, 'lost_banks': 0, 'dropped': 0,
+             'frames': 0, 'valid': 0}
+    out.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535,
+                          LINKTYPE_USER0))
+
+    last = None
+    us = 0
+    origin = None
+    try:
+        for ticks, tick_us, channel, rate, pipe, data in records(stream,
+                                                                 stats):
+            # Extend the 32 bit tick count across its wrap
+            if last is not None:
+                us += ((ticks - last) % WRAP) * tick_us
+            last = ticks
+            if origin is None:
+                origin = 0 if args.boot else time.time() * 1e6 - us
+            stats['frames'] += 1
+
+            found = decode(data, widths, args.payload, args.crc)
+            if found:
+                stats['valid'] += 1
+                if args.verbose:
+                    address, n, pid, no_ack, body = found
+                    print('%.6f ch %d %s addr %s pid %d%s len %d: %s' % (
+                        us / 1e6, channel, RATES[rate] if rate < 3 else rate,
+                        address[::-1].hex(), pid, ' no_ack' if no_ack else '',
+                        n, body.hex()), file=sys.stderr)
+            elif args.valid:
+                continue
+
+            stamp = int(origin + us)
+            packet = bytes([channel, rate, PREAMBLES[pipe & 1],
+                            len(found[0]) if found else 0]) + data
+            out.write(struct.pack('<IIII', stamp // 1000000, stamp % 1000000,
+                                  len(packet), len(packet)) + packet)
+            out.flush()
+    except KeyboardInterrupt:
+        pass
+
+    print('%(frames)d frames, %(valid)d with a valid CRC, %(banks)d banks, '
+          '%(skipped)d skipped (text or damaged), %(lost_banks)d lost, '
+          '%(dropped)d frames dropped on the node' % stats, file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,60 @@
+/* Host clock: simulated time in microseconds. It only advances when read
+ * or waited for, one rtimer tick per read lets the driver's polling loops
+ * end. */
+
+#include "contiki.h"
+#include "Arduino.h"
+
+#define TICK_US (1000000UL / RTIMER_ARCH_SECOND)
+
+unsigned long long nRF24_host_us;
+void (*nRF24_host_elapsed)(void);
+unsigned long nRF24_host_clock_phase;
+
+/*---------------------------------------------------------------------------*/
+void
+nRF24_host_elapse(unsigned long us)
+{
+  nRF24_host_us += us;
+  if(nRF24_host_elapsed != NULL) {
+    nRF24_host_elapsed();
+  }
+}
+/*---------------------------------------------------------------------------*/
+rtimer_clock_t
+rtimer_arch_now(void)
+{
+  nRF24_host_elapse(TICK_US);
+  return nRF24_host_us / TICK_US;
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t
+clock_time(void)
+{
+  return (nRF24_host_us + nRF24_host_clock_phase) / (1000000UL / CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+clock_seconds(void)
+{
+  return (nRF24_host_us + nRF24_host_clock_phase) / 1000000UL;
+}
+/*---------------------------------------------------------------------------*/
+void
+clock_delay_usec(uint16_t us)
+{
+  nRF24_host_elapse(us);
+}
+/*---------------------------------------------------------------------------*/
+void
+clock_delay_msec(uint16_t ms)
+{
+  nRF24_host_elapse(ms * 1000UL);
+}
+/*---------------------------------------------------------------------------*/
+void
+delayMicroseconds(unsigned int us)
+{
+  nRF24_host_elapse(us);
+}
+/*---------------------------------------------------------------------------*/
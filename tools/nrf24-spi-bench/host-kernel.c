@@ -0,0 +1,58 @@
+/* Host kernel: processes are started but never scheduled, the benchmark
+ * calls the driver API directly, and frames handed up by the driver are
+ * counted */
+
+#include "contiki.h"
+#include "net/netstack.h"
+
+unsigned long nRF24_host_rdc_frames;
+
+/*---------------------------------------------------------------------------*/
+int
+rtimer_set(struct rtimer *t, rtimer_clock_t time, rtimer_clock_t duration,
+           rtimer_callback_t func, void *ptr)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_set(struct etimer *et, clock_time_t interval)
+{
+  et->timer.start = clock_time();
+  et->timer.interval = interval;
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_reset(struct etimer *et)
+{
+  et->timer.start += et->timer.interval;
+}
+/*---------------------------------------------------------------------------*/
+void
+process_start(struct process *p, process_data_t data)
+{
+  p->running = 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+process_exit(struct process *p)
+{
+  p->running = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+process_poll(struct process *p)
+{
+  if(p != NULL && p->running) {
+    p->needspoll = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+rdc_input(void)
+{
+  nRF24_host_rdc_frames++;
+}
+/*---------------------------------------------------------------------------*/
+const struct rdc_driver nRF24_host_rdc = { "host", rdc_input };
+/*---------------------------------------------------------------------------*/
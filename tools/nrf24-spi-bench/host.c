@@ -0,0 +1,90 @@
+/* Host runtime for the driver: registers, addresses and packetbuf */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "dev/spi.h"
+
+#include <string.h>
+
+volatile uint8_t SREG, SPCR, SPSR, SPDR;
+unsigned char spi_busy;
+
+rimeaddr_t rimeaddr_node_addr;
+const rimeaddr_t rimeaddr_null;
+
+static uint8_t packetbuf[PACKETBUF_SIZE];
+static uint16_t packetbuf_len;
+static packetbuf_attr_t attrs[PACKETBUF_ATTR_MAX];
+static rimeaddr_t addrs[2];
+
+/*---------------------------------------------------------------------------*/
+void
+spi_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+rimeaddr_copy(rimeaddr_t *dest, const rimeaddr_t *from)
+{
+  *dest = *from;
+}
+/*---------------------------------------------------------------------------*/
+int
+rimeaddr_cmp(const rimeaddr_t *addr1, const rimeaddr_t *addr2)
+{
+  return memcmp(addr1, addr2, sizeof(rimeaddr_t)) == 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+packetbuf_clear(void)
+{
+  packetbuf_len = 0;
+  memset(attrs, 0, sizeof(attrs));
+  memset(addrs, 0, sizeof(addrs));
+}
+/*---------------------------------------------------------------------------*/
+void *
+packetbuf_dataptr(void)
+{
+  return packetbuf;
+}
+/*---------------------------------------------------------------------------*/
+void
+packetbuf_set_datalen(uint16_t len)
+{
+  packetbuf_len = len;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+packetbuf_datalen(void)
+{
+  return packetbuf_len;
+}
+/*---------------------------------------------------------------------------*/
+int
+packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val)
+{
+  attrs[type] = val;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+packetbuf_attr_t
+packetbuf_attr(uint8_t type)
+{
+  return attrs[type];
+}
+/*---------------------------------------------------------------------------*/
+int
+packetbuf_set_addr(uint8_t type, const rimeaddr_t *addr)
+{
+  rimeaddr_copy(&addrs[type - PACKETBUF_ADDR_SENDER], addr);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+const rimeaddr_t *
+packetbuf_addr(uint8_t type)
+{
+  return &addrs[type - PACKETBUF_ADDR_SENDER];
+}
+/*---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
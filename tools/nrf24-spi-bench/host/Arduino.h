@@ -0,0 +1,24 @@
+/* Host stand-in for the Arduino core: the GPIO writes go to the mock */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include "avr/io.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define SS 10
+#define MOSI 11
+#define MISO 12
+#define SCK 13
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void delayMicroseconds(unsigned int us);
+
+#endif /* Arduino_h */
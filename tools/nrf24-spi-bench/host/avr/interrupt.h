@@ -0,0 +1,6 @@
+/* Host stand-in, nothing interrupts the benchmark */
+#include "avr/io.h"
+
+#define cli() ((void)0)
+#define sei() ((void)0)
+#define ISR(vector) void vector(void)
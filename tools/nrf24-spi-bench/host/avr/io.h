@@ -0,0 +1,18 @@
+/* Host stand-in: the registers the driver and avr-spi.h touch are plain
+ * variables, SPI transfers go to nRF24_host_spi() instead */
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t SREG, SPCR, SPSR, SPDR;
+
+#define SPIF 7
+#define SPE 6
+#define DORD 5
+#define MSTR 4
+
+#endif /* _AVR_IO_H_ */
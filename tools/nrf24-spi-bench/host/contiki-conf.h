@@ -0,0 +1,30 @@
+/* Host stand-in for platform/arduino-nRF24/contiki-conf.h: the radio
+ * settings come from the real platform-conf.h, the rest is what the driver
+ * needs to compile on Linux. */
+
+#ifndef __CONTIKI_CONF_H__
+#define __CONTIKI_CONF_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define F_CPU 16000000UL
+
+#include "dev/rs232.h"
+#define SLIP_PORT RS232_PORT_0
+#define SLIP_BAUD USART_BAUD_115200
+#define USART_PORT RS232_PORT_0
+#define USART_BAUD USART_BAUD_9600
+
+#include "platform-conf.h"
+
+#define RTIMER_ARCH_PRESCALER 64UL
+
+#define CCIF
+#define CLIF
+
+typedef unsigned short clock_time_t;
+
+#endif /* __CONTIKI_CONF_H__ */
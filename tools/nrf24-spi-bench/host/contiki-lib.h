@@ -0,0 +1,2 @@
+/* Host stand-in, the driver uses no Contiki library module */
+#include "contiki.h"
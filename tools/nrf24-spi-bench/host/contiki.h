@@ -0,0 +1,116 @@
+/* Host stand-in for the parts of the Contiki core the driver uses. In
+ * host-kernel.c processes are started but never scheduled, the benchmark
+ * calls the driver API directly; tools/nrf24-sim brings a kernel that runs
+ * them. Time only moves when it is read, see host-clock.c. */
+
+#ifndef CONTIKI_H
+#define CONTIKI_H
+
+#include "contiki-conf.h"
+#include "avr/io.h"
+
+/* Clock and rtimer */
+#define CLOCK_SECOND CLOCK_CONF_SECOND
+#define CLOCK_LT(a, b) ((signed short)((a)-(b)) < 0)
+clock_time_t clock_time(void);
+unsigned long clock_seconds(void);
+void clock_delay_usec(uint16_t us);
+void clock_delay_msec(uint16_t ms);
+
+typedef unsigned short rtimer_clock_t;
+struct rtimer;
+typedef void (*rtimer_callback_t)(struct rtimer *t, void *ptr);
+struct rtimer {
+  rtimer_clock_t time;
+  rtimer_callback_t func;
+  void *ptr;
+};
+#define RTIMER_ARCH_SECOND (F_CPU / RTIMER_ARCH_PRESCALER)
+#define RTIMER_SECOND RTIMER_ARCH_SECOND
+#define RTIMER_NOW() rtimer_arch_now()
+#define RTIMER_CLOCK_LT(a, b) ((signed short)((a)-(b)) < 0)
+rtimer_clock_t rtimer_arch_now(void);
+int rtimer_set(struct rtimer *t, rtimer_clock_t time, rtimer_clock_t duration,
+               rtimer_callback_t func, void *ptr);
+
+struct timer {
+  clock_time_t start, interval;
+};
+struct process;
+struct etimer {
+  struct timer timer;
+  struct etimer *next;
+  struct process *p;
+};
+void etimer_set(struct etimer *et, clock_time_t interval);
+void etimer_reset(struct etimer *et);
+void etimer_stop(struct etimer *et);
+int etimer_expired(struct etimer *et);
+
+/* Protothreads, as in sys/pt.h with the switch based local continuations */
+struct pt {
+  unsigned short lc;
+};
+typedef unsigned char process_event_t;
+typedef void *process_data_t;
+
+struct process {
+  const char *name;
+  char (*thread)(struct pt *, process_event_t, process_data_t);
+  struct pt pt;
+  unsigned char running, needspoll;
+};
+
+#define PT_WAITING 0
+#define PT_YIELDED 1
+#define PT_EXITED 2
+#define PT_ENDED 3
+
+#define PROCESS_EVENT_INIT 0x81
+#define PROCESS_EVENT_POLL 0x82
+#define PROCESS_EVENT_TIMER 0x88
+
+#define PROCESS_NAME(name) extern struct process name
+#define PROCESS(name, strname)                                          \
+  static char process_thread_##name(struct pt *process_pt,              \
+                                    process_event_t ev,                 \
+                                    process_data_t data);               \
+  struct process name = { strname, process_thread_##name }
+#define PROCESS_THREAD(name, ev, data)                                  \
+  static char process_thread_##name(struct pt *process_pt,              \
+                                    process_event_t ev,                 \
+                                    process_data_t data)
+
+#define PROCESS_BEGIN() { char yielded = 1; (void)yielded;              \
+    switch(process_pt->lc) { case 0:
+#define PROCESS_END() } process_pt->lc = 0; return PT_ENDED; }
+#define PROCESS_YIELD_UNTIL(c)                                          \
+  do {                                                                  \
+    yielded = 0;                                                        \
+    process_pt->lc = __LINE__; case __LINE__:                           \
+    if(yielded == 0 || !(c)) {                                          \
+      return PT_YIELDED;                                                \
+    }                                                                   \
+  } while(0)
+#define PROCESS_YIELD() PROCESS_YIELD_UNTIL(1)
+#define PROCESS_WAIT_EVENT() PROCESS_YIELD()
+#define PROCESS_WAIT_EVENT_UNTIL(c) PROCESS_YIELD_UNTIL(c)
+
+void process_start(struct process *p, process_data_t data);
+void process_exit(struct process *p);
+void process_poll(struct process *p);
+
+/* Host time, see host-clock.c. nRF24_host_elapsed, if set, runs each time the
+ * clock moves. clock_time() counts from nRF24_host_clock_phase
+ * microseconds before time 0, so that simulated nodes do not tick
+ * together. */
+extern unsigned long long nRF24_host_us;
+extern void (*nRF24_host_elapsed)(void);
+extern unsigned long nRF24_host_clock_phase;
+void nRF24_host_elapse(unsigned long us);
+
+/* Energest */
+#define ENERGEST_ON(type) ((void)0)
+#define ENERGEST_OFF(type) ((void)0)
+
+#endif /* CONTIKI_H */
@@ -0,0 +1,26 @@
+/* Host copy of core/dev/radio.h */
+
+#ifndef __RADIO_H__
+#define __RADIO_H__
+
+struct radio_driver {
+  int (* init)(void);
+  int (* prepare)(const void *payload, unsigned short payload_len);
+  int (* transmit)(unsigned short transmit_len);
+  int (* send)(const void *payload, unsigned short payload_len);
+  int (* read)(void *buf, unsigned short buf_len);
+  int (* channel_clear)(void);
+  int (* receiving_packet)(void);
+  int (* pending_packet)(void);
+  int (* on)(void);
+  int (* off)(void);
+};
+
+enum {
+  RADIO_TX_OK,
+  RADIO_TX_ERR,
+  RADIO_TX_COLLISION,
+  RADIO_TX_NOACK,
+};
+
+#endif /* __RADIO_H__ */
@@ -0,0 +1,4 @@
+/* Host stand-in for cpu/avr/dev/rs232.h, only the constants */
+#define RS232_PORT_0 0
+#define USART_BAUD_9600 103
+#define USART_BAUD_115200 8
@@ -0,0 +1,3 @@
+/* Host stand-in for core/dev/spi.h */
+extern unsigned char spi_busy;
+void spi_init(void);
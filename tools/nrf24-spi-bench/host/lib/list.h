@@ -0,0 +1,76 @@
+/* Host stand-in for core/lib/list.h: the calls of nRF24_nbr.c, inline.
+ * As in Contiki, an item's first member is its next pointer. */
+
+#ifndef __LIST_H__
+#define __LIST_H__
+
+#include <stddef.h>
+
+#define LIST_CONCAT2(s1, s2) s1##s2
+#define LIST_CONCAT(s1, s2) LIST_CONCAT2(s1, s2)
+#define LIST(name) \
+  static void *LIST_CONCAT(name, _list) = NULL; \
+  static list_t name = (list_t)&LIST_CONCAT(name, _list)
+
+typedef void **list_t;
+
+struct list {
+  struct list *next;
+};
+
+static inline void
+list_init(list_t list)
+{
+  *list = NULL;
+}
+
+static inline void *
+list_head(list_t list)
+{
+  return *list;
+}
+
+static inline void *
+list_item_next(void *item)
+{
+  return item == NULL ? NULL : ((struct list *)item)->next;
+}
+
+static inline void
+list_remove(list_t list, void *item)
+{
+  struct list **l;
+
+  for(l = (struct list **)list; *l != NULL; l = &(*l)->next) {
+    if(*l == item) {
+      *l = (*l)->next;
+      return;
+    }
+  }
+}
+
+static inline void
+list_push(list_t list, void *item)
+{
+  list_remove(list, item);
+  ((struct list *)item)->next = *list;
+  *list = item;
+}
+
+/* Remove and return the last item */
+static inline void *
+list_chop(list_t list)
+{
+  struct list **l;
+  struct list *last;
+
+  if(*list == NULL) {
+    return NULL;
+  }
+  for(l = (struct list **)list; (*l)->next != NULL; l = &(*l)->next);
+  last = *l;
+  *l = NULL;
+  return last;
+}
+
+#endif /* __LIST_H__ */
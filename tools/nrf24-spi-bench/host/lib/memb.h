@@ -0,0 +1,45 @@
+/* Host stand-in for core/lib/memb.h: a fixed pool of blocks, inline */
+
+#ifndef __MEMB_H__
+#define __MEMB_H__
+
+#include <string.h>
+
+#define MEMB_CONCAT2(s1, s2) s1##s2
+#define MEMB_CONCAT(s1, s2) MEMB_CONCAT2(s1, s2)
+#define MEMB(name, structure, num) \
+  static char MEMB_CONCAT(name, _memb_count)[num]; \
+  static structure MEMB_CONCAT(name, _memb_mem)[num]; \
+  static struct memb name = { sizeof(structure), num, \
+                              MEMB_CONCAT(name, _memb_count), \
+                              (void *)MEMB_CONCAT(name, _memb_mem) }
+
+struct memb {
+  unsigned short size;
+  unsigned short num;
+  char *count;
+  void *mem;
+};
+
+static inline void
+memb_init(struct memb *m)
+{
+  memset(m->count, 0, m->num);
+  memset(m->mem, 0, (size_t)m->size * m->num);
+}
+
+static inline void *
+memb_alloc(struct memb *m)
+{
+  int i;
+
+  for(i = 0; i < m->num; i++) {
+    if(m->count[i] == 0) {
+      m->count[i] = 1;
+      return (char *)m->mem + (size_t)i * m->size;
+    }
+  }
+  return NULL;
+}
+
+#endif /* __MEMB_H__ */
@@ -0,0 +1,17 @@
+/* Host stand-in for core/net/netstack.h: frames the driver reads end up in
+ * a counting RDC input */
+
+#ifndef NETSTACK_H
+#define NETSTACK_H
+
+#include "dev/radio.h"
+
+struct rdc_driver {
+  char *name;
+  void (* input)(void);
+};
+
+extern const struct rdc_driver nRF24_host_rdc;
+#define NETSTACK_RDC nRF24_host_rdc
+
+#endif /* NETSTACK_H */
@@ -0,0 +1,31 @@
+/* Host stand-in for core/net/packetbuf.h: one buffer, the attributes the
+ * driver sets and the receiver address */
+
+#ifndef __PACKETBUF_H__
+#define __PACKETBUF_H__
+
+#include <stdint.h>
+#include "net/rime/rimeaddr.h"
+
+#define PACKETBUF_SIZE 128
+
+typedef uint16_t packetbuf_attr_t;
+
+enum {
+  PACKETBUF_ATTR_LINK_QUALITY,
+  PACKETBUF_ATTR_TIMESTAMP,
+  PACKETBUF_ATTR_MAX,
+  PACKETBUF_ADDR_SENDER,
+  PACKETBUF_ADDR_RECEIVER,
+};
+
+void packetbuf_clear(void);
+void *packetbuf_dataptr(void);
+void packetbuf_set_datalen(uint16_t len);
+uint16_t packetbuf_datalen(void);
+int packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val);
+packetbuf_attr_t packetbuf_attr(uint8_t type);
+int packetbuf_set_addr(uint8_t type, const rimeaddr_t *addr);
+const rimeaddr_t *packetbuf_addr(uint8_t type);
+
+#endif /* __PACKETBUF_H__ */
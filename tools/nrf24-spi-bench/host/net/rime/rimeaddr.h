@@ -0,0 +1,18 @@
+/* Host stand-in for core/net/rime/rimeaddr.h */
+
+#ifndef __RIMEADDR_H__
+#define __RIMEADDR_H__
+
+#define RIMEADDR_SIZE 2
+
+typedef union {
+  unsigned char u8[RIMEADDR_SIZE];
+} rimeaddr_t;
+
+void rimeaddr_copy(rimeaddr_t *dest, const rimeaddr_t *from);
+int rimeaddr_cmp(const rimeaddr_t *addr1, const rimeaddr_t *addr2);
+
+extern rimeaddr_t rimeaddr_node_addr;
+extern const rimeaddr_t rimeaddr_null;
+
+#endif /* __RIMEADDR_H__ */
@@ -0,0 +1,289 @@
+#include "mock-spi.h"
+#include "contiki-conf.h"
+#include "avr/io.h"
+#include "nRF24L01.h"
+
+#include <string.h>
+
+#define FIFO_DEPTH 3
+
+struct frame {
+  uint8_t pipe;
+  uint8_t len;
+  uint8_t ack;          /**< TX: waits for an ACK */
+  uint8_t data[32];
+};
+
+static uint8_t regs[0x20];
+static uint8_t address[3][5];   /* RX_ADDR_P0, RX_ADDR_P1, TX_ADDR */
+static struct frame tx[FIFO_DEPTH], rx[FIFO_DEPTH];
+static uint8_t tx_count, rx_count;
+static uint8_t fail_tx;
+
+static uint8_t ce, csn = 1;
+static uint8_t command;
+static uint8_t pos;             /* Bytes of the transaction so far */
+static struct frame building;
+
+static struct nRF24_mock_counts counts;
+static struct nRF24_mock_transaction history[MOCK_LOG_SIZE];
+static uint16_t logged;
+
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+address_of(uint8_t reg)
+{
+  switch(reg) {
+  case RX_ADDR_P0:
+    return address[0];
+  case RX_ADDR_P1:
+    return address[1];
+  case TX_ADDR:
+    return address[2];
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+status(void)
+{
+  return (regs[STATUS] & (_BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT))) |
+         (rx_count ? rx[0].pipe : 7) << RX_P_NO |
+         (tx_count == FIFO_DEPTH ? _BV(TX_FULL) : 0);
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+fifo_status(void)
+{
+  return (tx_count == FIFO_DEPTH ? _BV(FIFO_FULL) : 0) |
+         (tx_count == 0 ? _BV(TX_EMPTY) : 0) |
+         (rx_count == FIFO_DEPTH ? _BV(RX_FULL) : 0) |
+         (rx_count == 0 ? _BV(RX_EMPTY) : 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+pop(struct frame *fifo, uint8_t *count)
+{
+  if(*count > 0) {
+    memmove(&fifo[0], &fifo[1], (*count - 1) * sizeof(fifo[0]));
+    (*count)--;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Send what the TX FIFO holds, if the radio is in TX mode */
+static void
+transmit(void)
+{
+  while(ce && tx_count > 0 && (regs[CONFIG] & _BV(PWR_UP)) &&
+        !(regs[CONFIG] & _BV(PRIM_RX)) && !(regs[STATUS] & _BV(MAX_RT))) {
+    if(tx[0].ack && fail_tx > 0) {
+      // The frame stays for REUSE_TX_PL or FLUSH_TX
+      fail_tx--;
+      regs[STATUS] |= _BV(MAX_RT);
+      regs[OBSERVE_TX] = (regs[SETUP_RETR] & 0x0f) << ARC_CNT;
+      return;
+    }
+    regs[STATUS] |= _BV(TX_DS);
+    regs[OBSERVE_TX] = 0;
+    pop(tx, &tx_count);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+nRF24_mock_reset(void)
+{
+  uint8_t i;
+
+  memset(regs, 0, sizeof(regs));
+  regs[CONFIG] = 0x08;
+  regs[EN_AA] = 0x3f;
+  regs[EN_RXADDR] = 0x03;
+  regs[SETUP_AW] = 0x03;
+  regs[SETUP_RETR] = 0x03;
+  regs[RF_CH] = 0x02;
+  regs[RF_SETUP] = 0x0e;
+  for(i = 0; i < 4; i++) {
+    regs[RX_ADDR_P2 + i] = 0xc3 + i;
+  }
+  memset(address[0], 0xe7, 5);
+  memset(address[1], 0xc2, 5);
+  memset(address[2], 0xe7, 5);
+  tx_count = 0;
+  rx_count = 0;
+  fail_tx = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+nRF24_mock_clear(void)
+{
+  memset(&counts, 0, sizeof(counts));
+  logged = 0;
+}
+/*---------------------------------------------------------------------------*/
+const struct nRF24_mock_counts *
+nRF24_mock_counts(void)
+{
+  return &counts;
+}
+/*---------------------------------------------------------------------------*/
+const struct nRF24_mock_transaction *
+nRF24_mock_log(uint16_t *count)
+{
+  *count = logged;
+  return history;
+}
+/*---------------------------------------------------------------------------*/
+int
+nRF24_mock_receive(uint8_t pipe, const void *data, uint8_t len)
+{
+  if(rx_count == FIFO_DEPTH) {
+    return 0;
+  }
+  rx[rx_count].pipe = pipe;
+  rx[rx_count].len = len;
+  memcpy(rx[rx_count].data, data, len);
+  rx_count++;
+  regs[STATUS] |= _BV(RX_DR);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+nRF24_mock_fail_tx(uint8_t frames)
+{
+  fail_tx = frames;
+}
+/*---------------------------------------------------------------------------*/
+static void
+begin(void)
+{
+  pos = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+end(void)
+{
+  if(pos == 0) {
+    return;
+  }
+  counts.transactions++;
+  if(logged < MOCK_LOG_SIZE) {
+    history[logged].command = command;
+    history[logged].length = pos;
+    logged++;
+  }
+
+  switch(command) {
+  case R_RX_PAYLOAD:
+    pop(rx, &rx_count);
+    break;
+  case W_TX_PAYLOAD:
+  case W_TX_PAYLOAD_NO_ACK:
+    if(tx_count < FIFO_DEPTH) {
+      building.ack = command == W_TX_PAYLOAD;
+      tx[tx_count++] = building;
+      transmit();
+    }
+    break;
+  case FLUSH_TX:
+    tx_count = 0;
+    break;
+  case FLUSH_RX:
+    rx_count = 0;
+    break;
+  default:
+    if((command & ~REGISTER_MASK) == W_REGISTER) {
+      transmit();
+    }
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* MISO for the n-th byte after the command */
+static uint8_t
+exchange(uint8_t mosi, uint8_t n)
+{
+  uint8_t reg = command & REGISTER_MASK;
+  uint8_t *addr = address_of(reg);
+
+  if((command & ~REGISTER_MASK) == R_REGISTER) {
+    if(addr != NULL) {
+      return n < 5 ? addr[n] : 0;
+    }
+    return reg == FIFO_STATUS ? fifo_status() :
+           reg == STATUS ? status() : regs[reg];
+  }
+  if((command & ~REGISTER_MASK) == W_REGISTER) {
+    if(addr != NULL) {
+      if(n < 5) {
+        addr[n] = mosi;
+      }
+    } else if(reg == STATUS) {
+      // The interrupt flags clear when written with 1
+      regs[STATUS] &= ~(mosi & (_BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT)));
+    } else if(reg != FIFO_STATUS && n == 0) {
+      regs[reg] = mosi;
+    }
+    return 0;
+  }
+  switch(command) {
+  case R_RX_PL_WID:
+    return rx_count ? rx[0].len : 0;
+  case R_RX_PAYLOAD:
+    return rx_count && n < rx[0].len ? rx[0].data[n] : 0;
+  case W_TX_PAYLOAD:
+  case W_TX_PAYLOAD_NO_ACK:
+    if(n < sizeof(building.data)) {
+      building.data[n] = mosi;
+      building.len = n + 1;
+    }
+    return 0;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+nRF24_host_spi(uint8_t mosi)
+{
+  uint8_t miso;
+
+  counts.bytes++;
+  if(csn) {
+    // Not selected, the radio does not see it
+    return 0xff;
+  }
+  if(pos == 0) {
+    command = mosi;
+    building.len = 0;
+    miso = status();
+  } else {
+    miso = exchange(mosi, pos - 1);
+  }
+  if(pos < 0xff) {
+    pos++;
+  }
+  return miso;
+}
+/*---------------------------------------------------------------------------*/
+void
+digitalWrite(uint8_t pin, uint8_t value)
+{
+  value = value != 0;
+  if(pin == nRF24_CSPIN && value != csn) {
+    csn = value;
+    if(csn) {
+      end();
+    } else {
+      begin();
+    }
+  } else if(pin == nRF24_CEPIN && value != ce) {
+    ce = value;
+    counts.ce_toggles++;
+    transmit();
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+pinMode(uint8_t pin, uint8_t mode)
+{
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,67 @@
+/**
+ * \file
+ *         Mock nRF24L01+ on the SPI bus and GPIO pins of the host build
+ *
+ *         The mock keeps the register file, the TX and RX FIFOs and the
+ *         STATUS flags, so the driver runs through its normal paths. A frame
+ *         written with CE high in PTX mode is sent at once: TX_DS, or MAX_RT
+ *         when nRF24_mock_fail_tx() asked for it. nRF24_mock_receive() puts
+ *         a frame in the RX FIFO.
+ *
+ *         Every CSN low to high is one transaction, logged with its command
+ *         byte and length, and CE edges are counted.
+ */
+
+#ifndef MOCK_SPI_H
+#define MOCK_SPI_H
+
+#include <stdint.h>
+
+#define MOCK_LOG_SIZE 256
+
+struct nRF24_mock_transaction {
+  uint8_t command;
+  uint8_t length;       /**< Bytes clocked, the command included */
+};
+
+struct nRF24_mock_counts {
+  uint32_t transactions;
+  uint32_t bytes;
+  uint32_t ce_toggles;
+};
+
+  /**
+   * Power-on reset of the mock radio, the counters are kept
+   */
+  void nRF24_mock_reset(void);
+
+  /**
+   * Clear the counters and the transaction log
+   */
+  void nRF24_mock_clear(void);
+
+  /**
+   * Counters since nRF24_mock_clear()
+   */
+  const struct nRF24_mock_counts *nRF24_mock_counts(void);
+
+  /**
+   * Transactions logged since nRF24_mock_clear(), the first MOCK_LOG_SIZE
+   *
+   * @param count Where to store the number of entries
+   */
+  const struct nRF24_mock_transaction *nRF24_mock_log(uint16_t *count);
+
+  /**
+   * Put a frame in the RX FIFO and raise RX_DR
+   *
+   * @return 0 if the FIFO is full
+   */
+  int nRF24_mock_receive(uint8_t pipe, const void *data, uint8_t len);
+
+  /**
+   * End the next @p frames transmissions with MAX_RT instead of TX_DS
+   */
+  void nRF24_mock_fail_tx(uint8_t frames);
+
+#endif /* MOCK_SPI_H */
@@ -0,0 +1,230 @@
+/* SPI cost of the nRF24 driver API, checked against a baseline.
+ *
+ * Every scenario runs one public call against the mock radio and counts
+ * the SPI transactions, bytes and CE edges it takes. The counts are
+ * compared with a baseline file; any increase fails the run. */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "nRF24_driver.h"
+#include "nRF24L01.h"
+#include "mock-spi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_SCENARIOS 16
+
+struct result {
+  char name[32];
+  struct nRF24_mock_counts counts;
+};
+
+static struct result results[MAX_SCENARIOS];
+static int scenarios;
+static int verbose;
+
+static const uint8_t payload[24] = "0123456789abcdefghijklm";
+
+/*---------------------------------------------------------------------------*/
+static void
+record(const char *name)
+{
+  struct result *r = &results[scenarios++];
+  const struct nRF24_mock_transaction *log;
+  uint16_t count, i;
+
+  strncpy(r->name, name, sizeof(r->name) - 1);
+  r->counts = *nRF24_mock_counts();
+  if(verbose) {
+    log = nRF24_mock_log(&count);
+    printf("%s:", name);
+    for(i = 0; i < count; i++) {
+      printf(" %02x/%u", log[i].command, log[i].length);
+    }
+    printf("\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_to(uint8_t node)
+{
+  rimeaddr_t dest = rimeaddr_null;
+
+  dest.u8[0] = node;
+  packetbuf_clear();
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
+  nRF24_mock_clear();
+  if(nRF24_driver.send(payload, sizeof(payload)) != RADIO_TX_OK) {
+    fprintf(stderr, "send to %u failed\n", node);
+    exit(2);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(void)
+{
+  uint8_t buf[32];
+  uint8_t pipe;
+
+  rimeaddr_node_addr.u8[0] = 1;
+  nRF24_mock_reset();
+
+  nRF24_mock_clear();
+  nRF24_driver.init();
+  // The registers are written once the radio has settled
+  nRF24_settle();
+  record("init");
+
+  nRF24_mock_clear();
+  nRF24_stopListening();
+  record("stopListening");
+
+  nRF24_mock_clear();
+  nRF24_startListening();
+  record("startListening");
+
+  // The driver listens between frames, so sends start and end in RX
+  send_to(2);
+  record("send_unicast");
+
+  send_to(2);
+  record("send_unicast_again");
+
+  send_to(0);
+  record("send_broadcast");
+
+  nRF24_mock_receive(1, payload, sizeof(payload));
+  nRF24_mock_clear();
+  if(!nRF24_available(&pipe)) {
+    fprintf(stderr, "frame not seen\n");
+    exit(2);
+  }
+  nRF24_read(buf, nRF24_getPayloadSize());
+  record("available_read");
+
+  nRF24_mock_clear();
+  nRF24_available(NULL);
+  record("available_empty");
+
+  nRF24_mock_receive(1, payload, sizeof(payload));
+  nRF24_mock_clear();
+  if(nRF24_driver.read(buf, sizeof(buf)) <= 0) {
+    fprintf(stderr, "frame not read\n");
+    exit(2);
+  }
+  record("read_contiki");
+}
+/*---------------------------------------------------------------------------*/
+static struct result *
+find(const char *name)
+{
+  int i;
+
+  for(i = 0; i < scenarios; i++) {
+    if(strcmp(results[i].name, name) == 0) {
+      return &results[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+compare(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  char line[128], name[32];
+  unsigned long t, b, c;
+  struct result *r;
+  int failed = 0, seen = 0;
+
+  if(f == NULL) {
+    perror(path);
+    return 2;
+  }
+  while(fgets(line, sizeof(line), f) != NULL) {
+    if(line[0] == '#' || sscanf(line, "%31s %lu %lu %lu", name, &t, &b, &c) != 4) {
+      continue;
+    }
+    r = find(name);
+    if(r == NULL) {
+      printf("%-20s missing\n", name);
+      failed = 1;
+      continue;
+    }
+    seen++;
+    if(r->counts.transactions > t || r->counts.bytes > b ||
+       r->counts.ce_toggles > c) {
+      printf("%-20s FAIL  %lu/%lu/%lu, baseline %lu/%lu/%lu\n", name,
+             (unsigned long)r->counts.transactions,
+             (unsigned long)r->counts.bytes,
+             (unsigned long)r->counts.ce_toggles, t, b, c);
+      failed = 1;
+    } else if(r->counts.transactions < t || r->counts.bytes < b ||
+              r->counts.ce_toggles < c) {
+      printf("%-20s less  %lu/%lu/%lu, baseline %lu/%lu/%lu\n", name,
+             (unsigned long)r->counts.transactions,
+             (unsigned long)r->counts.bytes,
+             (unsigned long)r->counts.ce_toggles, t, b, c);
+    } else {
+      printf("%-20s ok    %lu/%lu/%lu\n", name, t, b, c);
+    }
+  }
+  fclose(f);
+  if(seen < scenarios) {
+    printf("%d scenarios not in the baseline, update it with -u\n",
+           scenarios - seen);
+  }
+  return failed;
+}
+/*---------------------------------------------------------------------------*/
+static int
+update(const char *path)
+{
+  FILE *f = fopen(path, "w");
+  int i;
+
+  if(f == NULL) {
+    perror(path);
+    return 2;
+  }
+  fprintf(f, "# scenario transactions bytes ce_toggles\n");
+  for(i = 0; i < scenarios; i++) {
+    fprintf(f, "%s %lu %lu %lu\n", results[i].name,
+            (unsigned long)results[i].counts.transactions,
+            (unsigned long)results[i].counts.bytes,
+            (unsigned long)results[i].counts.ce_toggles);
+  }
+  fclose(f);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  int opt, write = 0;
+
+  while((opt = getopt(argc, argv, "uv")) != -1) {
+    switch(opt) {
+    case 'u':
+      write = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-u] [-v] baseline\n", argv[0]);
+      return 2;
+    }
+  }
+  if(optind != argc - 1) {
+    fprintf(stderr, "usage: %s [-u] [-v] baseline\n", argv[0]);
+    return 2;
+  }
+
+  run();
+  return write ? update(argv[optind]) : compare(argv[optind]);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""Decode the nRF24 driver trace stream into per-operation latencies.
+
+Reads the serial output of a node built with nRF24_TRACE, from a capture
+file or a serial device set to raw mode, and prints a latency histogram
+for each traced operation plus the radio mode transitions seen.
+"""
+
+import argparse
+import sys
+
+SLIP_END = 0o300
+SLIP_ESC = 0o333
+SLIP_ESC_END = 0o334
+SLIP_ESC_ESC = 0o335
+
+MAGIC = ord('T')
+HEADER_LEN = 4
+RECORD_LEN = 3
+WRAP = 1 << 16
+
+# rf24_trace_e in platform/arduino-nRF24/dev/nRF24_trace.h
+OPERATIONS = [
+    'write_payload',
+    'read_payload',
+    'tx_wait',
+    'fifo_wait',
+    'settle',
+    'irq_isr',
+    'capture_isr',
+    'slot_isr',
+]
+MODE = 16
+MODES = ['down', 'standby', 'rx', 'tx']  # rf24_power_e
+
+
+def frames(stream):
+    """Yield the SLIP frames in a byte stream, text between them is skipped."""
+    frame = None
+    escaped = False
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            return
+        for c in chunk:
+            if c == SLIP_END:
+                if frame:
+                    yield bytes(frame)
+                frame = bytearray()
+                escaped = False
+            elif frame is None:
+                continue
+            elif escaped:
+                frame.append({SLIP_ESC_END: SLIP_END,
+                              SLIP_ESC_ESC: SLIP_ESC}.get(c, c))
+                escaped = False
+            elif c == SLIP_ESC:
+                escaped = True
+            else:
+                frame.append(c)
+
+
+def records(stream, stats):
+    """Yield (event, time, tick_us, gap) per record, gap set after a loss."""
+    sequence = None
+    for frame in frames(stream):
+        if (len(frame) < HEADER_LEN or frame[0] != MAGIC or
+                (len(frame) - HEADER_LEN) % RECORD_LEN):
+            stats['skipped'] += 1
+            continue
+        seq, dropped, tick_us = frame[1], frame[2], frame[3]
+        gap = dropped > 0
+        if sequence is not None and seq != (sequence + 1) & 0xff:
+            stats['lost_frames'] += (seq - sequence - 1) & 0xff
+            gap = True
+        sequence = seq
+        stats['frames'] += 1
+        stats['dropped'] += dropped
+        for i in range(HEADER_LEN, len(frame), RECORD_LEN):
+            time = frame[i + 1] | frame[i + 2] << 8
+            yield frame[i], time, tick_us, gap
+            gap = False
+
+
+def event_name(event):
+    op = event >> 1
+    if op >= MODE:
+        mode = op - MODE
+        return 'mode ' + (MODES[mode] if mode < len(MODES) else str(mode))
+    name = OPERATIONS[op] if op < len(OPERATIONS) else 'op%d' % op
+    return name + (' end' if event & 1 else ' begin')
+
+
+def percentile(values, p):
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def histogram(values, width):
+    """Power of two buckets in microseconds, one bar per bucket."""
+    buckets = {}
+    for v in values:
+        b = 0
+        while (1 << b) <= v:
+            b += 1
+        buckets[b] = buckets.get(b, 0) + 1
+    top = max(buckets.values())
+    for b in range(min(buckets), max(buckets) + 1):
+        n = buckets.get(b, 0)
+        low = 0 if b == 0 else 1 << (b - 1)
+        print('  %7d-%-7d us %6d %s' % (low, (1 << b) - 1, n,
+                                        '#' * (n * width // top)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('input', nargs='?', default='-',
+                        help='capture file or raw serial device, - for stdin')
+    parser.add_argument('-r', '--raw', action='store_true',
+                        help='print every record instead of histograms')
+    parser.add_argument('-w', '--width', type=int, default=40,
+                        help='width of the longest histogram bar')
+    args = parser.parse_args()
+
+    stream = (sys.stdin.buffer if args.input == '-'
+              else open(args.input, 'rb', buffering=0))
+    stats = {'frames': 0, 'skipped': 0, 'lost_frames': 0, 'dropped': 0}
+    started = {}
+    latencies = {}
+    transitions = {}
+    mode = None
+
+    try:
+        for event, time, tick_us, gap in records(stream, stats):
+            if args.raw:
+                print('%5d %s%s' % (time, event_name(event),
+                                    ' (after a loss)' if gap else ''))
+                continue
+            if gap:
+                # An end may belong to a begin that was dropped
+                started.clear()
+                mode = None
+            op = event >> 1
+            if op >= MODE:
+                if mode is not None:
+                    key = (mode, op - MODE)
+                    transitions[key] = transitions.get(key, 0) + 1
+                mode = op - MODE
+            elif not event & 1:
+                started[op] = time
+            elif op in started:
+                ticks = (time - started.pop(op)) % WRAP
+                latencies.setdefault(op, []).append(ticks * tick_us)
+    except KeyboardInterrupt:
+        pass
+
+    if args.raw:
+        return
+    for op in sorted(latencies):
+        values = sorted(latencies[op])
+        name = OPERATIONS[op] if op < len(OPERATIONS) else 'op%d' % op
+        print('%s: %d, min %d median %d p90 %d p99 %d max %d us' % (
+            name, len(values), values[0], percentile(values, 50),
+            percentile(values, 90), percentile(values, 99), values[-1]))
+        histogram(values, args.width)
+    if transitions:
+        print('mode transitions:')
+        for (a, b), n in sorted(transitions.items()):
+            print('  %s -> %s %d' % (MODES[a] if a < len(MODES) else a,
+                                     MODES[b] if b < len(MODES) else b, n))
+    print('%(frames)d frames, %(skipped)d skipped (text or damaged), '
+          '%(lost_frames)d lost, %(dropped)d records dropped on the node'
+          % stats)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,192 @@
+/**
+ * \file
+ *         Host benchmark of apps/sensor-codec on recorded sample traces
+ *
+ *         Each trace line is one reading, its channels separated by commas;
+ *         lines starting with '#' are skipped. Every reading is encoded,
+ *         passed through a channel that loses a given share of the frames,
+ *         and decoded again. Decoded readings are checked against the trace.
+ *
+ *         Reports the compression ratio against plain int16_t channels,
+ *         the ESB airtime per reading at 250kbps with dynamic payloads, and
+ *         the encode plus decode throughput of the host.
+ */
+
+#include "sensor-codec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_READINGS 100000
+
+/* Preamble, 5 byte address, 9 bit packet control field and 2 byte CRC */
+#define ESB_BITS(len) (8 * (1 + 5 + (len) + 2) + 9)
+#define ESB_US_250K(len) (ESB_BITS(len) * 4)
+
+struct reading {
+  uint8_t n;
+  int16_t v[SENSOR_CODEC_CHANNELS];
+};
+
+static struct reading readings[MAX_READINGS];
+
+/*---------------------------------------------------------------------------*/
+static int
+load(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  char line[256];
+  int count = 0;
+
+  if(f == NULL) {
+    perror(path);
+    return -1;
+  }
+  while(count < MAX_READINGS && fgets(line, sizeof(line), f) != NULL) {
+    char *p = line;
+    char *end;
+    struct reading *r = &readings[count];
+
+    if(line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    r->n = 0;
+    while(r->n < SENSOR_CODEC_CHANNELS) {
+      long v = strtol(p, &end, 10);
+      if(end == p) {
+        break;
+      }
+      r->v[r->n++] = (int16_t)v;
+      p = end;
+      if(*p != ',') {
+        break;
+      }
+      p++;
+    }
+    if(r->n > 0) {
+      count++;
+    }
+  }
+  fclose(f);
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench(const char *path, int count, uint8_t key_interval, int loss, int repeat)
+{
+  struct sensor_codec_tx tx;
+  struct sensor_codec_rx rx;
+  uint8_t frame[SENSOR_CODEC_MAX_LEN(SENSOR_CODEC_CHANNELS)];
+  int16_t out[SENSOR_CODEC_CHANNELS];
+  unsigned long raw = 0, coded = 0, keyframes = 0, lost = 0;
+  unsigned long rejected = 0, wrong = 0;
+  unsigned long raw_us = 0, coded_us = 0;
+  clock_t start;
+  double seconds;
+  int i, len, run;
+
+  sensor_codec_tx_init(&tx, key_interval);
+  sensor_codec_rx_init(&rx);
+  srand(1);
+
+  for(i = 0; i < count; i++) {
+    const struct reading *r = &readings[i];
+
+    len = sensor_codec_encode(&tx, r->v, r->n, frame, sizeof(frame));
+    raw += 2 * r->n;
+    coded += len;
+    raw_us += ESB_US_250K(2 * r->n);
+    coded_us += ESB_US_250K(len);
+    if(frame[0] & 0x80) {
+      keyframes++;
+    }
+
+    if(rand() % 100 < loss) {
+      lost++;
+      sensor_codec_sent(&tx, 0);
+      continue;
+    }
+    if(sensor_codec_decode(&rx, frame, len, out) < 0) {
+      rejected++;
+    } else if(memcmp(out, r->v, r->n * sizeof(int16_t)) != 0) {
+      wrong++;
+    }
+    sensor_codec_sent(&tx, 1);
+  }
+
+  // Timing run without loss, the codec alone
+  start = clock();
+  for(run = 0; run < repeat; run++) {
+    sensor_codec_tx_init(&tx, key_interval);
+    sensor_codec_rx_init(&rx);
+    for(i = 0; i < count; i++) {
+      len = sensor_codec_encode(&tx, readings[i].v, readings[i].n,
+                                frame, sizeof(frame));
+      sensor_codec_decode(&rx, frame, len, out);
+      sensor_codec_sent(&tx, 1);
+    }
+  }
+  seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  printf("%s: %d readings, keyframe every %u, %d%% loss\n",
+         path, count, key_interval, loss);
+  printf("  bytes raw %lu coded %lu ratio %.2f, %.2f bytes/reading\n",
+         raw, coded, coded ? (double)raw / coded : 0.0,
+         count ? (double)coded / count : 0.0);
+  printf("  keyframes %lu lost %lu rejected %lu wrong %lu\n",
+         keyframes, lost, rejected, wrong);
+  printf("  airtime/reading at 250kbps raw %lu us coded %lu us\n",
+         count ? raw_us / count : 0, count ? coded_us / count : 0);
+  if(seconds > 0) {
+    printf("  encode+decode %.0f readings/s\n", (double)count * repeat / seconds);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  int key_interval = 16;
+  int loss = 0;
+  int repeat = 200;
+  int opt, count;
+  int status = 0;
+
+  while((opt = getopt(argc, argv, "k:l:r:")) != -1) {
+    switch(opt) {
+    case 'k':
+      key_interval = atoi(optarg);
+      break;
+    case 'l':
+      loss = atoi(optarg);
+      break;
+    case 'r':
+      repeat = atoi(optarg);
+      break;
+    default:
+      optind = argc + 1;
+      break;
+    }
+  }
+  if(optind >= argc || key_interval < 1 || key_interval > 255) {
+    fprintf(stderr, "usage: %s [-k key_interval] [-l loss_percent] [-r repeat] trace.csv...\n",
+            argv[0]);
+    return 2;
+  }
+
+  for(; optind < argc; optind++) {
+    count = load(argv[optind]);
+    if(count < 0) {
+      status = 1;
+      continue;
+    }
+    bench(argv[optind], count, (uint8_t)key_interval, loss, repeat);
+    if(count == 0) {
+      status = 1;
+    }
+  }
+  return status;
+}
+/*---------------------------------------------------------------------------*/